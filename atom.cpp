@@ -1,6 +1,5 @@
 #include "atom.hpp"
 
-#include <sstream>
 #include <cctype>
 #include <cmath>
 #include <limits>
@@ -18,74 +17,34 @@ Atom::Atom(std::complex<double> value) {
 
 Atom::Atom(const Token & token, bool isstring) : Atom() {
 
-	// is token a number?
-	double temp;
-	std::istringstream iss(token.asString());
-	if (iss >> temp && !is_string) {
-		// check for trailing characters if >> succeeds
-		if (iss.rdbuf()->in_avail() == 0) {
-			setNumber(temp);
-		}
-	}
-	else { // else assume symbol
-		   // make sure does not start with number
-		if (!std::isdigit(token.asString()[0])) {
-			setSymbol(token.asString());
-		}
+	// the tokenizer has already decided whether the token is a number
+	switch (token.literal()) {
+	case Token::NUMBER:
+		setNumber(token.number());
+		break;
+	case Token::SYMBOL:
+		setSymbol(intern(token.text(), token.size()));
 		is_string = isstring;
+		break;
+	case Token::INVALID:
+		break;
 	}
 }
 
 Atom::Atom(std::string value) : Atom() {
 
-	setSymbol(value);
+	setSymbol(intern(value));
 }
 
-Atom::Atom(std::string value, bool isstring) : Atom()
-{
-	is_string = isstring;
-	setSymbol(value);
-}
-
-Atom::Atom(const Atom & x) : Atom() {
-	if (x.isNumber()) {
-		setNumber(x.numberValue);
-	}
-	else if (x.isSymbol()) {
-		setSymbol(x.stringValue);
-	}
-	else if (x.isComplex()) {
-		setComplex(x.complexValue);
-	}
-	is_string = x.is_string;
-}
+Atom::Atom(SymbolId id) : Atom() {
 
-Atom & Atom::operator=(const Atom & x) {
-
-	if (this != &x) {
-		if (x.m_type == NoneKind) {
-			m_type = NoneKind;
-		}
-		else if (x.m_type == NumberKind) {
-			setNumber(x.numberValue);
-		}
-		else if (x.m_type == SymbolKind) {
-			setSymbol(x.stringValue);
-		}
-		else if (x.m_type == ComplexKind) {
-			setComplex(x.complexValue);
-		}
-		is_string = x.is_string;
-	}
-	return *this;
+	setSymbol(id);
 }
 
-Atom::~Atom() {
-
-	// we need to ensure the destructor of the symbol string is called
-	if (m_type == SymbolKind) {
-		stringValue.~basic_string();
-	}
+Atom::Atom(std::string value, bool isstring) : Atom()
+{
+	is_string = isstring;
+	setSymbol(intern(value));
 }
 
 bool Atom::isNone() const noexcept {
@@ -114,17 +73,9 @@ void Atom::setNumber(double value) {
 	numberValue = value;
 }
 
-void Atom::setSymbol(const std::string & value) {
-
-	// we need to ensure the destructor of the symbol string is called
-	if (m_type == SymbolKind) {
-		stringValue.~basic_string();
-	}
-
+void Atom::setSymbol(SymbolId value) {
 	m_type = SymbolKind;
-
-	// copy construct in place
-	new (&stringValue) std::string(value);
+	symbolValue = value;
 }
 
 void Atom::setComplex(const std::complex<double> value) {
@@ -160,15 +111,12 @@ std::complex<double> Atom::ComplexConjugate() const noexcept {
 	return std::conj(complexValue);
 }
 
-std::string Atom::asSymbol() const noexcept {
-
-	std::string result;
-
-	if (m_type == SymbolKind) {
-		result = stringValue;
-	}
+const std::string & Atom::asSymbol() const noexcept {
+	return symbol_name(asSymbolId());
+}
 
-	return result;
+SymbolId Atom::asSymbolId() const noexcept {
+	return (m_type == SymbolKind) ? symbolValue : SYM_EMPTY;
 }
 
 bool Atom::operator==(const Atom & right) const noexcept {
@@ -193,7 +141,7 @@ bool Atom::operator==(const Atom & right) const noexcept {
 	{
 		if (right.m_type != SymbolKind) return false;
 
-		return stringValue == right.stringValue;
+		return symbolValue == right.symbolValue;
 	}
 	break;
 	case ComplexKind:
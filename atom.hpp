@@ -4,12 +4,20 @@ Defines the Atom type and associated functions.
 #ifndef ATOM_HPP
 #define ATOM_HPP
 
+#include <cstdint>
+
+#include "symbol.hpp"
 #include "token.hpp"
 
 /*! \class Atom
 \brief A variant type that may be a Number or Symbol or the default type None.
 
-This class provides value semantics.
+This class provides value semantics. Symbols (and strings) hold the
+interned SymbolId of their name, so copying and comparing them never
+touches the characters.
+
+An Atom is a one-byte tag, the string flag and a 16-byte value, and is
+trivially copyable. Expressions hold one per node, so keep it that way.
 */
 class Atom {
 public:
@@ -26,21 +34,23 @@ public:
 	/// Construct an Atom of type Symbol named value
 	Atom(std::string value);
 
+	/// Construct an Atom of type Symbol with an interned name
+	Atom(SymbolId id);
+
 	/// Construct an Atom of type String with value
 	Atom(std::string value, bool isstring);
 
 	/// Construct an Atom directly from a Token
 	Atom(const Token & token, bool isstring);
 
-	/// Construct an Atom dir
 	/// Copy-construct an Atom
-	Atom(const Atom & x);
+	Atom(const Atom & x) = default;
 
 	/// Assign an Atom
-	Atom & operator=(const Atom & x);
+	Atom & operator=(const Atom & x) = default;
 
 	/// Atom destructor
-	~Atom();
+	~Atom() = default;
 
 	/// predicate to determine if an Atom is of type None
 	bool isNone() const noexcept;
@@ -79,7 +89,10 @@ public:
 	std::complex<double> ComplexConjugate() const noexcept;
 
 	/// value of Atom as a number, returns empty-string if not a Symbol
-	std::string asSymbol() const noexcept;
+	const std::string & asSymbol() const noexcept;
+
+	/// id of the Atom's symbol name, SYM_EMPTY if not a Symbol
+	SymbolId asSymbolId() const noexcept;
 
 	/// equality comparison based on type and value
 	bool operator==(const Atom & right) const noexcept;
@@ -87,34 +100,33 @@ public:
 private:
 
 	// internal enum of known types
-	enum Type { NoneKind, NumberKind, SymbolKind, ComplexKind };
-
-	// string boolean
-	bool is_string = false;
+	enum Type : std::uint8_t { NoneKind, NumberKind, SymbolKind, ComplexKind };
 
 	// track the type
 	Type m_type;
 
-	// values for the known types. Note the use of a union requires care
-	// when setting non POD values (see setSymbol)
+	// string boolean
+	bool is_string = false;
+
+	// values for the known types
 	union {
 		std::complex<double> complexValue;
 		double numberValue;
-		std::string stringValue;
+		SymbolId symbolValue;
 	};
 
-	std::vector<Atom> listValue;
-
 	// helper to set type and value of Number
 	void setNumber(double value);
 
 	// helper to set type and value of Symbol
-	void setSymbol(const std::string & value);
+	void setSymbol(SymbolId value);
 
 	// helper to set type and value of Complex
 	void setComplex(const std::complex<double> value);
 };
 
+static_assert(sizeof(Atom) == 24, "Atom should stay a tag and a 16-byte value");
+
 /// inequality comparison for Atom
 bool operator!=(const Atom &left, const Atom & right) noexcept;
 
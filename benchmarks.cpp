@@ -0,0 +1,619 @@
+/*
+Benchmarks for the interpreter.
+
+Run the benchmarks executable with no arguments to run every benchmark, or
+with the names of the ones to run. Each prints one line per measurement.
+These are not unit tests and are not run by ctest; build in Release mode
+before reading anything into the numbers.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "compiled_program.hpp"
+#include "environment.hpp"
+#include "interpreter.hpp"
+#include "parse.hpp"
+#include "token.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// heap allocations made so far, counted by the operator new below
+static std::size_t allocation_count = 0;
+
+void * operator new(std::size_t size) {
+	++allocation_count;
+	if (void * block = std::malloc(size == 0 ? 1 : size)) {
+		return block;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void * block) noexcept {
+	std::free(block);
+}
+
+// run f once, returning the wall time in milliseconds
+template<typename F>
+double time_ms(F f) {
+	Clock::time_point start = Clock::now();
+	f();
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// run f once to warm up, then runs more times, returning the median wall
+// time in milliseconds; for measurements too noisy to take from one run
+template<typename F>
+double median_ms(F f, int runs) {
+	f();
+	std::vector<double> times;
+	for (int i = 0; i < runs; ++i) {
+		times.push_back(time_ms(f));
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+void report(const std::string & name, double ms) {
+	std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+		<< std::setprecision(2) << std::setw(10) << ms << " ms" << std::endl;
+}
+
+// a program holding count varied numeric literals in a single list
+std::string literal_program(std::size_t count) {
+	std::ostringstream oss;
+	unsigned seed = 3574;
+	oss << "(list";
+	for (std::size_t i = 0; i < count; ++i) {
+		seed = seed * 1103515245 + 12345;
+		switch (seed % 4) {
+		case 0: oss << " " << (seed >> 8) % 100000; break;
+		case 1: oss << " -" << (seed >> 8) % 1000 << "." << (seed >> 4) % 1000; break;
+		case 2: oss << " " << (seed >> 8) % 100 << ".25e" << int(seed % 40) - 20; break;
+		case 3: oss << " 0." << (seed >> 6) % 10000000; break;
+		}
+	}
+	oss << ")";
+	return oss.str();
+}
+
+// converting a million numeric literals: the istringstream path Atom used
+// to take against parse_number, then the whole tokenize and parse pipeline
+void bench_literals() {
+	std::shared_ptr<const SourceBuffer> source = std::make_shared<const SourceBuffer>(literal_program(1000000));
+	TokenSequenceType tokens = tokenize(source);
+
+	double stream_sum = 0;
+	report("literals/istringstream", time_ms([&] {
+		for (auto & t : tokens) {
+			if (t.type() != Token::SYM) continue;
+			double value;
+			std::istringstream iss(t.asString());
+			if (iss >> value && iss.rdbuf()->in_avail() == 0) {
+				stream_sum += value;
+			}
+		}
+	}));
+
+	double parsed_sum = 0;
+	report("literals/parse_number", time_ms([&] {
+		for (auto & t : tokens) {
+			if (t.type() != Token::SYM) continue;
+			double value;
+			if (parse_number(t.text(), t.text() + t.size(), value) == t.text() + t.size()) {
+				parsed_sum += value;
+			}
+		}
+	}));
+
+	if (stream_sum != parsed_sum) {
+		std::cout << "literals: conversions disagree" << std::endl;
+	}
+
+	report("literals/tokenize", time_ms([&] { tokenize(source); }));
+	report("literals/tokenize+parse", time_ms([&] { parse(tokenize(source)); }));
+}
+
+// a program of count independent top-level defines, like generated data scripts
+std::string define_program(std::size_t count) {
+	std::ostringstream oss;
+	for (std::size_t i = 0; i < count; ++i) {
+		oss << "(define point" << i << " (list (+ " << i << " 0.5) (* " << i % 97
+			<< " 2) \"label " << i << "\" (list 1 2 3)))\n";
+	}
+	return oss.str();
+}
+
+// tokenizing and parsing a large multi-form file on one thread, then on
+// several threads splitting it at top-level forms; each figure is the median
+// of several runs after a warm-up, and only means anything on several cores
+void bench_parallel_parse() {
+	std::shared_ptr<const SourceBuffer> source = std::make_shared<const SourceBuffer>(define_program(50000));
+	const int runs = 7;
+
+	double serial = median_ms([&] {
+		std::vector<Expression> forms;
+		parse_program(source, forms);
+	}, runs);
+	report("parallel_parse/serial", serial);
+
+	// one thread takes the serial path, see parse_program
+	for (unsigned threads : {2u, 4u, 8u}) {
+		double ms = median_ms([&] {
+			std::vector<Expression> forms;
+			parse_program(source, forms, threads);
+		}, runs);
+		std::ostringstream name;
+		name << "parallel_parse/threads=" << threads << " (x" << std::setprecision(2) << std::fixed << serial / ms << ")";
+		report(name.str(), ms);
+	}
+	std::cout << "parallel_parse/hardware threads           " << std::thread::hardware_concurrency() << std::endl;
+}
+
+// interning names already interned, as tokenizing does for every symbol,
+// on one thread and on several at once as parallel parsing does
+void bench_intern() {
+	std::vector<std::string> names;
+	for (int i = 0; i < 1000; ++i) {
+		names.push_back("name" + std::to_string(i));
+		intern(names.back());
+	}
+
+	const int rounds = 2000;
+	for (unsigned threads : {1u, 4u}) {
+		double ms = median_ms([&] {
+			std::vector<std::thread> workers;
+			for (unsigned t = 0; t < threads; ++t) {
+				workers.emplace_back([&] {
+					for (int i = 0; i < rounds; ++i) {
+						for (const std::string & name : names) {
+							intern(name.data(), name.size());
+						}
+					}
+				});
+			}
+			for (auto & worker : workers) {
+				worker.join();
+			}
+		}, 5);
+		std::ostringstream name;
+		name << "intern/2M names on each of " << threads << " threads";
+		report(name.str(), ms);
+	}
+}
+
+// loading a large program from its compiled image rather than parsing it
+void bench_compiled() {
+	std::shared_ptr<const SourceBuffer> source = std::make_shared<const SourceBuffer>(define_program(50000));
+
+	std::vector<Expression> forms;
+	parse_program(source, forms);
+	SourceBuffer image(compile_program(*source, forms));
+
+	report("compiled/parse", time_ms([&] {
+		std::vector<Expression> parsed;
+		parse_program(source, parsed);
+	}));
+	report("compiled/load", time_ms([&] {
+		std::vector<Expression> loaded;
+		load_compiled(image, loaded);
+	}));
+}
+
+// the engines compared, see Interpreter::Engine
+const int ENGINE_COUNT = 4;
+const Interpreter::Engine ENGINES[ENGINE_COUNT] = { Interpreter::TREE_WALKER, Interpreter::BYTECODE, Interpreter::CLOSURES, Interpreter::ITERATIVE };
+
+// programs from the interpreter unit tests, as a quick mixed workload
+const char * const INTERPRETER_TEST_PROGRAMS[] = {
+	"(begin (define r 10) (* pi (* r r)))",
+	"(+ (+ 10 1) (+ 30 (+ 1 1)))",
+	"(begin (define a 1) (define b 1) (+ a b))",
+	"(range 0 5 1)",
+	"(begin (define a (lambda (x) (+ 1 x))) (a 2))",
+	"(apply + (list 1 2 3 4))",
+	"(map / (list 1 2 4))",
+	"(get-property \"foo\" (set-property \"foo\" \"foo1\" (3)))",
+	"(/ 1 I)",
+	"(^ I 2)",
+	"(begin (define f (lambda (x) (list x (+ (* 2 x) 1)))) (discrete-plot (map f (range -2 2 0.5)) (list (list \"title\" \"The Data\") (list \"abscissa-label\" \"X Label\") (list \"ordinate-label\" \"Y Label\") (list \"text-scale\" 1))))",
+	"(begin (define f (lambda (x) (+ (* 2 x) 1))) (continuous-plot f (list -2 2) (list (list \"title\" \"A continuous linear function\") (list \"abscissa-label\" \"x\") (list \"ordinate-label\" \"y\") (list \"text-scale\" 1))))",
+};
+
+// each test program parsed and evaluated in a fresh interpreter, as the
+// unit tests do, many times over
+void bench_interpreter_tests() {
+	const int rounds = 200;
+
+	report("interpreter_tests/run", time_ms([&] {
+		for (int i = 0; i < rounds; ++i) {
+			for (const char * program : INTERPRETER_TEST_PROGRAMS) {
+				Interpreter interp;
+				std::istringstream iss(program);
+				if (interp.parseStream(iss)) {
+					interp.evaluate();
+				}
+			}
+		}
+	}));
+
+	// evaluation alone, in one environment, with each engine
+	std::vector<Expression> forms;
+	for (const char * program : INTERPRETER_TEST_PROGRAMS) {
+		parse_program(std::make_shared<const SourceBuffer>(program), forms);
+	}
+	const char * const names[] = { "interpreter_tests/evaluate", "interpreter_tests/evaluate bytecode", "interpreter_tests/evaluate closures", "interpreter_tests/evaluate iterative" };
+	for (int e = 0; e < ENGINE_COUNT; ++e) {
+		Interpreter interp;
+		interp.setEngine(ENGINES[e]);
+		report(names[e], time_ms([&] {
+			for (int i = 0; i < rounds; ++i) {
+				for (auto & form : forms) {
+					interp.evaluate(form);
+				}
+			}
+		}));
+	}
+}
+
+// bytes currently allocated on the heap, or 0 where that is not available
+std::size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+// memory held by a million-element list as built by range
+void bench_range_memory() {
+	std::cout << "range_memory/sizeof(Atom)                " << sizeof(Atom) << " bytes" << std::endl;
+	std::cout << "range_memory/sizeof(Expression)          " << sizeof(Expression) << " bytes" << std::endl;
+
+	std::size_t before = heap_in_use();
+	Expression list;
+	double ms = time_ms([&] {
+		Interpreter interp;
+		std::istringstream iss("(range 0 999999 1)");
+		interp.parseStream(iss);
+		list = interp.evaluate();
+	});
+	std::size_t after = heap_in_use();
+
+	report("range_memory/evaluate", ms);
+	std::cout << "range_memory/heap for 1M elements        " << (after - before) / (1024 * 1024) << " MiB" << std::endl;
+}
+
+// copying a 100k-element list, as passing it through the environment or
+// the message queues does
+void bench_list_copy() {
+	Expression list{ Atom(SYM_ISLIST) };
+	list.setList();
+	for (int i = 0; i < 100000; ++i) {
+		list.append(Expression(i));
+	}
+
+	const int rounds = 1000;
+	std::size_t elements = 0;
+	report("list_copy/1000 copies of 100k", time_ms([&] {
+		for (int i = 0; i < rounds; ++i) {
+			Expression copy(list);
+			elements += copy.isTailEmpty() ? 0 : 1;
+		}
+	}));
+	if (elements != rounds) {
+		std::cerr << "list_copy: lost elements" << std::endl;
+	}
+}
+
+// first and length on a million-element list, which only read the tail
+void bench_list_access() {
+	Interpreter interp;
+	std::istringstream define("(define xs (range 0 999999 1))");
+	interp.parseStream(define);
+	interp.evaluate();
+
+	const int rounds = 100;
+	const char * const programs[] = { "(length xs)", "(first xs)" };
+	for (const char * program : programs) {
+		std::vector<Expression> forms;
+		parse_program(std::make_shared<const SourceBuffer>(program), forms);
+		report(std::string("list_access/100 x ") + program + " on 1M", time_ms([&] {
+			for (int i = 0; i < rounds; ++i) {
+				interp.evaluate(forms[0]);
+			}
+		}));
+	}
+}
+
+// reading the properties of a text object, as the notebook does to draw it
+void bench_property_lookup() {
+	Expression text{ Atom("label", true) };
+	text.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+	text.add_pair(Expression(Atom(SYM_POSITION)), Expression(Atom(SYM_POINT)));
+	text.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(2));
+	text.add_pair(Expression(Atom(SYM_TEXT_ROTATION)), Expression(0));
+	text.add_pair(Expression(Atom("note")), Expression(1));
+
+	const Expression keys[] = {
+		Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_POSITION)),
+		Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(SYM_TEXT_ROTATION)),
+		Expression(Atom(SYM_SIZE)),
+	};
+
+	const int rounds = 1000000;
+	std::size_t found = 0;
+	report("property_lookup/1M x 5 lookups", time_ms([&] {
+		for (int i = 0; i < rounds; ++i) {
+			for (auto & key : keys) {
+				found += text.is_value(key) ? 1 : 0;
+			}
+		}
+	}));
+	if (found != 4 * std::size_t(rounds)) {
+		std::cerr << "property_lookup: lost properties" << std::endl;
+	}
+}
+
+// evaluating plots, which build many short-lived points and lines
+void bench_plots() {
+	const char * const programs[] = {
+		"(begin (define f (lambda (x) (+ (* 2 x) 1))) (continuous-plot f (list -2 2) (list (list \"title\" \"A line\") (list \"text-scale\" 1))))",
+		"(begin (define f (lambda (x) (sin x))) (continuous-plot f (list (- pi) pi)))",
+		"(begin (define f (lambda (x) (list x (+ (* 2 x) 1)))) (discrete-plot (map f (range -50 50 0.1)) (list (list \"title\" \"The Data\"))))",
+	};
+
+	const int rounds = 50;
+	Interpreter interp;
+	std::vector<Expression> forms;
+	for (const char * program : programs) {
+		parse_program(std::make_shared<const SourceBuffer>(program), forms);
+	}
+
+	std::size_t before = allocation_count;
+	report("plots/evaluate", time_ms([&] {
+		for (int i = 0; i < rounds; ++i) {
+			for (auto & form : forms) {
+				interp.evaluate(form);
+			}
+		}
+	}));
+	std::cout << "plots/allocations per round              " << (allocation_count - before) / rounds << std::endl;
+}
+
+// mapping lambdas that call lambdas over a range, with each engine
+void bench_lambda_calls() {
+	const char * const program =
+		"(begin (define sq (lambda (x) (* x x))) (define poly (lambda (x y) (+ (sq x) (* 2 x y) (sq y) 1)))"
+		" (define f (lambda (x) (poly x (- x 1)))) (apply + (map f (range 0 20000 1))))";
+
+	const int rounds = 10;
+	std::vector<Expression> forms;
+	parse_program(std::make_shared<const SourceBuffer>(program), forms);
+
+	const char * const names[] = { "lambda_calls/tree walker", "lambda_calls/bytecode", "lambda_calls/closures", "lambda_calls/iterative" };
+	Expression results[ENGINE_COUNT];
+	for (int e = 0; e < ENGINE_COUNT; ++e) {
+		Interpreter interp;
+		interp.setEngine(ENGINES[e]);
+		report(names[e], time_ms([&] {
+			for (int i = 0; i < rounds; ++i) {
+				results[e] = interp.evaluate(forms[0]);
+			}
+		}));
+		if (results[e] != results[0]) {
+			std::cerr << "lambda_calls: engines disagree" << std::endl;
+		}
+	}
+}
+
+// mapping one lambda over a long range, with each engine
+void bench_map_lambda() {
+	const char * const program =
+		"(begin (define f (lambda (x) (+ (* 2 x) 1))) (map f (range 0 99999 1)))";
+
+	const int rounds = 5;
+	std::vector<Expression> forms;
+	parse_program(std::make_shared<const SourceBuffer>(program), forms);
+
+	const char * const names[] = { "map_lambda/tree walker", "map_lambda/bytecode", "map_lambda/closures", "map_lambda/iterative" };
+	Expression results[ENGINE_COUNT];
+	for (int e = 0; e < ENGINE_COUNT; ++e) {
+		Interpreter interp;
+		interp.setEngine(ENGINES[e]);
+		report(names[e], time_ms([&] {
+			for (int i = 0; i < rounds; ++i) {
+				results[e] = interp.evaluate(forms[0]);
+			}
+		}));
+		if (results[e] != results[0]) {
+			std::cerr << "map_lambda: engines disagree" << std::endl;
+		}
+	}
+}
+
+// mapping a lambda with constant subexpressions, folded while parsing, with each engine
+void bench_constant_subexpressions() {
+	const char * const program =
+		"(begin (define f (lambda (x) (+ (* x (/ 1 3)) (* 2 pi) (sqrt (+ 1 (^ e 2)))))) (map f (range 0 99999 1)))";
+
+	const int rounds = 5;
+	std::vector<Expression> forms;
+	parse_program(std::make_shared<const SourceBuffer>(program), forms);
+
+	const char * const names[] = { "constant_subexpressions/tree walker", "constant_subexpressions/bytecode", "constant_subexpressions/closures", "constant_subexpressions/iterative" };
+	Expression results[ENGINE_COUNT];
+	for (int e = 0; e < ENGINE_COUNT; ++e) {
+		Interpreter interp;
+		interp.setEngine(ENGINES[e]);
+		report(names[e], time_ms([&] {
+			for (int i = 0; i < rounds; ++i) {
+				results[e] = interp.evaluate(forms[0]);
+			}
+		}));
+		if (results[e] != results[0]) {
+			std::cerr << "constant_subexpressions: engines disagree" << std::endl;
+		}
+	}
+}
+
+// mapping a lambda over a list of few distinct values, plain and memoized, with each engine
+void bench_memoize() {
+	std::ostringstream program;
+	program << "(begin (define g (lambda (x) (+ (sin x) (cos x) (sqrt x) (ln (+ x 1)) (^ x 1.5))))"
+		" (define f (memoize g)) (define xs (list";
+	for (int i = 0; i < 20000; ++i) {
+		program << ' ' << i % 100;
+	}
+	program << ")))";
+
+	const int rounds = 5;
+	std::vector<Expression> forms;
+	parse_program(std::make_shared<const SourceBuffer>(program.str()), forms);
+	std::istringstream plain("(map g xs)");
+	Expression plain_map = parse(tokenize(plain));
+	std::istringstream memoized("(map f xs)");
+	Expression memoized_map = parse(tokenize(memoized));
+
+	const char * const names[] = { "memoize/tree walker", "memoize/bytecode", "memoize/closures", "memoize/iterative" };
+	for (int e = 0; e < ENGINE_COUNT; ++e) {
+		Interpreter interp;
+		interp.setEngine(ENGINES[e]);
+		interp.evaluate(forms[0]);
+		Expression expected, result;
+		report(std::string(names[e]) + " plain", time_ms([&] {
+			for (int i = 0; i < rounds; ++i) {
+				expected = interp.evaluate(plain_map);
+			}
+		}));
+		report(std::string(names[e]) + " memoized", time_ms([&] {
+			for (int i = 0; i < rounds; ++i) {
+				result = interp.evaluate(memoized_map);
+			}
+		}));
+		if (result != expected) {
+			std::cerr << "memoize: memoized results differ" << std::endl;
+		}
+	}
+}
+
+// looking up the names of an environment holding many definitions, directly
+// and the way the closure engine does, with a slot hint per name
+void bench_env_lookup() {
+	const int count = 1000;
+	Environment env;
+	std::vector<Atom> names;
+	for (int i = 0; i < count; ++i) {
+		names.push_back(Atom("var" + std::to_string(i)));
+		env.add_exp(names.back(), Expression(i));
+	}
+	std::vector<SymbolId> ids;
+	for (auto & name : names) {
+		ids.push_back(name.asSymbolId());
+	}
+
+	const int rounds = 10000;
+	double sum = 0;
+	report("env_lookup/10M get_exp", time_ms([&] {
+		for (int i = 0; i < rounds; ++i) {
+			for (auto & name : names) {
+				sum += env.get_exp(name).head().asNumber();
+			}
+		}
+	}));
+	report("env_lookup/10M find", time_ms([&] {
+		for (int i = 0; i < rounds; ++i) {
+			for (SymbolId id : ids) {
+				Procedure proc = nullptr;
+				sum += env.find(id, proc)->head().asNumber();
+			}
+		}
+	}));
+	std::vector<std::size_t> slots(count, Environment::NO_SLOT);
+	report("env_lookup/10M find with slot hints", time_ms([&] {
+		for (int i = 0; i < rounds; ++i) {
+			for (int n = 0; n < count; ++n) {
+				Procedure proc = nullptr;
+				sum += env.find(ids[n], proc, slots[n])->head().asNumber();
+			}
+		}
+	}));
+	if (sum != 3 * double(rounds) * count * (count - 1) / 2) {
+		std::cerr << "env_lookup: wrong values" << std::endl;
+	}
+
+	// copying it, as a kernel restart or a snapshot does
+	const int copies = 1000;
+	report("env_lookup/1K copies", time_ms([&] {
+		for (int i = 0; i < copies; ++i) {
+			Environment copy(env);
+			sum += copy.get_exp(names[i]).head().asNumber();
+		}
+	}));
+	report("env_lookup/1K copies, each defining a name", time_ms([&] {
+		for (int i = 0; i < copies; ++i) {
+			Environment copy(env);
+			copy.add_exp(names[i], Expression(0));
+		}
+	}));
+
+	// making and resetting the default environment, as each interpreter does
+	const int defaults = 100000;
+	std::size_t before = allocation_count;
+	report("env_lookup/100K default environments", time_ms([&] {
+		for (int i = 0; i < defaults; ++i) {
+			Environment fresh;
+			fresh.reset();
+			sum += fresh.get_exp(Atom(SYM_PI)).head().asNumber();
+		}
+	}));
+	std::cout << "env_lookup/allocations per default        " << (allocation_count - before) / defaults << std::endl;
+}
+
+struct Benchmark {
+	const char * name;
+	void(*run)();
+};
+
+const Benchmark BENCHMARKS[] = {
+	{ "literals", bench_literals },
+	{ "parallel_parse", bench_parallel_parse },
+	{ "intern", bench_intern },
+	{ "compiled", bench_compiled },
+	{ "interpreter_tests", bench_interpreter_tests },
+	{ "range_memory", bench_range_memory },
+	{ "list_copy", bench_list_copy },
+	{ "list_access", bench_list_access },
+	{ "property_lookup", bench_property_lookup },
+	{ "plots", bench_plots },
+	{ "lambda_calls", bench_lambda_calls },
+	{ "map_lambda", bench_map_lambda },
+	{ "constant_subexpressions", bench_constant_subexpressions },
+	{ "memoize", bench_memoize },
+	{ "env_lookup", bench_env_lookup },
+};
+
+int main(int argc, char *argv[]) {
+	for (const Benchmark & b : BENCHMARKS) {
+		bool selected = (argc == 1);
+		for (int i = 1; i < argc; ++i) {
+			selected = selected || (std::string(argv[i]) == b.name);
+		}
+		if (selected) {
+			b.run();
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,346 @@
+#include "bytecode.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// names of the opcodes, in Opcode order
+const char * const OPCODE_NAMES[] = {
+	"const", "local", "lookup", "call", "proc", "define", "pop", "jump", "if-lambda",
+	"check-callable", "apply", "map", "set-property", "get-property", "continuous-plot",
+	"fail", "return",
+};
+
+// whether evaluating exp can bind a name in the environment it runs in
+bool binds(const Expression & exp) {
+	SymbolId form = exp.head().asSymbolId();
+	if (!exp.isTailEmpty() && (form == SYM_DEFINE || form == SYM_SET_PROPERTY || form == SYM_CONTINUOUS_PLOT)) {
+		return true;
+	}
+	for (auto & e : exp.tailView()) {
+		if (binds(e)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Compiles one chunk. The code mirrors Expression::eval_node and its
+handlers: errors the tree walker finds from the shape of a form alone
+become OP_FAIL at the point it would throw, and errors that depend on the
+environment are left to the instructions.
+*/
+class Compiler {
+public:
+	explicit Compiler(Chunk & chunk) : m_chunk(chunk) {}
+
+	// give each parameter of lambda a slot, a repeated name the last one
+	void parameters(const Expression & lambda) {
+		Expression::TailView params = lambda.tailView()[0].tailView();
+		for (std::size_t i = 0; i < params.size(); ++i) {
+			const Atom & param = params[i].head();
+			m_chunk.parameters.push_back(param.isSymbol() ? param.asSymbolId() : SYM_EMPTY);
+			if (param.isSymbol()) {
+				m_slots.emplace_back(param.asSymbolId(), static_cast<std::uint32_t>(i));
+			}
+		}
+	}
+
+	void expression(const Expression & exp) {
+		const Atom & head = exp.head();
+		SymbolId form = head.asSymbolId();
+
+		if (exp.isTailEmpty()) {
+			if (form == SYM_LIST && !head.isString()) {
+				emit(OP_PROC, form, 0);
+			}
+			else if (head.isString() || head.isNumber() || head.isComplex()) {
+				emit(OP_CONST, constant(Expression(head)));
+			}
+			else if (head.isSymbol()) {
+				std::uint32_t slot = local(form);
+				if (slot != NO_OPERAND) {
+					emit(OP_LOCAL, slot);
+				}
+				else {
+					emit(OP_LOOKUP, form);
+				}
+			}
+			else {
+				fail("Error during evaluation: Invalid type in terminal expression");
+			}
+			return;
+		}
+
+		switch (form) {
+		case SYM_BEGIN:
+			begin(exp);
+			return;
+		case SYM_DEFINE:
+			define(exp);
+			return;
+		case SYM_APPLY:
+		case SYM_MAP:
+			apply_map(exp, form);
+			return;
+		case SYM_LAMBDA:
+			if (exp.tailView().size() != 2) {
+				fail("Error during evaluation: invalid number of arguments to lambda");
+			}
+			else {
+				emit(OP_CONST, constant(exp.handle_lambda()));
+			}
+			return;
+		case SYM_SET_PROPERTY:
+		case SYM_GET_PROPERTY:
+		case SYM_CONTINUOUS_PLOT:
+			special(exp, form);
+			return;
+		default:
+			call(exp);
+			return;
+		}
+	}
+
+	void finish() {
+		emit(OP_RETURN);
+	}
+
+private:
+	Chunk & m_chunk;
+
+	// parameter slots by name
+	std::vector<std::pair<SymbolId, std::uint32_t> > m_slots;
+
+	std::uint32_t emit(Opcode op, std::uint32_t a = NO_OPERAND, std::uint32_t b = NO_OPERAND) {
+		m_chunk.code.push_back(Instruction{ op, a, b });
+		return static_cast<std::uint32_t>(m_chunk.code.size() - 1);
+	}
+
+	std::uint32_t here() const {
+		return static_cast<std::uint32_t>(m_chunk.code.size());
+	}
+
+	std::uint32_t constant(Expression value) {
+		m_chunk.constants.push_back(std::move(value));
+		return static_cast<std::uint32_t>(m_chunk.constants.size() - 1);
+	}
+
+	std::uint32_t message(const std::string & text) {
+		auto found = std::find(m_chunk.messages.begin(), m_chunk.messages.end(), text);
+		if (found != m_chunk.messages.end()) {
+			return static_cast<std::uint32_t>(found - m_chunk.messages.begin());
+		}
+		m_chunk.messages.push_back(text);
+		return static_cast<std::uint32_t>(m_chunk.messages.size() - 1);
+	}
+
+	void fail(const std::string & text) {
+		emit(OP_FAIL, message(text));
+	}
+
+	std::uint32_t local(SymbolId name) const {
+		for (auto it = m_slots.rbegin(); it != m_slots.rend(); ++it) {
+			if (it->first == name) {
+				return it->second;
+			}
+		}
+		return NO_OPERAND;
+	}
+
+	void arguments(const Expression & exp) {
+		for (auto & e : exp.tailView()) {
+			expression(e);
+		}
+	}
+
+	void begin(const Expression & exp) {
+		Expression::TailView forms = exp.tailView();
+		for (std::size_t i = 0; i < forms.size(); ++i) {
+			if (i > 0) {
+				emit(OP_POP);
+			}
+			expression(forms[i]);
+		}
+	}
+
+	void define(const Expression & exp) {
+		Expression::TailView tail = exp.tailView();
+		if (tail.size() != 2) {
+			fail("Error during evaluation: invalid number of arguments to define");
+			return;
+		}
+		if (!tail[0].isHeadSymbol()) {
+			fail("Error during evaluation: first argument to define not symbol");
+			return;
+		}
+		SymbolId name = tail[0].head().asSymbolId();
+		if (name == SYM_DEFINE || name == SYM_BEGIN || name == SYM_LAMBDA) {
+			fail("Error during evaluation: attempt to redefine a special-form");
+			return;
+		}
+		expression(tail[1]);
+		emit(OP_DEFINE, name);
+	}
+
+	void apply_map(const Expression & exp, SymbolId form) {
+		const std::string name = (form == SYM_APPLY) ? "apply" : "map";
+		Expression::TailView tail = exp.tailView();
+		if (tail.size() != 2) {
+			fail("Error: " + name + " takes two arguments");
+			return;
+		}
+		if (!tail[0].isHeadSymbol() || !tail[0].isTailEmpty()) {
+			fail("Error: first argument to " + name + " not a procedure.");
+			return;
+		}
+		emit(OP_CHECK_CALLABLE, tail[0].head().asSymbolId(), message("Error: first argument to " + name + " not a procedure."));
+		expression(tail[1]);
+		emit(form == SYM_APPLY ? OP_APPLY : OP_MAP, constant(tail[0]));
+	}
+
+	// a form the tree walker handles specially unless its name is bound to a lambda
+	void special(const Expression & exp, SymbolId form) {
+		std::uint32_t guard = emit(OP_IF_LAMBDA, form);
+		Expression::TailView tail = exp.tailView();
+
+		if (form == SYM_SET_PROPERTY) {
+			if (tail.size() != 3) {
+				fail("Error in call to set-property: invalid number of arguments.");
+			}
+			else if (!tail[0].head().isString()) {
+				fail("Error in call to set-property: first argument must be a string.");
+			}
+			else {
+				expression(tail[1]);
+				expression(tail[2]);
+				emit(OP_SET_PROPERTY, constant(tail[0]));
+			}
+		}
+		else if (form == SYM_GET_PROPERTY) {
+			if (tail.size() != 2) {
+				fail("Error in call to get-property: invalid number of arguments.");
+			}
+			else if (!tail[0].head().isString()) {
+				fail("Error in call to get-property: first argument must be a string.");
+			}
+			else {
+				expression(tail[1]);
+				// like the tree walker, a bare name (or string) is read from the environment again
+				std::uint32_t probe = NO_OPERAND;
+				if (tail[1].isHeadSymbol() && tail[1].isTailEmpty()) {
+					probe = tail[1].head().asSymbolId();
+				}
+				emit(OP_GET_PROPERTY, constant(tail[0]), probe);
+			}
+		}
+		else {
+			if (tail.size() != 2 && tail.size() != 3) {
+				fail("Error in call to continuous-plot: incorrect number of arguments.");
+			}
+			else {
+				arguments(exp);
+				emit(OP_CONTINUOUS_PLOT, NO_OPERAND, static_cast<std::uint32_t>(tail.size()));
+			}
+		}
+
+		std::uint32_t skip = emit(OP_JUMP);
+		m_chunk.code[guard].b = here();
+		arguments(exp);
+		emit(OP_CALL, m_chunk.code[guard].a, static_cast<std::uint32_t>(tail.size()));
+		m_chunk.code[skip].a = here();
+	}
+
+	void call(const Expression & exp) {
+		SymbolId name = exp.head().asSymbolId();
+		std::uint32_t count = static_cast<std::uint32_t>(exp.tailView().size());
+
+		if (!exp.isHeadSymbol()) {
+			// never a lambda, and never a procedure once the arguments are evaluated
+			arguments(exp);
+			fail("Error during evaluation: procedure name not symbol");
+			return;
+		}
+
+		if (!binds(exp)) {
+			// the arguments cannot change what the name means, so decide after them
+			arguments(exp);
+			emit(OP_CALL, name, count);
+			return;
+		}
+
+		// the tree walker decides whether the name is a lambda before the arguments
+		std::uint32_t guard = emit(OP_IF_LAMBDA, name);
+		arguments(exp);
+		emit(OP_PROC, name, count);
+		std::uint32_t skip = emit(OP_JUMP);
+		m_chunk.code[guard].b = here();
+		arguments(exp);
+		emit(OP_CALL, name, count);
+		m_chunk.code[skip].a = here();
+	}
+};
+
+}
+
+Chunk compile(const Expression & exp) {
+	Chunk chunk;
+	Compiler compiler(chunk);
+	compiler.expression(exp);
+	compiler.finish();
+	return chunk;
+}
+
+Chunk compile_lambda(const Expression & lambda) {
+	Chunk chunk;
+	Compiler compiler(chunk);
+	compiler.parameters(lambda);
+	compiler.expression(lambda.tailView()[1]);
+	compiler.finish();
+	return chunk;
+}
+
+void disassemble(const Chunk & chunk, std::ostream & out) {
+	for (std::size_t i = 0; i < chunk.code.size(); ++i) {
+		const Instruction & in = chunk.code[i];
+		out << i << ": " << OPCODE_NAMES[in.op];
+		switch (in.op) {
+		case OP_CONST:
+		case OP_APPLY:
+		case OP_MAP:
+		case OP_SET_PROPERTY:
+			out << " " << chunk.constants[in.a];
+			break;
+		case OP_LOOKUP:
+		case OP_DEFINE:
+		case OP_CHECK_CALLABLE:
+			out << " " << symbol_name(SymbolId(in.a));
+			break;
+		case OP_CALL:
+		case OP_PROC:
+		case OP_IF_LAMBDA:
+			out << " " << symbol_name(SymbolId(in.a)) << " " << in.b;
+			break;
+		case OP_GET_PROPERTY:
+			out << " " << chunk.constants[in.a];
+			if (in.b != NO_OPERAND) {
+				out << " " << symbol_name(SymbolId(in.b));
+			}
+			break;
+		case OP_LOCAL:
+		case OP_JUMP:
+			out << " " << in.a;
+			break;
+		case OP_CONTINUOUS_PLOT:
+			out << " " << in.b;
+			break;
+		case OP_FAIL:
+			out << " \"" << chunk.messages[in.a] << "\"";
+			break;
+		case OP_POP:
+		case OP_RETURN:
+			break;
+		}
+		out << "\n";
+	}
+}
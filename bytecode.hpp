@@ -0,0 +1,97 @@
+/*! \file bytecode.hpp
+Defines the instruction set of the virtual machine and the compiler from
+expressions to it.
+ */
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "expression.hpp"
+#include "symbol.hpp"
+
+/*! \enum Opcode
+\brief What an instruction does, with its operands a and b.
+
+Instructions work on a stack of values. Operands naming a symbol hold its
+SymbolId, operands naming a constant index Chunk::constants, operands
+naming a message index Chunk::messages, and jump targets are instruction
+indexes.
+ */
+enum Opcode : std::uint8_t {
+	OP_CONST,            ///< push constant a
+	OP_LOCAL,            ///< push the value of parameter slot a of the running lambda
+	OP_LOOKUP,           ///< push the value of symbol a
+	OP_CALL,             ///< call the lambda or built-in procedure symbol a names on the top b values
+	OP_PROC,             ///< call the built-in procedure symbol a names on the top b values
+	OP_DEFINE,           ///< bind symbol a to the top value, leaving it
+	OP_POP,              ///< drop the top value
+	OP_JUMP,             ///< continue at a
+	OP_IF_LAMBDA,        ///< continue at b if symbol a names a lambda
+	OP_CHECK_CALLABLE,   ///< fail with message b unless symbol a names a lambda or procedure
+	OP_APPLY,            ///< apply the procedure named by constant a to the list on top
+	OP_MAP,              ///< map the procedure named by constant a over the list on top
+	OP_SET_PROPERTY,     ///< set property constant a of the top value to the one below it
+	OP_GET_PROPERTY,     ///< replace the top value by its property constant a, or by that of symbol b's value if bound
+	OP_CONTINUOUS_PLOT,  ///< plot the function in the top b values
+	OP_FAIL,             ///< throw a SemanticError with message a
+	OP_RETURN,           ///< end the chunk, its result is the top value
+};
+
+/// the value of an unused operand
+const std::uint32_t NO_OPERAND = 0xffffffff;
+
+/*! \struct Instruction
+\brief One instruction of a chunk.
+ */
+struct Instruction {
+	Opcode op;
+	std::uint32_t a;
+	std::uint32_t b;
+};
+
+/*! \struct Chunk
+\brief The compiled code of one program, or of the body of one lambda.
+ */
+struct Chunk {
+	/// the instructions, ending with OP_RETURN
+	std::vector<Instruction> code;
+
+	/// literals, property names and lambda values used by the instructions
+	std::vector<Expression> constants;
+
+	/// the texts of the errors raised by OP_FAIL and OP_CHECK_CALLABLE
+	std::vector<std::string> messages;
+
+	/// for a lambda body, the parameter in each slot, SYM_EMPTY for one that is not a symbol
+	std::vector<SymbolId> parameters;
+};
+
+/*! \fn compile
+\brief Compile an expression evaluated at the top level
+
+\param exp the expression
+\return the chunk, evaluating exp the way Expression::eval does
+ */
+Chunk compile(const Expression & exp);
+
+/*! \fn compile_lambda
+\brief Compile the body of a lambda value
+
+\param lambda a lambda value, as produced by evaluating a lambda form
+\return the chunk; it expects the arguments in parameter slots 0 to n-1
+ */
+Chunk compile_lambda(const Expression & lambda);
+
+/*! \fn disassemble
+\brief Write a chunk as text, one instruction per line, for tests and inspection
+
+\param chunk the chunk
+\param out the stream to write to
+ */
+void disassemble(const Chunk & chunk, std::ostream & out);
+
+#endif
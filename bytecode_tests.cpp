@@ -0,0 +1,77 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+
+#include "bytecode.hpp"
+#include "parse.hpp"
+
+static std::string disassembled(const Chunk & chunk) {
+  std::ostringstream out;
+  disassemble(chunk, out);
+  return out.str();
+}
+
+static Expression parsed(const std::string & program) {
+  std::istringstream iss(program);
+  Expression exp = parse(tokenize(iss));
+  REQUIRE(exp != Expression());
+  return exp;
+}
+
+TEST_CASE( "Test compiling forms to bytecode", "[bytecode]" ) {
+
+  REQUIRE(disassembled(compile(parsed("(begin (define r 10) (* pi (* r r)))"))) ==
+    "0: const (10)\n"
+    "1: define r\n"
+    "2: pop\n"
+    "3: lookup pi\n"
+    "4: lookup r\n"
+    "5: lookup r\n"
+    "6: call * 2\n"
+    "7: call * 2\n"
+    "8: return\n");
+
+  // the shape of a form is checked when it is compiled, and fails when run
+  REQUIRE(disassembled(compile(parsed("(define begin 1)"))) ==
+    "0: fail \"Error during evaluation: attempt to redefine a special-form\"\n"
+    "1: return\n");
+
+  // a call whose arguments can rebind its name decides what it calls first
+  REQUIRE(disassembled(compile(parsed("(f (define f 1))"))) ==
+    "0: if-lambda f 5\n"
+    "1: const (1)\n"
+    "2: define f\n"
+    "3: proc f 1\n"
+    "4: jump 8\n"
+    "5: const (1)\n"
+    "6: define f\n"
+    "7: call f 1\n"
+    "8: return\n");
+
+  REQUIRE(disassembled(compile(parsed("(map f (list 1 2))"))) ==
+    "0: check-callable f\n"
+    "1: const (1)\n"
+    "2: const (2)\n"
+    "3: call list 2\n"
+    "4: map (f)\n"
+    "5: return\n");
+}
+
+TEST_CASE( "Test compiling lambda bodies to bytecode", "[bytecode]" ) {
+
+  Expression lambda = parsed("(lambda (x y) (+ x y z))").handle_lambda();
+  Chunk body = compile_lambda(lambda);
+  REQUIRE(body.parameters.size() == 2);
+  REQUIRE(disassembled(body) ==
+    "0: local 0\n"
+    "1: local 1\n"
+    "2: lookup z\n"
+    "3: call + 3\n"
+    "4: return\n");
+
+  // a repeated parameter is the last argument given for it
+  Chunk repeated = compile_lambda(parsed("(lambda (x x) x)").handle_lambda());
+  REQUIRE(repeated.parameters.size() == 2);
+  REQUIRE(disassembled(repeated) == "0: local 1\n1: return\n");
+}
@@ -0,0 +1,371 @@
+#include "closure_engine.hpp"
+
+#include "memo_cache.hpp"
+#include "packed_list.hpp"
+#include "semantic_error.hpp"
+
+namespace {
+
+// the closure leaving exp to the tree walker
+ClosureEngine::Closure walk(const Expression & exp) {
+	return [exp](Environment & env) -> Expression {
+		return exp.eval(env);
+	};
+}
+
+std::vector<Expression> evaluate_all(const std::vector<ClosureEngine::Closure> & closures, Environment & env) {
+	std::vector<Expression> values;
+	values.reserve(closures.size());
+	for (auto & closure : closures) {
+		values.push_back(closure(env));
+	}
+	return values;
+}
+
+}
+
+ClosureEngine::ClosureEngine(const ClosureEngine &) {}
+
+ClosureEngine & ClosureEngine::operator=(const ClosureEngine & other) {
+	if (this != &other) {
+		m_bodies.clear();
+	}
+	return *this;
+}
+
+Expression ClosureEngine::evaluate(const Expression & exp, Environment & env) {
+	// no closure of a previous evaluation is running now
+	if (m_bodies.size() > MAX_CACHED_BODIES) {
+		m_bodies.clear();
+	}
+	return compile(exp)(env);
+}
+
+std::size_t ClosureEngine::cachedBodies() const noexcept {
+	return m_bodies.size();
+}
+
+ClosureEngine::Closure ClosureEngine::compile(const Expression & exp) {
+	// the same decisions Expression::eval makes, less those needing the environment
+	const Atom & head = exp.head();
+	SymbolId form = head.asSymbolId();
+	Expression::TailView tail = exp.tailView();
+
+	if (tail.empty()) {
+		if (form == SYM_LIST && !head.isString()) {
+			Procedure list = Environment::builtin(SYM_LIST);
+			return [list, exp](Environment & env) -> Expression {
+				if (env.shadows_builtins()) {
+					return exp.eval(env);
+				}
+				return list(std::vector<Expression>());
+			};
+		}
+		if (head.isString() || head.isNumber() || head.isComplex()) {
+			Atom value = head;
+			return [value](Environment &) -> Expression {
+				return Expression(value);
+			};
+		}
+		if (head.isSymbol()) {
+			// where the name was found last, tried first next time
+			std::size_t slot = Environment::NO_SLOT;
+			return [form, slot](Environment & env) mutable -> Expression {
+				Procedure proc = nullptr;
+				const Expression * value = env.find(form, proc, slot);
+				if (value == nullptr) {
+					throw SemanticError("Error during evaluation: unknown symbol");
+				}
+				return *value;
+			};
+		}
+		return walk(exp);
+	}
+
+	if (exp.folded() != nullptr) {
+		// the value stands until a built-in name or constant is rebound
+		Expression value = *exp.folded();
+		Closure call = compile_call(exp, form);
+		return [value, call](Environment & env) -> Expression {
+			return env.shadows_builtins() ? call(env) : value;
+		};
+	}
+
+	switch (form) {
+	case SYM_BEGIN: {
+		std::vector<Closure> forms = compile_all(tail);
+		return [forms](Environment & env) -> Expression {
+			Expression result;
+			for (auto & closure : forms) {
+				result = closure(env);
+			}
+			return result;
+		};
+	}
+	case SYM_DEFINE: {
+		if (tail.size() != 2 || !tail[0].isHeadSymbol()) {
+			return walk(exp);
+		}
+		SymbolId name = tail[0].head().asSymbolId();
+		if (name == SYM_DEFINE || name == SYM_BEGIN || name == SYM_LAMBDA) {
+			return walk(exp);
+		}
+		Atom symbol = tail[0].head();
+		Closure value = compile(tail[1]);
+		return [symbol, value](Environment & env) -> Expression {
+			Expression result = value(env);
+			// Expression::handle_define looks up the name of the form itself
+			if (env.is_exp(Atom(SYM_DEFINE))) {
+				throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
+			}
+			env.add_exp(symbol, result);
+			return result;
+		};
+	}
+	case SYM_APPLY:
+	case SYM_MAP: {
+		if (tail.size() != 2 || !tail[0].isHeadSymbol() || !tail[0].isTailEmpty()) {
+			return walk(exp);
+		}
+		Atom op = tail[0].head();
+		bool map = (form == SYM_MAP);
+		Closure list = compile(tail[1]);
+		return [this, op, map, list](Environment & env) -> Expression {
+			Procedure proc = nullptr;
+			if (!is_lambda(env.find(op.asSymbolId(), proc)) && proc == nullptr) {
+				throw SemanticError(map ? "Error: first argument to map not a procedure." : "Error: first argument to apply not a procedure.");
+			}
+			return apply_map(op, map, list(env), env);
+		};
+	}
+	case SYM_LAMBDA: {
+		if (tail.size() != 2) {
+			return walk(exp);
+		}
+		Expression value = exp.handle_lambda();
+		return [value](Environment &) -> Expression {
+			return value;
+		};
+	}
+	case SYM_SET_PROPERTY:
+	case SYM_GET_PROPERTY:
+	case SYM_CONTINUOUS_PLOT:
+		return compile_special(exp, form);
+	default:
+		if (!head.isSymbol()) {
+			return walk(exp);
+		}
+		return compile_call(exp, form);
+	}
+}
+
+std::vector<ClosureEngine::Closure> ClosureEngine::compile_all(const Expression::TailView & tail) {
+	std::vector<Closure> closures;
+	closures.reserve(tail.size());
+	for (auto & exp : tail) {
+		closures.push_back(compile(exp));
+	}
+	return closures;
+}
+
+ClosureEngine::Closure ClosureEngine::compile_call(const Expression & exp, SymbolId sym) {
+	std::vector<Closure> args = compile_all(exp.tailView());
+	Procedure builtin = Environment::builtin(sym);
+
+	std::size_t slot = Environment::NO_SLOT;
+
+	return [this, sym, args, builtin, slot](Environment & env) mutable -> Expression {
+		// until a built-in name is rebound it can only name its procedure
+		if (builtin == nullptr || env.shadows_builtins()) {
+			Procedure proc = nullptr;
+			if (is_lambda(env.find(sym, proc, slot))) {
+				return call_lambda(sym, args, env);
+			}
+		}
+
+		std::vector<Expression> values = evaluate_all(args, env);
+
+		// the arguments may have rebound the name
+		Procedure proc = builtin;
+		if (proc == nullptr || env.shadows_builtins()) {
+			proc = nullptr;
+			env.find(sym, proc, slot);
+		}
+		if (proc == nullptr) {
+			throw SemanticError("Error during evaluation: symbol does not name a procedure");
+		}
+		return proc(values);
+	};
+}
+
+ClosureEngine::Closure ClosureEngine::compile_special(const Expression & exp, SymbolId form) {
+	Expression::TailView tail = exp.tailView();
+
+	// forms of the wrong shape are left to the tree walker to fail, or call a lambda
+	bool valid;
+	switch (form) {
+	case SYM_SET_PROPERTY:
+		valid = tail.size() == 3 && tail[0].head().isString();
+		break;
+	case SYM_GET_PROPERTY:
+		valid = tail.size() == 2 && tail[0].head().isString();
+		break;
+	default:
+		valid = tail.size() == 2 || tail.size() == 3;
+		break;
+	}
+	if (!valid) {
+		return walk(exp);
+	}
+
+	std::vector<Closure> args = compile_all(tail);
+	Expression key = tail[0];
+	// get-property reads the properties of a symbol's value rather than of its evaluation
+	bool lookup = (form == SYM_GET_PROPERTY && tail[1].isHeadSymbol() && tail[1].isTailEmpty());
+	SymbolId symbol = lookup ? tail[1].head().asSymbolId() : SYM_EMPTY;
+
+	return [this, form, args, key, symbol, lookup](Environment & env) -> Expression {
+		// a lambda is only bound to the name of the form once a built-in name is rebound
+		if (env.shadows_builtins()) {
+			Procedure proc = nullptr;
+			if (is_lambda(env.find(form, proc))) {
+				return call_lambda(form, args, env);
+			}
+		}
+
+		switch (form) {
+		case SYM_SET_PROPERTY: {
+			Expression value = args[1](env);
+			Expression result = args[2](env);
+			result.add_pair(key, value);
+			if (env.is_exp(result.head().asSymbol())) {
+				env.add_exp(result.head().asSymbol(), result);
+			}
+			return result;
+		}
+		case SYM_GET_PROPERTY: {
+			Expression result = args[1](env);
+			if (lookup) {
+				Procedure proc = nullptr;
+				const Expression * value = env.find(symbol, proc);
+				if (value != nullptr) {
+					return value->get_value(key);
+				}
+			}
+			return result.get_value(key);
+		}
+		default:
+			return continuous_plot(evaluate_all(args, env), env);
+		}
+	};
+}
+
+const ClosureEngine::Body & ClosureEngine::body(const Expression & lambda) {
+	Expression::TailView tail = lambda.tailView();
+	if (tail.size() != 2) {
+		throw SemanticError("Error: incorrect number of arguments to lambda");
+	}
+
+	const Expression * key = &tail[0];
+	auto found = m_bodies.find(key);
+	if (found == m_bodies.end()) {
+		std::unique_ptr<Body> compiled(new Body{ lambda, compile(tail[1]) });
+		found = m_bodies.emplace(key, std::move(compiled)).first;
+	}
+	return *found->second;
+}
+
+Expression ClosureEngine::call(const Expression & lambda, std::vector<Expression> && args, Environment & env) {
+	const Body & called = body(lambda);
+	Expression::TailView parameters = called.lambda.tailView()[0].tailView();
+	if (parameters.size() != args.size()) {
+		throw SemanticError("Error: incorrect number of arguments to lambda");
+	}
+
+	// a memoized lambda may have the result already, then no environment is set up
+	MemoCache * memo = lambda.memo();
+	std::string key;
+	if (memo != nullptr && MemoCache::key(Expression::TailView(args.data(), args.size()), key)) {
+		Expression cached;
+		if (memo->find(key, cached)) {
+			return cached;
+		}
+	}
+	else {
+		memo = nullptr;
+	}
+
+	// the lambda runs in a frame in front of the environment, as in the tree walker
+	Environment lambda_env(env, args.size());
+	for (std::size_t i = 0; i < args.size(); ++i) {
+		lambda_env.bind(parameters[i].head(), std::move(args[i]));
+	}
+	if (memo == nullptr) {
+		return called.closure(lambda_env);
+	}
+	Expression value = called.closure(lambda_env);
+	memo->insert(std::move(key), value);
+	return value;
+}
+
+Expression ClosureEngine::call_lambda(SymbolId sym, const std::vector<Closure> & args, Environment & env) {
+	std::vector<Expression> values = evaluate_all(args, env);
+
+	// the arguments may have rebound the name
+	Procedure proc = nullptr;
+	const Expression * value = env.find(sym, proc);
+	if (!is_lambda(value)) {
+		throw SemanticError("Error during evaluation: symbol does not name a procedure");
+	}
+	Expression lambda = *value;
+	return call(lambda, std::move(values), env);
+}
+
+Expression ClosureEngine::apply_map(const Atom & op, bool map, Expression && list, Environment & env) {
+	if (!list.isList()) {
+		throw SemanticError(map ? "Error: second argument to map not a list." : "Error: second argument to apply not a list.");
+	}
+
+	// the tree walker evaluates each element again, which only numbers and
+	// strings survive unchanged; anything else is left to it
+	const PackedList * packed = list.packed();
+	Expression::TailView elements = packed ? Expression::TailView() : list.tailView();
+	std::size_t count = packed ? packed->size() : elements.size();
+	bool simple = count > 0 && !is_special_form(op.asSymbolId());
+	for (std::size_t i = 0; simple && i < elements.size(); ++i) {
+		simple = is_self_evaluating(elements[i]);
+	}
+	if (!simple) {
+		return apply_or_map(op, map, std::move(list).getTail(), env);
+	}
+
+	auto argument = [&](std::size_t i) {
+		return packed ? packed->element(i) : Expression(elements[i].head());
+	};
+
+	// evaluating the list may have rebound op
+	Procedure proc = nullptr;
+	const Expression * value = env.find(op.asSymbolId(), proc);
+	if (!is_lambda(value) && proc == nullptr) {
+		throw SemanticError("Error during evaluation: symbol does not name a procedure");
+	}
+	Expression lambda = is_lambda(value) ? *value : Expression();
+
+	if (!map) {
+		std::vector<Expression> args;
+		args.reserve(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			args.push_back(argument(i));
+		}
+		return (proc == nullptr) ? call(lambda, std::move(args), env) : proc(args);
+	}
+
+	std::vector<Expression> results;
+	results.reserve(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		std::vector<Expression> arg;
+		arg.push_back(argument(i));
+		results.push_back((proc == nullptr) ? call(lambda, std::move(arg), env) : proc(arg));
+	}
+	return make_list(std::move(results));
+}
@@ -0,0 +1,98 @@
+/*! \file closure_engine.hpp
+Defines the engine evaluating expressions compiled to trees of closures.
+ */
+#ifndef CLOSURE_ENGINE_HPP
+#define CLOSURE_ENGINE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class ClosureEngine
+\brief Evaluates expressions by first turning them into trees of closures.
+
+Each expression is compiled once into a function object holding the
+closures of its subexpressions, and for a call of a built-in procedure the
+procedure itself, so what kind of expression it is is not worked out again
+each time it is evaluated. The closures run in the same environments the
+tree walker uses, with a frame for each lambda call, and give the same results
+and SemanticErrors as Expression::eval. Lambda bodies are compiled the
+first time they are called and cached by the lambda value's tail.
+
+Forms the closures do not handle themselves, e.g. those that will fail,
+are evaluated by the tree walker.
+ */
+class ClosureEngine {
+public:
+
+	/// a compiled expression, evaluating it in the given environment
+	typedef std::function<Expression(Environment &)> Closure;
+
+	/// the most compiled lambda bodies kept before the cache is emptied
+	static const std::size_t MAX_CACHED_BODIES = 4096;
+
+	/// Construct an engine with an empty cache
+	ClosureEngine() = default;
+
+	/// Copy-construct an engine, starting with an empty cache
+	ClosureEngine(const ClosureEngine & other);
+
+	/// Assign an engine, emptying the cache
+	ClosureEngine & operator=(const ClosureEngine & other);
+
+	/*! Evaluate an expression
+	  \param exp the expression
+	  \param env the environment to evaluate it in, changed by its definitions
+	  \return the result of the evaluation
+	  \throws SemanticError when a semantic error is encountered
+	 */
+	Expression evaluate(const Expression & exp, Environment & env);
+
+	/*! Compile an expression to a closure; the closure may use the engine,
+	  so it must not outlive it, and may be invalid after the next evaluate
+	  \param exp the expression, which the closure keeps a copy of if needed
+	  \return the closure evaluating exp
+	 */
+	Closure compile(const Expression & exp);
+
+	/// the number of lambda bodies compiled and cached
+	std::size_t cachedBodies() const noexcept;
+
+private:
+
+	// a compiled lambda body, holding the lambda so its tail stays put
+	struct Body {
+		Expression lambda;
+		Closure closure;
+	};
+
+	std::unordered_map<const Expression *, std::unique_ptr<Body> > m_bodies;
+
+	// the closures of each expression in a tail
+	std::vector<Closure> compile_all(const Expression::TailView & tail);
+
+	// the closure of a call of the symbol sym
+	Closure compile_call(const Expression & exp, SymbolId sym);
+
+	// the closure of a set-property, get-property or continuous-plot form
+	Closure compile_special(const Expression & exp, SymbolId form);
+
+	// the compiled body of a lambda value
+	const Body & body(const Expression & lambda);
+
+	// call lambda on args, in a frame in front of env
+	Expression call(const Expression & lambda, std::vector<Expression> && args, Environment & env);
+
+	// call the lambda sym is bound to on the values of args
+	Expression call_lambda(SymbolId sym, const std::vector<Closure> & args, Environment & env);
+
+	// apply or map op over the evaluated list
+	Expression apply_map(const Atom & op, bool map, Expression && list, Environment & env);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "closure_engine.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+
+// the result of a program, or its error message, evaluated with the given engine
+static std::string run_with(Interpreter::Engine engine, const std::string & program) {
+  std::istringstream iss(program);
+  Interpreter interp;
+  interp.setEngine(engine);
+  REQUIRE(interp.parseStream(iss));
+
+  std::ostringstream out;
+  try {
+    out << interp.evaluate();
+  }
+  catch (const SemanticError & ex) {
+    out << "error: " << ex.what();
+  }
+  return out.str();
+}
+
+TEST_CASE( "Test the closure engine agrees with the tree walker", "[closure_engine]" ) {
+
+  std::vector<std::string> programs = {
+    // atoms, procedures and special forms
+    "(1)", "(\"text\")", "(pi)", "(I)", "(+ 1 2 3)", "(list)", "(- 4)",
+    "(begin (define r 10) (* pi (* r r)))",
+    "(define + 2)", "(begin (define sqrt 2) (sqrt 4))",
+    "(lambda (x y) (+ x y))",
+    // lambda calls, nested and with dynamic scope
+    "(begin (define f (lambda (x) (* x x))) (f 3))",
+    "(begin (define f (lambda (x y) (+ x y))) (f 1))",
+    "(begin (define f (lambda (x) (+ x y))) (define g (lambda (y) (f 1))) (g 5))",
+    "(begin (define f (lambda (x) (begin (define y x) y))) (f 1) y)",
+    "(begin (define f (lambda (sqrt) (sqrt 4))) (f 1))",
+    "(begin (define f (lambda (1) 1)) (f 2))",
+    // built-in names rebound, before, by and after a call
+    "(begin (define f (lambda (x) (+ x 1))) (define g (lambda (+) (f 1))) (list (f 1) (g (lambda (x y) (* x y))) (f 1)))",
+    "(+ (define + 2) 1)",
+    "(begin (define g 1) (g (define g (lambda (x) x))))",
+    // apply and map
+    "(apply + (list 1 2 3))", "(apply + (list))", "(apply + 3)", "(apply 1 (list 1))",
+    "(begin (define f (lambda (x y) (+ x y))) (apply f (list 1 2)))",
+    "(map sqrt (list 1 4 9))", "(map + (list 1 I \"a\"))", "(map (+ 1) (list 1))",
+    "(begin (define f (lambda (x) (list x))) (map f (list (list 1 2) 3)))",
+    "(begin (define f (lambda (x) x)) (map f (begin (define f 2) (list 1))))",
+    "(begin (define map (lambda (x) x)) (map map (list 1)))",
+    // properties and plots
+    "(set-property \"note\" 1 (2))",
+    "(begin (define a 1) (set-property \"note\" 2 a) (get-property \"note\" a))",
+    "(begin (define a \"a\") (set-property \"note\" 2 a) (get-property \"note\" \"a\"))",
+    "(get-property \"note\" 1)", "(get-property note 1)", "(set-property 1 2)",
+    "(begin (define set-property (lambda (x y z) z)) (set-property 1 2 3))",
+    "(continuous-plot (lambda (x) (* 2 x)) (list 0 1))",
+    "(continuous-plot 1 2)",
+    // errors
+    "(undefined)", "(undefined 1)", "(1 2)", "(define 1 2)", "(define begin 1)", "(define a)",
+    "(lambda (x))", "(begin)",
+  };
+
+  for (auto & program : programs) {
+    INFO(program);
+    REQUIRE(run_with(Interpreter::CLOSURES, program) == run_with(Interpreter::TREE_WALKER, program));
+  }
+}
+
+TEST_CASE( "Test the closure engine compiles each lambda body once", "[closure_engine]" ) {
+
+  Environment env;
+  ClosureEngine engine;
+
+  std::istringstream define("(define f (lambda (x) (* x x)))");
+  engine.evaluate(parse(tokenize(define)), env);
+
+  std::istringstream call("(map f (range 1 3 1))");
+  Expression result = engine.evaluate(parse(tokenize(call)), env);
+  REQUIRE(result.tailView().size() == 3);
+  REQUIRE(result.tailView()[2] == Expression(9));
+  REQUIRE(engine.cachedBodies() == 1);
+
+  // an error part way through leaves the engine ready for the next evaluation
+  std::istringstream error("(f (f 1) 2)");
+  REQUIRE_THROWS_AS(engine.evaluate(parse(tokenize(error)), env), SemanticError);
+  std::istringstream again("(f 4)");
+  REQUIRE(engine.evaluate(parse(tokenize(again)), env) == Expression(16));
+  REQUIRE(engine.cachedBodies() == 1);
+
+  // a copy starts with no compiled bodies
+  ClosureEngine copy(engine);
+  REQUIRE(copy.cachedBodies() == 0);
+}
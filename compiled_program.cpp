@@ -0,0 +1,297 @@
+#include "compiled_program.hpp"
+
+#include <cstring>
+
+#include "optimize.hpp"
+#include "parse.hpp"
+#include "property_table.hpp"
+
+// the first bytes of every image
+static const char MAGIC[4] = { 'P', 'L', 'S', 'C' };
+
+// how a node's head atom is stored
+enum AtomTag : std::uint8_t { NONE_TAG, NUMBER_TAG, SYMBOL_TAG, COMPLEX_TAG };
+
+// bits of a node's flag byte
+const std::uint8_t STRING_FLAG = 1;
+const std::uint8_t LIST_FLAG = 2;
+
+// appends little-endian values to an image
+class ImageWriter {
+public:
+	explicit ImageWriter(std::string & out) : m_out(out) {}
+
+	void u8(std::uint8_t value) {
+		m_out.push_back(static_cast<char>(value));
+	}
+
+	void u32(std::uint32_t value) {
+		for (int i = 0; i < 4; ++i) {
+			u8(static_cast<std::uint8_t>(value >> (8 * i)));
+		}
+	}
+
+	void u64(std::uint64_t value) {
+		for (int i = 0; i < 8; ++i) {
+			u8(static_cast<std::uint8_t>(value >> (8 * i)));
+		}
+	}
+
+	void f64(double value) {
+		std::uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		u64(bits);
+	}
+
+	void text(const std::string & value) {
+		u32(static_cast<std::uint32_t>(value.size()));
+		m_out.append(value);
+	}
+
+	void location(const SourceLocation & location) {
+		u32(location.line);
+		u32(location.column);
+	}
+
+	void node(const Expression & exp) {
+		const Atom & head = exp.head();
+		if (head.isNumber()) {
+			u8(NUMBER_TAG);
+			f64(head.asNumber());
+		}
+		else if (head.isComplex()) {
+			u8(COMPLEX_TAG);
+			f64(head.ComplexReal());
+			f64(head.ComplexImag());
+		}
+		else if (head.isSymbol()) {
+			u8(SYMBOL_TAG);
+			text(head.asSymbol());
+		}
+		else {
+			u8(NONE_TAG);
+		}
+
+		u8((head.isString() ? STRING_FLAG : 0) | (exp.isList() ? LIST_FLAG : 0));
+		location(exp.span().begin);
+		location(exp.span().end);
+
+		u32(static_cast<std::uint32_t>(exp.properties().size()));
+		for (auto & property : exp.properties()) {
+			text(symbol_name(property.first));
+			node(property.second);
+		}
+
+		u32(static_cast<std::uint32_t>(exp.tailConstEnd() - exp.tailConstBegin()));
+		for (auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e) {
+			node(*e);
+		}
+	}
+
+private:
+	std::string & m_out;
+};
+
+// reads little-endian values from an image, failing at its end
+class ImageReader {
+public:
+	ImageReader(const char * begin, const char * end) : m_pos(begin), m_end(end) {}
+
+	std::size_t remaining() const noexcept {
+		return m_end - m_pos;
+	}
+
+	bool u8(std::uint8_t & value) noexcept {
+		if (remaining() < 1) return false;
+		value = static_cast<std::uint8_t>(*m_pos++);
+		return true;
+	}
+
+	bool u32(std::uint32_t & value) noexcept {
+		if (remaining() < 4) return false;
+		value = 0;
+		for (int i = 0; i < 4; ++i) {
+			value |= std::uint32_t(static_cast<unsigned char>(*m_pos++)) << (8 * i);
+		}
+		return true;
+	}
+
+	bool u64(std::uint64_t & value) noexcept {
+		if (remaining() < 8) return false;
+		value = 0;
+		for (int i = 0; i < 8; ++i) {
+			value |= std::uint64_t(static_cast<unsigned char>(*m_pos++)) << (8 * i);
+		}
+		return true;
+	}
+
+	bool f64(double & value) noexcept {
+		std::uint64_t bits;
+		if (!u64(bits)) return false;
+		std::memcpy(&value, &bits, sizeof(value));
+		return true;
+	}
+
+	bool bytes(std::size_t size, const char *& data) noexcept {
+		if (remaining() < size) return false;
+		data = m_pos;
+		m_pos += size;
+		return true;
+	}
+
+	bool text(std::string & value) {
+		std::uint32_t size;
+		const char * data;
+		if (!u32(size) || !bytes(size, data)) return false;
+		value.assign(data, size);
+		return true;
+	}
+
+	bool location(SourceLocation & location) noexcept {
+		return u32(location.line) && u32(location.column);
+	}
+
+	// read a node into exp, which must be a default-constructed expression
+	bool node(Expression & exp) {
+		std::uint8_t tag, flags;
+		if (!u8(tag)) return false;
+
+		switch (tag) {
+		case NONE_TAG:
+			if (!u8(flags)) return false;
+			break;
+		case NUMBER_TAG: {
+			double value;
+			if (!f64(value) || !u8(flags)) return false;
+			exp.head() = Atom(value);
+			break;
+		}
+		case COMPLEX_TAG: {
+			double real, imag;
+			if (!f64(real) || !f64(imag) || !u8(flags)) return false;
+			exp.head() = Atom(std::complex<double>(real, imag));
+			break;
+		}
+		case SYMBOL_TAG: {
+			std::string name;
+			if (!text(name) || !u8(flags)) return false;
+			exp.head() = (flags & STRING_FLAG) ? Atom(name, true) : Atom(name);
+			break;
+		}
+		default:
+			return false;
+		}
+
+		if (flags & LIST_FLAG) {
+			exp.setList();
+		}
+
+		SourceSpan span;
+		if (!location(span.begin) || !location(span.end)) return false;
+		exp.setSpan(span);
+
+		std::uint32_t count;
+		if (!u32(count)) return false;
+		for (std::uint32_t i = 0; i < count; ++i) {
+			std::string key;
+			Expression value;
+			if (!text(key) || !node(value)) return false;
+			exp.add_pair(Expression(Atom(key)), value);
+		}
+
+		// children are filled in where they sit rather than copied in
+		if (!u32(count)) return false;
+		for (std::uint32_t i = 0; i < count; ++i) {
+			exp.append(Expression());
+			if (!node(*exp.tail())) return false;
+		}
+
+		return true;
+	}
+
+private:
+	const char * m_pos;
+	const char * m_end;
+};
+
+bool is_compiled(const SourceBuffer & image) noexcept {
+	return image.size() >= sizeof(MAGIC) && std::memcmp(image.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+std::string compile_program(const SourceBuffer & source, const std::vector<Expression> & forms) {
+	std::string image(MAGIC, sizeof(MAGIC));
+	ImageWriter writer(image);
+
+	writer.u32(COMPILED_FORMAT_VERSION);
+	writer.u64(source.size());
+	image.append(source.data(), source.size());
+
+	writer.u32(static_cast<std::uint32_t>(forms.size()));
+	for (auto & form : forms) {
+		writer.node(form);
+	}
+
+	return image;
+}
+
+bool load_compiled(const SourceBuffer & image, std::vector<Expression> & forms, const SourceBuffer * expected) noexcept {
+
+	if (!is_compiled(image)) {
+		return false;
+	}
+
+	ImageReader reader(image.data() + sizeof(MAGIC), image.end());
+
+	std::uint32_t version;
+	std::uint64_t size;
+	const char * text;
+	if (!reader.u32(version) || !reader.u64(size) || size > reader.remaining() || !reader.bytes(size, text)) {
+		return false;
+	}
+
+	if (expected != nullptr && (expected->size() != size || std::memcmp(expected->data(), text, size) != 0)) {
+		return false;
+	}
+
+	if (version != COMPILED_FORMAT_VERSION) {
+		// written by another version, the text is the only part to trust
+		try {
+			return parse_program(std::make_shared<const SourceBuffer>(std::string(text, size)), forms);
+		}
+		catch (const std::exception &) {
+			return false;
+		}
+	}
+
+	std::size_t first = forms.size();
+	try {
+		std::uint32_t count;
+		if (!reader.u32(count) || count == 0 || count > reader.remaining()) {
+			return false;
+		}
+
+		forms.reserve(first + count);
+		for (std::uint32_t i = 0; i < count; ++i) {
+			forms.emplace_back();
+			if (!reader.node(forms.back())) {
+				forms.resize(first);
+				return false;
+			}
+			forms.back().resolve();
+			optimize(forms.back());
+		}
+	}
+	catch (const std::exception &) {
+		forms.resize(first);
+		return false;
+	}
+
+	return true;
+}
+
+bool load_program(const std::shared_ptr<const SourceBuffer> & source, std::vector<Expression> & forms, unsigned threads) noexcept {
+	if (is_compiled(*source)) {
+		return load_compiled(*source, forms);
+	}
+	return parse_program(source, forms, threads);
+}
@@ -0,0 +1,67 @@
+/*! \file compiled_program.hpp
+Defines the binary format programs are precompiled to (.plsc files).
+ */
+#ifndef COMPILED_PROGRAM_HPP
+#define COMPILED_PROGRAM_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "expression.hpp"
+#include "source_buffer.hpp"
+
+/*! The format version written by compile_program. Images stamped with any
+other version are not trusted, and their embedded text is parsed instead.
+ */
+const std::uint32_t COMPILED_FORMAT_VERSION = 1;
+
+/*! \fn is_compiled
+\brief Check whether a buffer holds a compiled program image
+
+\param image the buffer to check
+\return true if the buffer starts with the compiled program magic number
+ */
+bool is_compiled(const SourceBuffer & image) noexcept;
+
+/*! \fn compile_program
+\brief Serialize the parsed forms of a program to a compiled image
+
+\param source the program text the forms were parsed from
+\param forms the top-level forms, in order
+\return the image
+
+The image holds a version stamp, the program text, and each form's tree
+(heads, tails, string and list flags, properties and source spans) in
+pre-order, all numbers little-endian.
+ */
+std::string compile_program(const SourceBuffer & source, const std::vector<Expression> & forms);
+
+/*! \fn load_compiled
+\brief Rebuild the forms of a program from a compiled image
+
+\param image the compiled image, e.g. a memory-mapped .plsc file
+\param forms receives one expression per top-level form
+\param expected if not null, the image is only used if it was compiled
+from exactly this text
+\return true if the forms were loaded
+
+If the version stamp does not match COMPILED_FORMAT_VERSION, the program
+text kept in the image is parsed instead. Returns false for a buffer that
+is not an image, a truncated or corrupt image, or text that does not match
+expected.
+ */
+bool load_compiled(const SourceBuffer & image, std::vector<Expression> & forms, const SourceBuffer * expected = nullptr) noexcept;
+
+/*! \fn load_program
+\brief Parse a program, or load it if it was compiled
+
+\param source the program text or compiled image
+\param forms receives one expression per top-level form
+\param threads the number of threads to parse text with
+\return true if the program held one or more forms and all of them loaded
+ */
+bool load_program(const std::shared_ptr<const SourceBuffer> & source, std::vector<Expression> & forms, unsigned threads = 1) noexcept;
+
+#endif
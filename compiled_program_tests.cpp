@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include "compiled_program.hpp"
+#include "parse.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+TEST_CASE( "Test compiled programs round-trip", "[compiled_program]" ) {
+
+  std::shared_ptr<const SourceBuffer> source = std::make_shared<const SourceBuffer>(
+    "(define a (list 1 -2.5e-3 \"a string\"))\n(+ a I)");
+
+  std::vector<Expression> forms;
+  REQUIRE(parse_program(source, forms));
+
+  // a value with a complex head, list flag and a property, as evaluation makes
+  Expression point(Atom(std::complex<double>(1, -2)));
+  point.setList();
+  point.append(Expression(Atom(3.0)));
+  point.add_pair(Expression(Atom("object-name")), Expression(Atom("point", true)));
+  forms.push_back(point);
+
+  std::string image = compile_program(*source, forms);
+  SourceBuffer buffer(image);
+  REQUIRE(is_compiled(buffer));
+  REQUIRE(!is_compiled(*source));
+
+  std::vector<Expression> loaded;
+  REQUIRE(load_compiled(buffer, loaded));
+  REQUIRE(loaded.size() == forms.size());
+  for (std::size_t i = 0; i < forms.size(); ++i) {
+    REQUIRE(loaded[i] == forms[i]);
+    REQUIRE(loaded[i].span().begin.line == forms[i].span().begin.line);
+    REQUIRE(loaded[i].span().end.column == forms[i].span().end.column);
+  }
+
+  // string flags, list flags and properties come back too
+  Expression list = *(loaded[0].tailConstBegin() + 1);
+  REQUIRE(!list.head().isString());
+  REQUIRE((list.tailConstBegin() + 2)->head().isString());
+  REQUIRE(loaded[2].isList());
+  REQUIRE(loaded[2].head().isComplex());
+  Expression key(Atom("object-name"));
+  Expression name = loaded[2].get_value(key);
+  REQUIRE(name.head().isString());
+  REQUIRE(name.head().asSymbol() == "point");
+
+  // only used for the text it was compiled from
+  std::vector<Expression> other;
+  SourceBuffer changed("(+ 1 2)");
+  REQUIRE(!load_compiled(buffer, other, &changed));
+  REQUIRE(load_compiled(buffer, other, source.get()));
+}
+
+TEST_CASE( "Test compiled program versions and corruption", "[compiled_program]" ) {
+
+  std::shared_ptr<const SourceBuffer> source = std::make_shared<const SourceBuffer>("(+ 1 2)");
+  std::vector<Expression> forms;
+  REQUIRE(parse_program(source, forms));
+
+  std::string image = compile_program(*source, forms);
+
+  // another version stamp: the embedded text is parsed instead
+  std::string stale = image;
+  stale[4] = static_cast<char>(COMPILED_FORMAT_VERSION + 1);
+  std::vector<Expression> loaded;
+  REQUIRE(load_compiled(SourceBuffer(stale), loaded));
+  REQUIRE(loaded.size() == 1);
+  REQUIRE(loaded[0] == forms[0]);
+
+  // truncated anywhere
+  for (std::size_t size = 0; size < image.size(); ++size) {
+    std::vector<Expression> partial;
+    REQUIRE(!load_compiled(SourceBuffer(image.substr(0, size)), partial));
+    REQUIRE(partial.empty());
+  }
+
+  // load_program takes either form
+  std::vector<Expression> both;
+  REQUIRE(load_program(std::make_shared<const SourceBuffer>(image), both));
+  REQUIRE(load_program(source, both));
+  REQUIRE(both.size() == 2);
+  REQUIRE(both[0] == both[1]);
+}
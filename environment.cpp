@@ -1,11 +1,16 @@
 #include "environment.hpp"
 
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <iterator>
+#include <limits>
 #include <math.h>
 #include <sstream>
 
 #include "environment.hpp"
+#include "memo_cache.hpp"
+#include "packed_list.hpp"
 #include "semantic_error.hpp"
 
 /***********************************************************************
@@ -420,23 +425,18 @@ Expression complex_conj(const std::vector<Expression> & args) {
 }
 
 Expression lists(const std::vector<Expression> & args) {
-	Expression result(Atom("islist"));
-	result.setList();
-	if (nargs_equal(args, 0)) {
-		return result;
-	}
-	else {		
-		result.setTail(args);
-	}
-	return result;
+	return make_list(args);
 }
 
 Expression first(const std::vector<Expression> & args) {
 	Expression result;
 	if (nargs_equal(args, 1)) {
-		if (args[0].isList()) {
-			if (args[0].getTail().size() > 0) {
-				result = (args[0].getTail().at(0));
+		if (args[0].packed() != nullptr) {
+			result = args[0].packed()->element(0);
+		}
+		else if (args[0].isList()) {
+			if (args[0].tailView().size() > 0) {
+				result = (args[0].tailView().at(0));
 			}
 			else {
 				throw SemanticError("Error in call to first: list cannot be empty.");
@@ -453,13 +453,24 @@ Expression first(const std::vector<Expression> & args) {
 }
 
 Expression rest(const std::vector<Expression> & args) {
-	Expression result(Atom("islist"));
+	Expression result{ Atom(SYM_ISLIST) };
 	if (nargs_equal(args, 1)) {
-		if (args[0].isList()) {
-			if (args[0].getTail().size() > 0) {
-				std::vector<Expression> tmp = args[0].getTail();
-				tmp.erase(tmp.begin());
-				result.setTail(tmp);
+		if (args[0].packed() != nullptr) {
+			const PackedList & list = *args[0].packed();
+			if (list.size() == 1) {
+				result.setList();
+			}
+			else if (list.isComplex()) {
+				result = make_list(std::vector<std::complex<double> >(list.complexes().begin() + 1, list.complexes().end()));
+			}
+			else {
+				result = make_list(std::vector<double>(list.reals().begin() + 1, list.reals().end()));
+			}
+		}
+		else if (args[0].isList()) {
+			Expression::TailView list = args[0].tailView();
+			if (list.size() > 0) {
+				result.setTail(std::vector<Expression>(list.begin() + 1, list.end()));
 				result.setList();
 			}
 			else {
@@ -473,14 +484,17 @@ Expression rest(const std::vector<Expression> & args) {
 	else {
 		throw SemanticError("Error in call to rest: invalid number of arguments.");
 	}
-	return Expression(result);	
+	return result;
 }
 
 Expression length(const std::vector<Expression> & args) {
 	std::size_t result;
 	if (nargs_equal(args, 1)) {
-		if (args[0].isList()) {
-				result = args[0].getTail().size();
+		if (args[0].packed() != nullptr) {
+			result = args[0].packed()->size();
+		}
+		else if (args[0].isList()) {
+				result = args[0].tailView().size();
 		}
 		else {
 			throw SemanticError("Error in call to length: argument not a list.");
@@ -493,13 +507,27 @@ Expression length(const std::vector<Expression> & args) {
 }
 
 Expression append(const std::vector<Expression> & args) {
-	Expression result(Atom("islist"));
+	Expression result{ Atom(SYM_ISLIST) };
 	if (nargs_equal(args, 2)) {
-		if (args[0].isList()) {
+		const PackedList * packed = args[0].packed();
+		if (packed != nullptr && !packed->isComplex() && PackedList::packable(args[1]) && args[1].isHeadNumber()) {
+			std::vector<double> values;
+			values.reserve(packed->size() + 1);
+			values.assign(packed->reals().begin(), packed->reals().end());
+			values.push_back(args[1].head().asNumber());
+			result = make_list(std::move(values));
+		}
+		else if (packed != nullptr && packed->isComplex() && PackedList::packable(args[1]) && args[1].isHeadComplex()) {
+			std::vector<std::complex<double> > values;
+			values.reserve(packed->size() + 1);
+			values.assign(packed->complexes().begin(), packed->complexes().end());
+			values.push_back(args[1].head().asComplex());
+			result = make_list(std::move(values));
+		}
+		else if (args[0].isList()) {
 			std::vector<Expression> tmp = args[0].getTail();
-			tmp.emplace_back(args[1]);
-			result.setTail(tmp);
-			result.setList();
+			tmp.push_back(args[1]);
+			result = make_list(std::move(tmp));
 		}
 		else {
 			throw SemanticError("Error in call to append: first argument is not a list.");
@@ -512,15 +540,33 @@ Expression append(const std::vector<Expression> & args) {
 }
 
 Expression join(const std::vector<Expression> & args) {
-	Expression result(Atom("islist"));
+	Expression result{ Atom(SYM_ISLIST) };
 	if (nargs_equal(args, 2)) {
-		if (args[0].isList() && args[1].isList()) {
+		const PackedList * left = args[0].packed();
+		const PackedList * right = args[1].packed();
+		if (left != nullptr && right != nullptr && left->isComplex() == right->isComplex()) {
+			if (left->isComplex()) {
+				std::vector<std::complex<double> > values;
+				values.reserve(left->size() + right->size());
+				values.insert(values.end(), left->complexes().begin(), left->complexes().end());
+				values.insert(values.end(), right->complexes().begin(), right->complexes().end());
+				result = make_list(std::move(values));
+			}
+			else {
+				std::vector<double> values;
+				values.reserve(left->size() + right->size());
+				values.insert(values.end(), left->reals().begin(), left->reals().end());
+				values.insert(values.end(), right->reals().begin(), right->reals().end());
+				result = make_list(std::move(values));
+			}
+		}
+		else if (args[0].isList() && args[1].isList()) {
+			// mixed lists are joined element by element, and packed again if they allow it
 			std::vector<Expression> tmp = args[0].getTail();
-			std::vector<Expression> tmp1 = args[1].getTail();
-			tmp.insert(tmp.end(), tmp1.begin(), tmp1.end());
-
-			result.setTail(tmp);
-			result.setList();
+			std::vector<Expression> more = args[1].getTail();
+			tmp.reserve(tmp.size() + more.size());
+			std::move(more.begin(), more.end(), std::back_inserter(tmp));
+			result = make_list(std::move(tmp));
 		}
 		else {
 			throw SemanticError("Error in call to join: argument to join is not a list.");
@@ -529,21 +575,20 @@ Expression join(const std::vector<Expression> & args) {
 	else {
 		throw SemanticError("Error in call to join: invalid number of arguments.");
 	}
-	return Expression(result);
+	return result;
 }
 
 Expression range(const std::vector<Expression> & args) {
-	std::vector<Expression> tmp;
-	Expression result(Atom("islist"));
+	std::vector<double> tmp;
+	Expression result;
 	if (nargs_equal(args, 3)) {
 		if (args[0].isHeadNumber() && args[1].isHeadNumber() && args[2].isHeadNumber()) {
 			if (args[0].head().asNumber() < args[1].head().asNumber()) {
 				if (args[2].head().asNumber() > 0) {
 					for (double i = args[0].head().asNumber(); i <= args[1].head().asNumber(); i += args[2].head().asNumber()) {
-						tmp.emplace_back(Atom(i));
+						tmp.push_back(i);
 					}
-					result.setTail(tmp);
-					result.setList();
+					result = make_list(std::move(tmp));
 				}
 				else {
 					throw SemanticError("Error in call to range: third argument must be positive");
@@ -564,20 +609,26 @@ Expression range(const std::vector<Expression> & args) {
 }
 
 Expression make_point(double x, double y) {
-	Expression point(Atom("islist"));
+	Expression point{ Atom(SYM_ISLIST) };
 	point.setList();
-	std::vector<Expression> coords = { Atom(x), Atom(y) };
-	point.setTail(coords);
-	point.add_pair(Expression(Atom("object-name")), Expression(Atom("point")));
+	std::vector<Expression> coords;
+	coords.reserve(2);
+	coords.emplace_back(Atom(x));
+	coords.emplace_back(Atom(y));
+	point.setTail(std::move(coords));
+	point.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_POINT)));
 	return point;
 }
 
 Expression make_line(Expression x, Expression y) {
-	Expression line(Atom("islist"));
+	Expression line{ Atom(SYM_ISLIST) };
 	line.setList();
-	std::vector<Expression> coords = { x, y };
-	line.setTail(coords);
-	line.add_pair(Expression(Atom("object-name")), Expression(Atom("line")));
+	std::vector<Expression> coords;
+	coords.reserve(2);
+	coords.push_back(std::move(x));
+	coords.push_back(std::move(y));
+	line.setTail(std::move(coords));
+	line.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_LINE)));
 	return line;
 }
 
@@ -641,8 +692,22 @@ std::string round_pop(double x) {
 	return ret = precised.str();
 }
 
+// the number of elements of a list, without boxing a packed one
+std::size_t list_size(const Expression & list) {
+	return list.packed() != nullptr ? list.packed()->size() : list.tailView().size();
+}
+
+// the real number at index of a list, without boxing a packed one
+double number_at(const Expression & list, std::size_t index) {
+	const PackedList * packed = list.packed();
+	if (packed != nullptr && !packed->isComplex()) {
+		return packed->reals()[index];
+	}
+	return list.tailView()[index].head().asNumber();
+}
+
 Expression discrete_plot(const std::vector<Expression> & args) {
-	Expression result(Atom("islist"));
+	Expression result{ Atom(SYM_ISLIST) };
 	result.setList();
 	std::vector<Expression> tail;
 
@@ -650,10 +715,10 @@ Expression discrete_plot(const std::vector<Expression> & args) {
 		if (args[0].isList() && args[1].isList()) {
 			// getting text-scale
 			double t_scale = 1;
-			for (unsigned int i = 0; i < args[1].getTail().size(); ++i) {
-				std::string text_scale = args[1].getTail()[i].getTail()[0].head().asSymbol();
-				if (text_scale == "text-scale" && args[1].getTail()[i].getTail()[1].isHeadNumber()) {
-					t_scale = args[1].getTail()[i].getTail()[1].head().asNumber();
+			for (unsigned int i = 0; i < args[1].tailView().size(); ++i) {
+				std::string text_scale = args[1].tailView()[i].tailView()[0].head().asSymbol();
+				if (text_scale == "text-scale" && args[1].tailView()[i].tailView()[1].isHeadNumber()) {
+					t_scale = args[1].tailView()[i].tailView()[1].head().asNumber();
 				}
 			}
 			// getting maxes and mins
@@ -661,15 +726,15 @@ Expression discrete_plot(const std::vector<Expression> & args) {
 			float s_maxX, s_maxY, s_minX, s_minY;
 
 			// getting data, adding lollipops
-			for (unsigned int i = 0; i < args[0].getTail().size(); ++i) {
-				Expression temp = args[0].getTail()[i];
+			for (unsigned int i = 0; i < args[0].tailView().size(); ++i) {
+				const Expression & temp = args[0].tailView()[i];
 				// checking x
-				float x = (float)temp.getTail()[0].head().asNumber();
+				float x = (float)number_at(temp, 0);
 				if (x > maxX) maxX = x;
 				if (x < minX) minX = x;
 
 				// checking y
-				float y = (float)temp.getTail()[1].head().asNumber();
+				float y = (float)number_at(temp, 1);
 				if (y > maxY) maxY = y;
 				if (y < minY) minY = y;
 			}
@@ -677,8 +742,8 @@ Expression discrete_plot(const std::vector<Expression> & args) {
 			double scaled_x = 20 / (maxX - minX);
 			double scaled_y = 20 / (maxY - minY);
 
-			for (unsigned int i = 0; i < args[0].getTail().size(); ++i) {
-				if (args[0].getTail()[i].isList() && args[0].getTail()[i].getTail().size() == 2) {
+			for (unsigned int i = 0; i < args[0].tailView().size(); ++i) {
+				if (args[0].tailView()[i].isList() && list_size(args[0].tailView()[i]) == 2) {
 
 					// updating for bounding box
 					s_maxX = (float)(maxX * scaled_x);
@@ -686,23 +751,22 @@ Expression discrete_plot(const std::vector<Expression> & args) {
 					s_maxY = (float)(maxY * -scaled_y);
 					s_minY = (float)(minY * -scaled_y);
 
-					Expression temp(Atom("islist"));
+					Expression temp{ Atom(SYM_ISLIST) };
 					temp.setList();
 
 					// scaling and pushing
 					std::vector<Expression> sap;
-					sap.push_back(Expression(args[0].getTail()[i].getTail()[0].head().asNumber() * scaled_x));
-					sap.push_back(Expression(args[0].getTail()[i].getTail()[1].head().asNumber() * -scaled_y));
+					sap.push_back(Expression(number_at(args[0].tailView()[i], 0) * scaled_x));
+					sap.push_back(Expression(number_at(args[0].tailView()[i], 1) * -scaled_y));
 
-					temp.setTail(sap);
-					temp.add_pair(Expression(Atom("object-name")), Expression(Atom("point")));
-					temp.add_pair(Expression(Atom("size")), Expression(Atom(0.5)));
+					temp.setTail(std::move(sap));
+					temp.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_POINT)));
+					temp.add_pair(Expression(Atom(SYM_SIZE)), Expression(Atom(0.5)));
 					tail.push_back(temp);
 					
 					// adding a line for every point
-					Expression zeroed = make_point(temp.getTail()[0].head().asNumber(), (0 < s_minY) ? 0: s_minY);
-					Expression lollypop_line = make_line(zeroed, temp);
-					tail.push_back(lollypop_line);
+					Expression zeroed = make_point(temp.tailView()[0].head().asNumber(), (0 < s_minY) ? 0: s_minY);
+					tail.push_back(make_line(std::move(zeroed), std::move(temp)));
 
 				}
 				else {
@@ -715,30 +779,30 @@ Expression discrete_plot(const std::vector<Expression> & args) {
 			// OU top left
 			Atom hm = Atom(round_pop(maxY), true);
 			Expression OU(hm);
-			OU.add_pair(Expression(Atom("position")), make_point(s_minX - 2, s_maxY));
-			OU.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-			OU.add_pair(Expression(Atom("text-scale")), Expression(Atom(t_scale)));
+			OU.add_pair(Expression(Atom(SYM_POSITION)), make_point(s_minX - 2, s_maxY));
+			OU.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+			OU.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(t_scale)));
 
 			// OL bottom left left
 			hm = Atom(round_pop(minY), true);
 			Expression OL(hm);
-			OL.add_pair(Expression(Atom("position")), make_point(s_minX - 2, s_minY));
-			OL.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-			OL.add_pair(Expression(Atom("text-scale")), Expression(Atom(t_scale)));
+			OL.add_pair(Expression(Atom(SYM_POSITION)), make_point(s_minX - 2, s_minY));
+			OL.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+			OL.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(t_scale)));
 
 			// AL bottom left bottom
 			hm = Atom(round_pop(minX), true);
 			Expression AL(hm);
-			AL.add_pair(Expression(Atom("position")), make_point(s_minX, s_minY + 2));
-			AL.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-			AL.add_pair(Expression(Atom("text-scale")), Expression(Atom(t_scale)));
+			AL.add_pair(Expression(Atom(SYM_POSITION)), make_point(s_minX, s_minY + 2));
+			AL.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+			AL.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(t_scale)));
 
 			// AU 
 			hm = Atom(round_pop(maxX), true);
 			Expression AU(hm);
-			AU.add_pair(Expression(Atom("position")), make_point(s_maxX, s_minY + 2));
-			AU.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-			AU.add_pair(Expression(Atom("text-scale")), Expression(Atom(t_scale)));
+			AU.add_pair(Expression(Atom(SYM_POSITION)), make_point(s_maxX, s_minY + 2));
+			AU.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+			AU.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(t_scale)));
 
 			tail.push_back(OU);
 			tail.push_back(OL);
@@ -747,32 +811,32 @@ Expression discrete_plot(const std::vector<Expression> & args) {
 
 			// iterating through options	
 			Expression temp;
-			for (unsigned int i = 0; i < args[1].getTail().size(); ++i) {
-				if (args[1].getTail()[i].isList() && args[1].getTail()[i].getTail()[0].head().isString()) {
-					std::string hha = args[1].getTail()[i].getTail()[0].head().asSymbol();
-					if (hha == "title" && args[1].getTail()[i].getTail()[1].head().isString()) {
-						temp = Atom(args[1].getTail()[i].getTail()[1].head().asSymbol(), true);
-						temp.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-						temp.add_pair(Expression(Atom("position")), make_point(0, s_maxY - 3));
-						temp.add_pair(Expression(Atom("text-scale")), Expression(Atom(t_scale)));
+			for (unsigned int i = 0; i < args[1].tailView().size(); ++i) {
+				if (args[1].tailView()[i].isList() && args[1].tailView()[i].tailView()[0].head().isString()) {
+					std::string hha = args[1].tailView()[i].tailView()[0].head().asSymbol();
+					if (hha == "title" && args[1].tailView()[i].tailView()[1].head().isString()) {
+						temp = Atom(args[1].tailView()[i].tailView()[1].head().asSymbol(), true);
+						temp.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+						temp.add_pair(Expression(Atom(SYM_POSITION)), make_point(0, s_maxY - 3));
+						temp.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(t_scale)));
 					}
-					else if (hha == "abscissa-label" && args[1].getTail()[i].getTail()[1].head().isString()) {
-						temp = Atom(args[1].getTail()[i].getTail()[1].head().asSymbol(), true);
-						temp.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-						temp.add_pair(Expression(Atom("position")), make_point(0, s_minY + 3));
-						temp.add_pair(Expression(Atom("text-scale")), Expression(Atom(t_scale)));
+					else if (hha == "abscissa-label" && args[1].tailView()[i].tailView()[1].head().isString()) {
+						temp = Atom(args[1].tailView()[i].tailView()[1].head().asSymbol(), true);
+						temp.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+						temp.add_pair(Expression(Atom(SYM_POSITION)), make_point(0, s_minY + 3));
+						temp.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(t_scale)));
 					}
-					else if (hha == "ordinate-label" && args[1].getTail()[i].getTail()[1].head().isString()) {
-						temp = Atom(args[1].getTail()[i].getTail()[1].head().asSymbol(), true);
-						temp.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-						temp.add_pair(Expression(Atom("text-rotation")), Expression(Atom(1.5708)));
-						temp.add_pair(Expression(Atom("position")), make_point(s_minX - 3, s_minY - 10));
-						temp.add_pair(Expression(Atom("text-scale")), Expression(Atom(t_scale)));
+					else if (hha == "ordinate-label" && args[1].tailView()[i].tailView()[1].head().isString()) {
+						temp = Atom(args[1].tailView()[i].tailView()[1].head().asSymbol(), true);
+						temp.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+						temp.add_pair(Expression(Atom(SYM_TEXT_ROTATION)), Expression(Atom(1.5708)));
+						temp.add_pair(Expression(Atom(SYM_POSITION)), make_point(s_minX - 3, s_minY - 10));
+						temp.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(t_scale)));
 					}
 					else {
 						break;
 					}
-					tail.push_back(temp);
+					tail.push_back(std::move(temp));
 				}
 				else {
 					throw SemanticError("Error in call to discrete-plot: second list must contain only string options.");
@@ -782,7 +846,7 @@ Expression discrete_plot(const std::vector<Expression> & args) {
 			// adding bounding box
 			std::vector<Expression> t = make_box(s_minX, s_maxX, s_minY, s_maxY);
 			for (unsigned int i = 0; i < t.size(); ++i) {
-				tail.push_back(t[i]);
+				tail.push_back(std::move(t[i]));
 			}
 		}
 		else {
@@ -792,10 +856,50 @@ Expression discrete_plot(const std::vector<Expression> & args) {
 	else {
 		throw SemanticError("Error in call to discrete plot: invalid number of arguments.");
 	}
-	result.setTail(tail);
+	result.setTail(std::move(tail));
 	return result;
 }
 
+// whether an argument is a lambda value
+bool is_lambda_value(const Expression & arg) {
+	return arg.head().asSymbolId() == SYM_LAMBDA && arg.tailView().size() == 2;
+}
+
+Expression memoize(const std::vector<Expression> & args) {
+	if (args.size() != 1 && args.size() != 2) {
+		throw SemanticError("Error in call to memoize: invalid number of arguments.");
+	}
+	if (!is_lambda_value(args[0])) {
+		throw SemanticError("Error in call to memoize: first argument not a lambda.");
+	}
+
+	std::size_t capacity = MemoCache::DEFAULT_CAPACITY;
+	if (args.size() == 2) {
+		double value = args[1].isHeadNumber() ? args[1].head().asNumber() : 0;
+		if (!(value >= 1 && value == std::floor(value))) {
+			throw SemanticError("Error in call to memoize: capacity must be a positive integer.");
+		}
+		capacity = (value < double(std::numeric_limits<std::size_t>::max())) ? std::size_t(value) : std::numeric_limits<std::size_t>::max();
+	}
+	return Expression::memoized(args[0], capacity);
+}
+
+Expression memo_stats(const std::vector<Expression> & args) {
+	if (!nargs_equal(args, 1)) {
+		throw SemanticError("Error in call to memo-stats: invalid number of arguments.");
+	}
+	const MemoCache * memo = args[0].memo();
+	if (memo == nullptr) {
+		throw SemanticError("Error in call to memo-stats: argument not a memoized lambda.");
+	}
+
+	// read once each, calls on other threads may be counted meanwhile
+	std::vector<double> stats = {
+		double(memo->hits()), double(memo->misses()), double(memo->size()), double(memo->capacity())
+	};
+	return make_list(std::move(stats));
+}
+
 /*std::vector<Expression> results;
 	for (Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it) {
 		results.push_back(it->eval(env));
@@ -835,154 +939,297 @@ Environment::Environment() {
 	reset();
 }
 
-Environment::Environment(const Environment & env) {
-	std::map<std::string, EnvResult> tmp(env.envmap);
-	envmap = tmp;
+Environment::Environment(const Environment & env) :
+	shadowed(env.shadowed), envmap(env.envmap), parent(env.parent) {
+
+	// the copy may outlive the current evaluation, and its arena
+	HeapScope heap;
+	frame = env.frame;
+}
+
+Environment & Environment::operator=(const Environment & env) {
+
+	shadowed = env.shadowed;
+	envmap = env.envmap;
+	parent = env.parent;
+
+	// a new copy, rather than one in the storage this frame may have in the arena
+	HeapScope heap;
+	frame = decltype(frame)(env.frame);
+	return *this;
+}
+
+Environment::Environment(const Environment & parent, std::size_t bindings) :
+	shadowed(parent.shadowed), parent(&parent) {
+	frame.reserve(bindings);
+}
+
+const Environment::EnvResult * Environment::lookup(SymbolId sym) const {
+	// the frames of the calls in progress, innermost first
+	const Environment * env = this;
+	for (; env->parent != nullptr; env = env->parent) {
+		for (auto & binding : env->frame) {
+			if (binding.first == sym) {
+				return &binding.second;
+			}
+		}
+	}
+
+	const EnvResult * result = env->envmap.get(sym);
+	return (result != nullptr) ? result : builtins().get(sym);
 }
 
 bool Environment::is_known(const Atom & sym) const {
 	if (!sym.isSymbol()) return false;
 
-	return envmap.find(sym.asSymbol()) != envmap.end();
+	return lookup(sym.asSymbolId()) != nullptr;
 }
 
 bool Environment::is_exp(const Atom & sym) const {
 	if (!sym.isSymbol()) return false;
 
-	auto result = envmap.find(sym.asSymbol());
-	return (result != envmap.end()) && (result->second.type == ExpressionType);
+	const EnvResult * result = lookup(sym.asSymbolId());
+	return (result != nullptr) && (result->type == ExpressionType);
 }
 
-Expression Environment::get_exp(const Atom & sym) const {
+const Expression & Environment::get_exp(const Atom & sym) const {
 
-	Expression exp;
+	static const Expression none;
 
 	if (sym.isSymbol()) {
-		auto result = envmap.find(sym.asSymbol());
-		if ((result != envmap.end()) && (result->second.type == ExpressionType)) {
-			exp = result->second.exp;
+		const EnvResult * result = lookup(sym.asSymbolId());
+		if ((result != nullptr) && (result->type == ExpressionType)) {
+			return result->exp;
 		}
 	}
 
-	return exp;
+	return none;
 }
 
-void Environment::add_exp(const Atom & sym, const Expression & exp) {
+void Environment::add_exp(const Atom & sym, Expression exp) {
+
+	// the environment, and so its nodes, may outlive the current evaluation
+	HeapScope heap;
+	bind(sym, std::move(exp));
+}
+
+void Environment::bind(const Atom & sym, Expression exp) {
 
 	if (!sym.isSymbol()) {
 		throw SemanticError("Attempt to add non-symbol to environment");
 	}
 
-	// error if overwriting symbol map
-	if (envmap.find(sym.asSymbol()) != envmap.end()) {
-		envmap[sym.asSymbol()] = EnvResult(ExpressionType, exp);
+	SymbolId id = sym.asSymbolId();
+	if (!shadowed && ((id >= SYM_SET_PROPERTY && id <= SYM_CONTINUOUS_PLOT) || (id >= SYM_PI && id <= SYM_I) || builtin(id) != nullptr)) {
+		shadowed = true;
+	}
+
+	// a frame binds in front of its parent, which is left alone
+	if (parent != nullptr) {
+		for (auto & binding : frame) {
+			if (binding.first == id) {
+				binding.second = EnvResult(ExpressionType, std::move(exp));
+				return;
+			}
+		}
+		frame.emplace_back(id, EnvResult(ExpressionType, std::move(exp)));
+		return;
 	}
 
-	envmap.emplace(sym.asSymbol(), EnvResult(ExpressionType, exp));
+	// overwrite any existing mapping
+	envmap.set(id, EnvResult(ExpressionType, std::move(exp)));
 }
 
 bool Environment::is_proc(const Atom & sym) const {
 	if (!sym.isSymbol()) return false;
 
-	auto result = envmap.find(sym.asSymbol());
-	return (result != envmap.end()) && (result->second.type == ProcedureType);
+	const EnvResult * result = lookup(sym.asSymbolId());
+	return (result != nullptr) && (result->type == ProcedureType);
 }
 
 Procedure Environment::get_proc(const Atom & sym) const {
 
 	if (sym.isSymbol()) {
-		auto result = envmap.find(sym.asSymbol());
-		if ((result != envmap.end()) && (result->second.type == ProcedureType)) {
-			return result->second.proc;
+		const EnvResult * result = lookup(sym.asSymbolId());
+		if ((result != nullptr) && (result->type == ProcedureType)) {
+			return result->proc;
 		}
 	}
 
 	return default_proc;
 }
 
-/*
-Reset the environment to the default state. First remove all entries and
-then re-add the default ones.
-*/
-void Environment::reset() {
+const Expression * Environment::find(SymbolId sym, Procedure & proc) const {
+	const EnvResult * result = lookup(sym);
+	if (result == nullptr) return nullptr;
+	if (result->type == ProcedureType) {
+		proc = result->proc;
+		return nullptr;
+	}
+	return &result->exp;
+}
 
-	envmap.clear();
+const std::size_t Environment::NO_SLOT;
+const std::size_t Environment::BUILTIN_SLOT;
+
+const Expression * Environment::find(SymbolId sym, Procedure & proc, std::size_t & slot) const {
+	// frames are searched as lookup does, the hint is for the table below them
+	const Environment * env = this;
+	const EnvResult * result = nullptr;
+	for (; env->parent != nullptr && result == nullptr; env = env->parent) {
+		for (auto & binding : env->frame) {
+			if (binding.first == sym) {
+				result = &binding.second;
+				break;
+			}
+		}
+	}
+
+	// the hint is only trusted once it is seen to hold sym; a built-in may
+	// only be defined over by binding a name that sets shadowed
+	if (result == nullptr && slot >= BUILTIN_SLOT && !env->shadowed && builtins().holds(slot - BUILTIN_SLOT, sym)) {
+		result = &builtins().entry(slot - BUILTIN_SLOT).second;
+	}
+	else if (result == nullptr) {
+		result = env->envmap.get(sym, slot);
+		if (result == nullptr) {
+			std::size_t builtin = builtins().find(sym);
+			if (builtin == NO_SLOT) return nullptr;
+			result = &builtins().entry(builtin).second;
+			slot = BUILTIN_SLOT + builtin;
+		}
+	}
+
+	if (result->type == ProcedureType) {
+		proc = result->proc;
+		return nullptr;
+	}
+	return &result->exp;
+}
+
+bool Environment::shadows_builtins() const noexcept {
+	return shadowed;
+}
+
+Procedure Environment::builtin(SymbolId sym) noexcept {
+	// the procedures of the default environment, by symbol, taken on first use
+	static const std::array<Procedure, KNOWN_SYMBOL_COUNT> procedures = [] {
+		std::array<Procedure, KNOWN_SYMBOL_COUNT> table{};
+		for (auto & entry : builtins()) {
+			if (entry.second.type == ProcedureType && entry.first < KNOWN_SYMBOL_COUNT) {
+				table[entry.first] = entry.second.proc;
+			}
+		}
+		return table;
+	}();
+
+	return (sym < KNOWN_SYMBOL_COUNT) ? procedures[sym] : nullptr;
+}
 
-	// Built-In value of pi
-	envmap.emplace("pi", EnvResult(ExpressionType, Expression(PI)));
+const SlotTable<Environment::EnvResult> & Environment::builtins() {
+	// built on first use and never changed, so shared by every thread
+	static const SlotTable<EnvResult> shared = [] {
+		SlotTable<EnvResult> table;
+		HeapScope heap;
 
-	// built-in value of exp
-	envmap.emplace("e", EnvResult(ExpressionType, Expression(EXP)));
+		// Built-In value of pi
+		table.set(SYM_PI, EnvResult(ExpressionType, Expression(PI)));
 
-	// built-in value of i
-	envmap.emplace("I", EnvResult(ExpressionType, Expression(I)));
+		// built-in value of exp
+		table.set(SYM_E, EnvResult(ExpressionType, Expression(EXP)));
 
-	// Procedure: add;
-	envmap.emplace("+", EnvResult(ProcedureType, add));
+		// built-in value of i
+		table.set(SYM_I, EnvResult(ExpressionType, Expression(I)));
 
-	// Procedure: subneg;
-	envmap.emplace("-", EnvResult(ProcedureType, subneg));
+		// Procedure: add;
+		table.set(SYM_ADD, EnvResult(ProcedureType, add));
 
-	// Procedure: mul;
-	envmap.emplace("*", EnvResult(ProcedureType, mul));
+		// Procedure: subneg;
+		table.set(SYM_SUB, EnvResult(ProcedureType, subneg));
 
-	// Procedure: div;
-	envmap.emplace("/", EnvResult(ProcedureType, div));
+		// Procedure: mul;
+		table.set(SYM_MUL, EnvResult(ProcedureType, mul));
 
-	// Procedure: sqrt;
-	envmap.emplace("sqrt", EnvResult(ProcedureType, sqroot));
+		// Procedure: div;
+		table.set(SYM_DIV, EnvResult(ProcedureType, div));
 
-	// Procedure: exponential;
-	envmap.emplace("^", EnvResult(ProcedureType, expo));
+		// Procedure: sqrt;
+		table.set(SYM_SQRT, EnvResult(ProcedureType, sqroot));
 
-	// Procedure: ln;
-	envmap.emplace("ln", EnvResult(ProcedureType, nln));
+		// Procedure: exponential;
+		table.set(SYM_POW, EnvResult(ProcedureType, expo));
 
-	// Procedure: sin;
-	envmap.emplace("sin", EnvResult(ProcedureType, sine));
+		// Procedure: ln;
+		table.set(SYM_LN, EnvResult(ProcedureType, nln));
 
-	// Procedure: cos;
-	envmap.emplace("cos", EnvResult(ProcedureType, cosine));
+		// Procedure: sin;
+		table.set(SYM_SIN, EnvResult(ProcedureType, sine));
 
-	// Procedure: tan;
-	envmap.emplace("tan", EnvResult(ProcedureType, tangent));
+		// Procedure: cos;
+		table.set(SYM_COS, EnvResult(ProcedureType, cosine));
 
-	// Procedure: real;
-	envmap.emplace("real", EnvResult(ProcedureType, complex_real));
+		// Procedure: tan;
+		table.set(SYM_TAN, EnvResult(ProcedureType, tangent));
 
-	// Procedure: imag;
-	envmap.emplace("imag", EnvResult(ProcedureType, complex_imag));
+		// Procedure: real;
+		table.set(SYM_REAL, EnvResult(ProcedureType, complex_real));
 
-	// Procedure: mag;
-	envmap.emplace("mag", EnvResult(ProcedureType, complex_mag));
+		// Procedure: imag;
+		table.set(SYM_IMAG, EnvResult(ProcedureType, complex_imag));
 
-	// Procedure: arg;
-	envmap.emplace("arg", EnvResult(ProcedureType, complex_arg));
+		// Procedure: mag;
+		table.set(SYM_MAG, EnvResult(ProcedureType, complex_mag));
 
-	// Procedure: conj;
-	envmap.emplace("conj", EnvResult(ProcedureType, complex_conj));
+		// Procedure: arg;
+		table.set(SYM_ARG, EnvResult(ProcedureType, complex_arg));
 
-	// Procedure: list
-	envmap.emplace("list", EnvResult(ProcedureType, lists));
+		// Procedure: conj;
+		table.set(SYM_CONJ, EnvResult(ProcedureType, complex_conj));
 
-	// Procedure: first
-	envmap.emplace("first", EnvResult(ProcedureType, first));
+		// Procedure: list
+		table.set(SYM_LIST, EnvResult(ProcedureType, lists));
 
-	// Procedure: rest
-	envmap.emplace("rest", EnvResult(ProcedureType, rest));
+		// Procedure: first
+		table.set(SYM_FIRST, EnvResult(ProcedureType, first));
 
-	// Procedure: length
-	envmap.emplace("length", EnvResult(ProcedureType, length));
+		// Procedure: rest
+		table.set(SYM_REST, EnvResult(ProcedureType, rest));
 
-	// Procedure: append
-	envmap.emplace("append", EnvResult(ProcedureType, append));
+		// Procedure: length
+		table.set(SYM_LENGTH, EnvResult(ProcedureType, length));
 
-	// Procedure: join
-	envmap.emplace("join", EnvResult(ProcedureType, join));
+		// Procedure: append
+		table.set(SYM_APPEND, EnvResult(ProcedureType, append));
 
-	// Procedure: range
-	envmap.emplace("range", EnvResult(ProcedureType, range));
+		// Procedure: join
+		table.set(SYM_JOIN, EnvResult(ProcedureType, join));
 
-	// Procedure: discrete-plot
-	envmap.emplace("discrete-plot", EnvResult(ProcedureType, discrete_plot));
+		// Procedure: range
+		table.set(SYM_RANGE, EnvResult(ProcedureType, range));
+
+		// Procedure: discrete-plot
+		table.set(SYM_DISCRETE_PLOT, EnvResult(ProcedureType, discrete_plot));
+
+		// Procedure: memoize
+		table.set(SYM_MEMOIZE, EnvResult(ProcedureType, memoize));
+
+		// Procedure: memo-stats
+		table.set(SYM_MEMO_STATS, EnvResult(ProcedureType, memo_stats));
+
+		return table;
+	}();
+
+	return shared;
+}
+
+/*
+Reset the environment to the default state. The defaults are not in the
+environment itself, so removing every definition is enough.
+*/
+void Environment::reset() {
+
+	envmap.clear();
+	parent = nullptr;
+	frame.clear();
+	shadowed = false;
 }
\ No newline at end of file
@@ -11,11 +11,16 @@ needed.
 #define ENVIRONMENT_HPP
 
  // system includes
-#include <map>
+#include <cstddef>
+#include <utility>
+#include <vector>
 
 // module includes
 #include "atom.hpp"
+#include "eval_arena.hpp"
 #include "expression.hpp"
+#include "persistent_map.hpp"
+#include "slot_table.hpp"
 
 /*! \typedef Procedure
 \brief A Procedure is a C++ function pointer taking a vector of
@@ -36,6 +41,22 @@ return you can obtain
 the mapped-to value using get_exp or get_proc.
 
 To add an symbol to expression mapping use the add_exp member function.
+
+A lambda call runs in a frame: an environment holding only the bindings
+made during the call, e.g. its arguments, that looks up every other symbol
+in the environment the call was made in, and so on outwards. Making one
+copies nothing, and its bindings are taken from the evaluation arena, which
+reuses the storage of frames that have ended.
+
+The built-in procedures and constants are kept in one table for the whole
+process, behind the definitions of every environment, so an environment
+holds only what was defined in it: constructing, copying and resetting one
+costs nothing for the built-ins.
+
+The definitions are kept in a persistent map, so a copy of an environment,
+e.g. a snapshot, shares them with the original rather than copying them.
+Making the copy takes constant time, and a definition made in either one
+afterwards copies only the few nodes leading to it.
  */
 class Environment {
 public:
@@ -43,9 +64,30 @@ public:
 	 * definitions. */
 	Environment();
 
-	/*! Copy constructor for Environment */
+	/*! Copy constructor for Environment; a copy of a frame is a frame of
+	 * the same parent, with its bindings on the heap rather than in the
+	 * evaluation arena. */
 	Environment(const Environment & env);
 
+	/*! Construct a frame in front of parent, for a lambda call: it sees
+	  every binding of parent, and binding a symbol in it leaves parent
+	  alone, as if it were a copy of parent. parent must outlive the frame
+	  and not change while the frame is in use.
+	  \param parent the environment the call is made in
+	  \param bindings the number of bindings to make room for, e.g. the arguments
+	 */
+	Environment(const Environment & parent, std::size_t bindings);
+
+	/*! Move constructor for Environment */
+	Environment(Environment && env) = default;
+
+	/*! Copy assignment for Environment, taking the bindings of a frame
+	 * onto the heap like the copy constructor */
+	Environment & operator=(const Environment & env);
+
+	/*! Move assignment for Environment */
+	Environment & operator=(Environment && env) = default;
+
 	/*! Determine if a symbol is known to the environment.
 	  \param sym the sumbol to lookup
 	  \return true if the symbol has been defined in the environment
@@ -61,15 +103,24 @@ public:
 
 	/*! Get the Expression the argument symbol maps to.
 	  \param sym the symbol to lookup
-	  \return the expression the symbol maps to or an Expression of NoneType
+	  \return the expression the symbol maps to or an Expression of NoneType,
+	  valid until the environment is next changed
 	*/
-	Expression get_exp(const Atom &sym) const;
+	const Expression & get_exp(const Atom &sym) const;
 
 	/*! Add a mapping from sym argument to the exp argument within the environment.
+	  \param sym the symbol to add
+	  \param exp the expression the symbol should map to, moved from if an rvalue
+	 */
+	void add_exp(const Atom &sym, Expression exp);
+
+	/*! Add a mapping like add_exp, for an environment that does not outlive
+	  the current evaluation, e.g. the one a lambda call runs in. The new node
+	  is taken from the evaluation arena if one is open.
 	  \param sym the symbol to add
 	  \param exp the expression the symbol should map to
 	 */
-	void add_exp(const Atom &sym, const Expression &exp);
+	void bind(const Atom &sym, Expression exp);
 
 	/*! Determine if a symbol has been defined as a procedure
 	  \param sym the symbol to lookup
@@ -86,11 +137,53 @@ public:
 	*/
 	Procedure get_proc(const Atom &sym) const;
 
+	/*! Look up a symbol once, whatever it maps to, for callers that would
+	  otherwise ask is_exp and then is_proc.
+	  \param sym the symbol to lookup
+	  \param proc set to the procedure sym maps to, if it maps to one
+	  \return the expression sym maps to, or nullptr if it does not map to one;
+	  valid until the environment is next changed
+	 */
+	const Expression * find(SymbolId sym, Procedure & proc) const;
+
+	/// what a slot hint starts out as, before find has filled it in
+	static const std::size_t NO_SLOT = std::size_t(-1);
+
+	/*! Look up a symbol like find, starting with the place it was found
+	  last time. A caller that looks the same symbol up again and again, e.g.
+	  a compiled variable reference, keeps slot between calls; a hint that
+	  has gone stale, or came from another environment, is checked and
+	  costs a lookup without it.
+	  \param sym the symbol to lookup
+	  \param proc set to the procedure sym maps to, if it maps to one
+	  \param slot the hint, NO_SLOT at first, updated to where sym was found
+	  \return as for find
+	 */
+	const Expression * find(SymbolId sym, Procedure & proc, std::size_t & slot) const;
+
+	/*! Determine if a name the default environment gives a built-in
+	  procedure or constant, or set-property, get-property or continuous-plot,
+	  has been bound to an expression, here or in the environment this was
+	  copied from. Until then a call of such a name can be dispatched without
+	  looking it up, and a call folded by Expression::fold_constants stands.
+	  \return true if one of the names has been bound
+	 */
+	bool shadows_builtins() const noexcept;
+
+	/*! Get the built-in procedure a symbol names in the default environment
+	  \param sym the symbol to lookup
+	  \return the procedure, or nullptr if sym does not name one
+	 */
+	static Procedure builtin(SymbolId sym) noexcept;
+
 	/*! Reset the environment to its default state. */
 	void reset();
 
 	private:
 	bool is_lambda = false;
+
+	// see shadows_builtins
+	bool shadowed = false;
 	// Environment is a mapping from symbols to expressions or procedures
 	enum EnvResultType { ExpressionType, ProcedureType };
 
@@ -101,12 +194,31 @@ public:
 
 		// constructors for use in container emplace
 		EnvResult() {};
-		EnvResult(EnvResultType t, Expression e) : type(t), exp(e) {};
+		EnvResult(EnvResultType t, Expression e) : type(t), exp(std::move(e)) {};
 		EnvResult(EnvResultType t, Procedure p) : type(t), proc(p) {};
 	};
 
-	// the environment map
-	std::map<std::string, EnvResult> envmap;
+	// the entry for sym here, in a parent or among the built-ins, or nullptr
+	const EnvResult * lookup(SymbolId sym) const;
+
+	// the built-in procedures and constants every environment starts with,
+	// made once for the process and never changed
+	static const SlotTable<EnvResult> & builtins();
+
+	// what find adds to a slot of builtins to tell it from a slot of envmap
+	static const std::size_t BUILTIN_SLOT = std::size_t(1) << (8 * sizeof(std::size_t) - 2);
+
+	// the definitions made in the environment, in front of the built-ins,
+	// keyed by interned symbol, whose slots find hands out as hints; shared
+	// with copies until one of them changes
+	PersistentMap<EnvResult> envmap;
+
+	// the environment a frame looks up what it does not bind, nullptr if
+	// this is not a frame and everything is in envmap
+	const Environment * parent = nullptr;
+
+	// the bindings of a frame, few enough to search in order
+	std::vector<std::pair<SymbolId, EnvResult>, EvalAllocator<std::pair<SymbolId, EnvResult> > > frame;
 };
 
 #endif
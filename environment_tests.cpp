@@ -763,6 +763,31 @@ TEST_CASE( "Test reset", "[environment]" ) {
   REQUIRE(env.get_exp(Atom("hi")) == Expression());
 }
 
+TEST_CASE( "Test the built-ins are shared by every environment", "[environment]" ) {
+  Environment env;
+  Environment other;
+
+  INFO("defining over a built-in hides it in that environment only");
+  Procedure proc = nullptr;
+  std::size_t slot = Environment::NO_SLOT;
+  REQUIRE(env.find(intern("+"), proc, slot) == nullptr);
+  REQUIRE(proc == Environment::builtin(intern("+")));
+  env.add_exp(Atom("+"), Expression(1));
+  env.add_exp(Atom("pi"), Expression(3));
+  REQUIRE(*env.find(intern("+"), proc, slot) == Expression(1));
+  REQUIRE(env.get_exp(Atom("pi")) == Expression(3));
+  REQUIRE(other.is_proc(Atom("+")));
+  REQUIRE(other.get_exp(Atom("pi")) == Expression(std::atan2(0, -1)));
+
+  INFO("copies and resets keep to their own definitions");
+  Environment copy(env);
+  REQUIRE(copy.get_exp(Atom("+")) == Expression(1));
+  env.reset();
+  REQUIRE(env.is_proc(Atom("+")));
+  REQUIRE(env.get_exp(Atom("pi")) == Expression(std::atan2(0, -1)));
+  REQUIRE(copy.get_exp(Atom("pi")) == Expression(3));
+}
+
 TEST_CASE( "Test semeantic errors", "[environment]" ) {
 
   Environment env;
@@ -774,3 +799,39 @@ TEST_CASE( "Test semeantic errors", "[environment]" ) {
   }
 }
 
+
+TEST_CASE( "Test frames for lambda calls", "[environment]" ) {
+  Environment env;
+  env.add_exp(Atom("a"), Expression(1));
+
+  Environment frame(env, 1);
+  frame.bind(Atom("x"), Expression(2));
+
+  INFO("a frame sees its own bindings and those of its parent");
+  REQUIRE(frame.get_exp(Atom("x")) == Expression(2));
+  REQUIRE(frame.get_exp(Atom("a")) == Expression(1));
+  REQUIRE(frame.is_proc(Atom("+")));
+  REQUIRE(!env.is_known(Atom("x")));
+
+  INFO("binding in a frame hides the parent's binding and leaves it alone");
+  frame.add_exp(Atom("a"), Expression(3));
+  REQUIRE(frame.get_exp(Atom("a")) == Expression(3));
+  REQUIRE(env.get_exp(Atom("a")) == Expression(1));
+
+  INFO("frames nest, and a copy of a frame has the same parent");
+  Environment inner(frame, 0);
+  REQUIRE(inner.get_exp(Atom("a")) == Expression(3));
+  REQUIRE(inner.get_exp(Atom("x")) == Expression(2));
+  Environment copy(inner);
+  copy.bind(Atom("x"), Expression(4));
+  REQUIRE(copy.get_exp(Atom("x")) == Expression(4));
+  REQUIRE(inner.get_exp(Atom("x")) == Expression(2));
+
+  INFO("rebinding a built-in name in a frame is seen by it and its own frames only");
+  REQUIRE(!frame.shadows_builtins());
+  frame.bind(Atom("+"), Expression(5));
+  REQUIRE(frame.shadows_builtins());
+  REQUIRE(Environment(frame, 0).shadows_builtins());
+  REQUIRE(!env.shadows_builtins());
+  REQUIRE(env.is_proc(Atom("+")));
+}
@@ -0,0 +1,231 @@
+#include "eval_arena.hpp"
+
+#include <cassert>
+
+namespace {
+
+// every block is aligned for any type, and sizes are rounded up to this
+const std::size_t ALIGNMENT = alignof(std::max_align_t);
+
+// chunks start small and double, so short evaluations stay cheap
+const std::size_t FIRST_CHUNK = 64 * 1024;
+const std::size_t MAX_CHUNK = 4 * 1024 * 1024;
+
+// blocks this big are rare and long-lived, e.g. the tail of a long list,
+// and go straight to the heap so the arena does not hold dead copies of them
+const std::size_t LARGE_BLOCK = 1024;
+
+// one free list per block size below LARGE_BLOCK
+const std::size_t SIZE_CLASSES = LARGE_BLOCK / ALIGNMENT;
+
+// chunks kept between evaluations, so their pages stay mapped
+const std::size_t RETAINED = 4 * 1024 * 1024;
+
+// at most this many chunks, after which blocks come from the heap
+const std::size_t MAX_CHUNKS = 64;
+
+struct Chunk {
+	char * begin;
+	char * end;
+};
+
+// a freed block, linked into the free list for its size
+struct FreeBlock {
+	FreeBlock * next;
+};
+
+// plain data, so the compiler can reach a thread's copy without a guard
+struct ArenaState {
+	unsigned depth;
+	bool suspended;
+	char * pos;
+	char * end;
+	Chunk chunks[MAX_CHUNKS];
+	std::size_t chunk_count;
+	std::size_t current; // the chunk pos is in
+	FreeBlock * free[SIZE_CLASSES];
+	std::size_t heap_allocations;
+	std::size_t arena_allocations;
+
+	// move to the next chunk with room for at least bytes, adding one if
+	// needed; false if the arena is full
+	bool grow(std::size_t bytes);
+
+	// forget every block, keeping up to RETAINED bytes of chunks for the next evaluation
+	void release() noexcept;
+};
+
+thread_local ArenaState state;
+
+// frees a thread's chunks when the thread ends
+struct ChunkReleaser {
+	~ChunkReleaser() {
+		for (std::size_t i = 0; i < state.chunk_count; ++i) {
+			::operator delete(state.chunks[i].begin);
+		}
+		// leave nothing to find for expressions freed after this
+		state.chunk_count = 0;
+		state.pos = state.end = nullptr;
+	}
+};
+
+thread_local ChunkReleaser releaser;
+
+bool ArenaState::grow(std::size_t bytes) {
+	while (++current < chunk_count) {
+		if (static_cast<std::size_t>(chunks[current].end - chunks[current].begin) >= bytes) {
+			pos = chunks[current].begin;
+			end = chunks[current].end;
+			return true;
+		}
+	}
+
+	if (chunk_count == MAX_CHUNKS) {
+		current = chunk_count - 1;
+		return false;
+	}
+
+	std::size_t size = chunk_count == 0 ? FIRST_CHUNK : 2 * static_cast<std::size_t>(chunks[chunk_count - 1].end - chunks[chunk_count - 1].begin);
+	if (size > MAX_CHUNK) size = MAX_CHUNK;
+	if (size < bytes) size = bytes;
+
+	char * begin = static_cast<char *>(::operator new(size));
+	if (chunk_count == 0) {
+		// make sure the chunks are freed with the thread
+		(void)&releaser;
+	}
+	chunks[chunk_count] = Chunk{ begin, begin + size };
+	current = chunk_count++;
+	pos = begin;
+	end = begin + size;
+	return true;
+}
+
+void ArenaState::release() noexcept {
+	std::size_t kept = 0;
+	std::size_t retained = 0;
+	for (std::size_t i = 0; i < chunk_count; ++i) {
+		std::size_t size = chunks[i].end - chunks[i].begin;
+		if (retained + size <= RETAINED) {
+			retained += size;
+			chunks[kept++] = chunks[i];
+		}
+		else {
+			::operator delete(chunks[i].begin);
+		}
+	}
+	chunk_count = kept;
+
+	current = 0;
+	if (chunk_count == 0) {
+		pos = end = nullptr;
+	}
+	else {
+		pos = chunks[0].begin;
+		end = chunks[0].end;
+	}
+
+	for (auto & list : free) {
+		list = nullptr;
+	}
+}
+
+// whether block lies in one of the chunks of s, released or not
+bool in_chunks(const ArenaState & s, const void * block) noexcept {
+	const char * p = static_cast<const char *>(block);
+	for (std::size_t i = 0; i < s.chunk_count; ++i) {
+		if (p >= s.chunks[i].begin && p < s.chunks[i].end) {
+			return true;
+		}
+	}
+	return false;
+}
+
+}
+
+void * EvalArena::allocate(std::size_t bytes) {
+	ArenaState & s = state;
+	if (s.depth == 0 || s.suspended || bytes >= LARGE_BLOCK) {
+		++s.heap_allocations;
+		return ::operator new(bytes);
+	}
+
+	++s.arena_allocations;
+	bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	// reuse a block freed earlier in this evaluation, it is likely still cached
+	FreeBlock *& list = s.free[bytes / ALIGNMENT - 1];
+	if (list != nullptr) {
+		FreeBlock * block = list;
+		list = block->next;
+		return block;
+	}
+
+	if (static_cast<std::size_t>(s.end - s.pos) < bytes && !s.grow(bytes)) {
+		--s.arena_allocations;
+		++s.heap_allocations;
+		return ::operator new(bytes);
+	}
+
+	void * block = s.pos;
+	s.pos += bytes;
+	return block;
+}
+
+void EvalArena::deallocate(void * block, std::size_t bytes) noexcept {
+	if (block == nullptr) {
+		return;
+	}
+
+	if (bytes < LARGE_BLOCK && owns(block)) {
+		// kept for reuse until the arena is released
+		ArenaState & s = state;
+		bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+		FreeBlock *& list = s.free[bytes / ALIGNMENT - 1];
+		FreeBlock * freed = static_cast<FreeBlock *>(block);
+		freed->next = list;
+		list = freed;
+		return;
+	}
+
+	// an arena block has to be freed on its thread before the outermost
+	// scope closes; after that its chunk is reused or gone, and the heap
+	// never handed it out
+	assert(!in_chunks(state, block));
+	::operator delete(block);
+}
+
+bool EvalArena::owns(const void * block) noexcept {
+	// nothing is handed out from the arena between evaluations
+	return state.depth > 0 && in_chunks(state, block);
+}
+
+bool EvalArena::active() noexcept {
+	return state.depth > 0;
+}
+
+std::size_t EvalArena::heapAllocations() noexcept {
+	return state.heap_allocations;
+}
+
+std::size_t EvalArena::arenaAllocations() noexcept {
+	return state.arena_allocations;
+}
+
+EvalArenaScope::EvalArenaScope() noexcept {
+	++state.depth;
+}
+
+EvalArenaScope::~EvalArenaScope() {
+	if (--state.depth == 0) {
+		state.release();
+	}
+}
+
+HeapScope::HeapScope() noexcept : m_was_suspended(state.suspended) {
+	state.suspended = true;
+}
+
+HeapScope::~HeapScope() {
+	state.suspended = m_was_suspended;
+}
@@ -0,0 +1,118 @@
+/*! \file eval_arena.hpp
+Defines the region allocator that the scratch environments built during a
+top-level evaluation are taken from.
+ */
+#ifndef EVAL_ARENA_HPP
+#define EVAL_ARENA_HPP
+
+#include <cstddef>
+#include <new>
+
+/*! \class EvalArena
+\brief A per-thread region that hands out memory by bumping a pointer.
+
+While an EvalArenaScope is open on a thread, the environment nodes built
+on that thread, e.g. for the copy every lambda call runs in, are carved
+from large chunks, and freed blocks are only kept for reuse. When the
+outermost scope closes, the chunks are released in bulk. Nodes that have to
+outlive the evaluation, such as those of the interpreter's own environment,
+are allocated under a HeapScope.
+
+Outside a scope, and for blocks too large to be worth pooling, allocation
+falls through to operator new, so containers used by other code are
+unaffected.
+ */
+class EvalArena {
+public:
+
+	/// get bytes from the calling thread's arena, or from the heap if none is open
+	static void * allocate(std::size_t bytes);
+
+	/// return bytes got from allocate, a no-op for blocks in the arena
+	static void deallocate(void * block, std::size_t bytes) noexcept;
+
+	/// whether block was carved from the calling thread's arena
+	static bool owns(const void * block) noexcept;
+
+	/// whether an arena is open on the calling thread
+	static bool active() noexcept;
+
+	/// the number of blocks allocate has taken from the heap on the calling thread
+	static std::size_t heapAllocations() noexcept;
+
+	/// the number of blocks allocate has carved from the arena on the calling thread
+	static std::size_t arenaAllocations() noexcept;
+};
+
+/*! \class EvalArenaScope
+\brief Opens the calling thread's arena for its lifetime.
+
+Scopes nest; only the outermost one releases the arena when it closes, so
+every arena block must be dead or promoted by then.
+ */
+class EvalArenaScope {
+public:
+	EvalArenaScope() noexcept;
+	~EvalArenaScope();
+
+	EvalArenaScope(const EvalArenaScope &) = delete;
+	EvalArenaScope & operator=(const EvalArenaScope &) = delete;
+};
+
+/*! \class HeapScope
+\brief Sends allocations on the calling thread to the heap for its lifetime,
+even inside an EvalArenaScope, e.g. while promoting a result.
+ */
+class HeapScope {
+public:
+	HeapScope() noexcept;
+	~HeapScope();
+
+	HeapScope(const HeapScope &) = delete;
+	HeapScope & operator=(const HeapScope &) = delete;
+
+private:
+	bool m_was_suspended;
+};
+
+/*! \class EvalAllocator
+\brief Standard allocator taking memory from EvalArena.
+
+Stateless, so containers using it can be moved and swapped freely; which
+memory a block came from is decided by the address alone.
+ */
+template<typename T>
+class EvalAllocator {
+public:
+	typedef T value_type;
+
+	EvalAllocator() noexcept {}
+
+	template<typename U>
+	EvalAllocator(const EvalAllocator<U> &) noexcept {}
+
+	T * allocate(std::size_t n) {
+		return static_cast<T *>(EvalArena::allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T * p, std::size_t n) noexcept {
+		EvalArena::deallocate(p, n * sizeof(T));
+	}
+
+	template<typename U>
+	struct rebind {
+		typedef EvalAllocator<U> other;
+	};
+};
+
+template<typename T, typename U>
+bool operator==(const EvalAllocator<T> &, const EvalAllocator<U> &) noexcept {
+	return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const EvalAllocator<T> &, const EvalAllocator<U> &) noexcept {
+	return false;
+}
+
+#endif
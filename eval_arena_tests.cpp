@@ -0,0 +1,117 @@
+#include "catch.hpp"
+
+#include <memory>
+
+#include "eval_arena.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+
+TEST_CASE("Test the arena is only used inside a scope", "[eval_arena]") {
+	REQUIRE(!EvalArena::active());
+
+	void * heap = EvalArena::allocate(32);
+	REQUIRE(!EvalArena::owns(heap));
+
+	{
+		EvalArenaScope scope;
+		REQUIRE(EvalArena::active());
+
+		void * a = EvalArena::allocate(32);
+		void * b = EvalArena::allocate(32);
+		REQUIRE(EvalArena::owns(a));
+		REQUIRE(EvalArena::owns(b));
+		REQUIRE(a != b);
+
+		// large blocks and blocks asked for under a HeapScope come from the heap
+		void * large = EvalArena::allocate(1 << 20);
+		REQUIRE(!EvalArena::owns(large));
+		EvalArena::deallocate(large, 1 << 20);
+		{
+			HeapScope on_heap;
+			void * c = EvalArena::allocate(32);
+			REQUIRE(!EvalArena::owns(c));
+			EvalArena::deallocate(c, 32);
+		}
+
+		// nested scopes share the arena
+		{
+			EvalArenaScope nested;
+			REQUIRE(EvalArena::owns(EvalArena::allocate(16)));
+		}
+		REQUIRE(EvalArena::active());
+
+		EvalArena::deallocate(a, 32);
+		EvalArena::deallocate(b, 32);
+	}
+
+	REQUIRE(!EvalArena::active());
+	EvalArena::deallocate(heap, 32);
+}
+
+TEST_CASE("Test definitions outlive the arena", "[eval_arena]") {
+	Environment env;
+	{
+		EvalArenaScope scope;
+
+		// a lambda call binds its arguments in an arena frame in front of env
+		std::size_t before = EvalArena::arenaAllocations();
+		Expression square{ Atom("lambda") };
+		square.append(Expression(Atom("x")));
+		square.append(Expression(Atom("*")));
+		square.tail()->append(Expression(Atom("x")));
+		square.tail()->append(Expression(Atom("x")));
+		env.add_exp(Atom("square"), square.eval(env));
+
+		Expression call{ Atom("square") };
+		call.append(Expression(6));
+		REQUIRE(call.eval(env) == Expression(36));
+		REQUIRE(EvalArena::arenaAllocations() > before);
+
+		// but the definition itself lives on the heap
+		env.add_exp(Atom("a"), Expression(2));
+	}
+
+	REQUIRE(!EvalArena::active());
+	REQUIRE(env.get_exp(Atom("a")) == Expression(2));
+
+	Expression call{ Atom("square") };
+	call.append(Expression(Atom("a")));
+	REQUIRE(call.eval(env) == Expression(4));
+
+	// copies made outside a scope come from the heap
+	Environment copy(env);
+	REQUIRE(copy.get_exp(Atom("a")) == Expression(2));
+}
+
+TEST_CASE("Test copies of a frame outlive the arena", "[eval_arena]") {
+	Environment env;
+	Environment assigned;
+	std::unique_ptr<Environment> copy;
+	{
+		EvalArenaScope scope;
+		Environment frame(env, 1);
+		frame.bind(Atom("x"), Expression(1));
+		REQUIRE(frame.get_exp(Atom("x")) == Expression(1));
+
+		// a copy may be kept after the evaluation, so its bindings are not
+		// taken from the arena
+		std::size_t before = EvalArena::heapAllocations();
+		copy.reset(new Environment(frame));
+		REQUIRE(EvalArena::heapAllocations() == before + 1);
+
+		Environment other(env, 1);
+		other.bind(Atom("y"), Expression(2));
+		assigned = other;
+		assigned = frame;
+		REQUIRE(EvalArena::heapAllocations() == before + 3);
+	}
+
+	REQUIRE(copy->get_exp(Atom("x")) == Expression(1));
+	REQUIRE(assigned.get_exp(Atom("x")) == Expression(1));
+	REQUIRE(!assigned.is_known(Atom("y")));
+
+	// and are freed on the heap
+	copy.reset();
+	assigned = env;
+	REQUIRE(!assigned.is_known(Atom("x")));
+}
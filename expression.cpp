@@ -5,53 +5,180 @@
 #include <cmath>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 
 #include "environment.hpp"
+#include "memo_cache.hpp"
+#include "packed_list.hpp"
+#include "profiler.hpp"
+#include "property_table.hpp"
 #include "semantic_error.hpp"
 
 #include <atomic>
 std::atomic<bool> interrupt;
 
+// Expressions copied on this thread, by the copy constructor, shallow or
+// as part of a cloned tail, see copies()
+static thread_local std::size_t copy_count = 0;
+
 Expression::Expression() {}
 
 Expression::Expression(const Atom & a) {
 	m_head = a;
 }
 
-Expression::Expression(const Expression & a, const Expression & b) {
-	m_head = Atom("lambda");
+Expression::Expression(Expression a, Expression b) {
+	m_head = Atom(SYM_LAMBDA);
 
 	// want to make constructor with tail that has a list as first expression and the procedure as the second expression
-	std::vector<Expression> tmp = { a, b };
-	m_tail = tmp;
+	Tail & tail = own_tail();
+	tail.reserve(2);
+	tail.push_back(std::move(a));
+	tail.push_back(std::move(b));
+}
+
+Expression::Expression(const Atom & a, const std::vector<Expression> & b) : m_head(a) {
+	if (!b.empty()) {
+		m_tail = std::make_shared<Tail>(b);
+	}
 }
 
-// recursive copy
-Expression::Expression(const Expression & a) {
-	m_head = a.m_head;
-	for (auto e : a.m_tail) {
-		m_tail.push_back(e);
+Expression::Expression(const Atom & a, std::vector<Expression> && b) : m_head(a) {
+	if (!b.empty()) {
+		m_tail = std::make_shared<Tail>(std::move(b));
+	}
+}
+
+// shallow copy, the tail and properties are shared until either side changes them
+Expression::Expression(const Expression & a) :
+	m_head(a.m_head), m_tail(a.m_tail), m_properties(a.m_properties), is_list(a.is_list), m_packed(a.m_packed), m_memo(a.m_memo), m_kind(a.m_kind), m_span(a.m_span) {
+	if (m_properties != nullptr) {
+		m_properties->retain();
+	}
+	++copy_count;
+}
+
+Expression Expression::fromPacked(std::shared_ptr<const PackedList> list) {
+	Expression result{ Atom(SYM_ISLIST) };
+	result.is_list = true;
+	// the tail points at the PackedList's boxed elements and shares its ownership
+	result.m_tail = std::shared_ptr<Tail>(list, const_cast<Tail *>(static_cast<const Tail *>(list.get())));
+	result.m_packed = true;
+	return result;
+}
+
+void Expression::release_properties(PropertyTable * properties) noexcept {
+	PropertyTable::release(properties);
+}
+
+void Expression::release_tail() noexcept {
+	if (m_packed || m_tail.use_count() != 1) {
+		return;
+	}
+
+	// the common case, a tail holding no tail of its own, is freed as usual
+	auto nested = [](const Expression & e) { return e.m_tail && !e.m_packed && e.m_tail.use_count() == 1; };
+	if (std::none_of(m_tail->begin(), m_tail->end(), nested)) {
+		return;
+	}
+
+	// otherwise the tails are taken out of their owners before being freed
+	std::vector<std::shared_ptr<Tail> > pending;
+	pending.push_back(std::move(m_tail));
+	while (!pending.empty()) {
+		std::shared_ptr<Tail> tail = std::move(pending.back());
+		pending.pop_back();
+		for (Expression & e : *tail) {
+			if (nested(e)) {
+				pending.push_back(std::move(e.m_tail));
+			}
+		}
 	}
-	m_properties.insert(a.m_properties.begin(), a.m_properties.end());
-	is_list = a.is_list;
 }
 
 Expression & Expression::operator=(const Expression & a) {
-	// prevent self-assignment
+	// copy first, a may be part of this expression
+	if (this != &a) {
+		*this = Expression(a);
+	}
+
+	return *this;
+}
+
+Expression & Expression::operator=(Expression && a) noexcept {
 	if (this != &a) {
+		// take everything out of a before releasing the old tail, which may own it
+		std::shared_ptr<Tail> tail(std::move(a.m_tail));
+		PropertyTable * properties = a.m_properties;
+		a.m_properties = nullptr;
 		m_head = a.m_head;
-		m_tail.clear();
-		for (auto e : a.m_tail) {
-			m_tail.push_back(e);
-		}
-		m_properties.insert(a.m_properties.begin(), a.m_properties.end());
 		is_list = a.is_list;
+		m_packed = a.m_packed;
+		a.m_packed = false;
+		m_memo = a.m_memo;
+		a.m_memo = false;
+		m_kind = a.m_kind;
+		m_span = a.m_span;
+		if (m_tail) {
+			release_tail();
+		}
+		m_tail = std::move(tail);
+		PropertyTable::release(m_properties);
+		m_properties = properties;
 	}
 
 	return *this;
 }
 
+std::size_t Expression::copies() noexcept {
+	return copy_count;
+}
+
+const Expression::Tail & Expression::nodes() const noexcept {
+	static const Tail none;
+	if (m_packed) {
+		return packed()->boxed();
+	}
+	return m_tail ? *m_tail : none;
+}
+
+Expression::Tail & Expression::own_tail() {
+	// the tail may be changed through the reference, so a folded value may no longer hold
+	if (m_kind == FOLDED_CALL) {
+		m_kind = UNRESOLVED;
+	}
+	if (!m_tail) {
+		m_tail = std::make_shared<Tail>();
+	}
+	else if (m_packed) {
+		m_tail = std::make_shared<Tail>(packed()->elements());
+		m_packed = false;
+	}
+	else if (m_tail.use_count() > 1 || m_memo) {
+		// only this expression can add owners while it holds the last one,
+		// so a count of one cannot change under us; a changed lambda is
+		// not the one its cache was filled by
+		m_tail = std::make_shared<Tail>(*m_tail);
+		m_memo = false;
+	}
+	return *m_tail;
+}
+
+PropertyTable & Expression::own_properties() {
+	if (m_properties == nullptr) {
+		m_properties = new PropertyTable();
+	}
+	else if (m_properties->shared()) {
+		PropertyTable * shared = m_properties;
+		m_properties = new PropertyTable(*shared);
+		PropertyTable::release(shared);
+	}
+	return *m_properties;
+}
+
 Atom & Expression::head() {
+	// the head may be changed through the reference
+	m_kind = UNRESOLVED;
 	return m_head;
 }
 
@@ -72,18 +199,27 @@ bool Expression::isHeadSymbol() const noexcept {
 }
 
 void Expression::append(const Atom & a) {
-	m_tail.emplace_back(a);
+	m_kind = UNRESOLVED;
+	own_tail().emplace_back(a);
 }
 
 void Expression::append(const Expression & exp) {
-	m_tail.emplace_back(exp);
+	// copy before unsharing, exp may be in the tail
+	Expression copy(exp);
+	m_kind = UNRESOLVED;
+	own_tail().push_back(std::move(copy));
+}
+
+void Expression::append(Expression && exp) {
+	m_kind = UNRESOLVED;
+	own_tail().push_back(std::move(exp));
 }
 
 Expression * Expression::tail() {
 	Expression * ptr = nullptr;
 
-	if (m_tail.size() > 0) {
-		ptr = &m_tail.back();
+	if (!isTailEmpty()) {
+		ptr = &own_tail().back();
 	}
 
 	return ptr;
@@ -91,24 +227,103 @@ Expression * Expression::tail() {
 
 bool Expression::isTailEmpty() const noexcept
 {
-	return (m_tail.size() == 0);
+	// packed lists are never empty
+	return !m_packed && nodes().empty();
 }
 
 void Expression::setTail(std::vector<Expression> to_add)
 {
-	m_tail = to_add;
+	if (to_add.empty()) {
+		m_tail.reset();
+	}
+	else if (m_tail && m_tail.use_count() == 1 && !m_packed && !m_memo) {
+		*m_tail = std::move(to_add);
+	}
+	else {
+		m_tail = std::make_shared<Tail>(std::move(to_add));
+	}
+	m_packed = false;
+	m_memo = false;
+	m_kind = UNRESOLVED;
+}
+
+Expression::TailView Expression::tailView() const noexcept {
+	const Tail & tail = nodes();
+	return TailView(tail.data(), tail.size());
+}
+
+const Expression & Expression::TailView::at(std::size_t index) const {
+	if (index >= m_size) {
+		throw std::out_of_range("Expression::TailView::at");
+	}
+	return m_first[index];
 }
 
-std::vector<Expression> Expression::getTail() const noexcept {
-	return m_tail;
+const PackedList * Expression::packed() const noexcept {
+	return m_packed ? static_cast<const PackedList *>(static_cast<const Tail *>(m_tail.get())) : nullptr;
+}
+
+struct Expression::FoldedTail : Tail {
+	Expression value;
+};
+
+struct Expression::MemoTail : Tail {
+	explicit MemoTail(std::size_t capacity) : cache(capacity) {}
+	MemoCache cache;
+};
+
+Expression Expression::memoized(const Expression & lambda, std::size_t capacity) {
+	Expression result(lambda.m_head);
+	std::shared_ptr<MemoTail> tail = std::make_shared<MemoTail>(capacity);
+	static_cast<Tail &>(*tail) = lambda.nodes();
+	result.m_tail = std::move(tail);
+	result.m_memo = true;
+	result.m_properties = lambda.m_properties;
+	if (result.m_properties != nullptr) {
+		result.m_properties->retain();
+	}
+	return result;
+}
+
+MemoCache * Expression::memo() const noexcept {
+	return m_memo ? &static_cast<MemoTail *>(m_tail.get())->cache : nullptr;
+}
+
+const Expression * Expression::folded() const noexcept {
+	return m_kind == FOLDED_CALL ? &static_cast<const FoldedTail *>(m_tail.get())->value : nullptr;
+}
+
+std::vector<Expression> Expression::getTail() const & {
+	if (m_packed) {
+		return packed()->elements();
+	}
+	return nodes();
+}
+
+std::vector<Expression> Expression::getTail() && {
+	if (m_packed) {
+		return packed()->elements();
+	}
+	if (m_tail && m_tail.use_count() == 1) {
+		return std::move(*m_tail);
+	}
+	return nodes();
 }
 
 Expression::ConstIteratorType Expression::tailConstBegin() const noexcept {
-	return m_tail.cbegin();
+	return nodes().cbegin();
 }
 
 Expression::ConstIteratorType Expression::tailConstEnd() const noexcept {
-	return m_tail.cend();
+	return nodes().cend();
+}
+
+const SourceSpan & Expression::span() const noexcept {
+	return m_span;
+}
+
+void Expression::setSpan(const SourceSpan & span) noexcept {
+	m_span = span;
 }
 
 Expression apply(const Atom & op, const std::vector<Expression> & args, const Environment & env) {
@@ -130,7 +345,7 @@ Expression apply(const Atom & op, const std::vector<Expression> & args, const En
 	return proc(args);
 }
 
-Expression Expression::handle_lookup(const Atom & head, const Environment & env) {
+Expression Expression::handle_lookup(const Atom & head, const Environment & env) const {
 	if (head.isString()) {
 		return Expression(head);
 	}
@@ -150,36 +365,76 @@ Expression Expression::handle_lookup(const Atom & head, const Environment & env)
 	}
 }
 
-Expression Expression::handle_begin(Environment & env) {
+Expression Expression::handle_symbol(const Environment & env) const {
+	Procedure proc = nullptr;
+	const Expression * value = env.find(m_head.asSymbolId(), proc);
+	if (value == nullptr) {
+		throw SemanticError("Error during evaluation: unknown symbol");
+	}
+	return *value;
+}
+
+Expression Expression::handle_call(Environment & env) const {
+	// one lookup tells a lambda call from a call that fails in apply
+	Procedure proc = nullptr;
+	if (is_lambda(env.find(m_head.asSymbolId(), proc))) {
+		return handle_recall_lambda(env);
+	}
+	return handle_procedure(env);
+}
+
+Expression Expression::handle_builtin(Environment & env) const {
+	std::vector<Expression> results;
+	results.reserve(nodes().size());
+	for (ConstIteratorType it = nodes().begin(); it != nodes().end(); ++it) {
+		results.push_back(it->eval(env));
+	}
+	// the arguments may have rebound the name
+	if (env.shadows_builtins()) {
+		return apply(m_head, results, env);
+	}
+	return Environment::builtin(m_head.asSymbolId())(results);
+}
 
-	if (m_tail.size() == 0) {
+Expression Expression::handle_procedure(Environment & env) const {
+	std::vector<Expression> results;
+	results.reserve(nodes().size());
+	for (ConstIteratorType it = nodes().begin(); it != nodes().end(); ++it) {
+		results.push_back(it->eval(env));
+	}
+	return apply(m_head, results, env);
+}
+
+Expression Expression::handle_begin(Environment & env) const {
+
+	if (nodes().size() == 0) {
 		throw SemanticError("Error during evaluation: zero arguments to begin");
 	}
 
 	// evaluate each arg from tail, return the last
 	Expression result;
-	for (Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it) {
+	for (ConstIteratorType it = nodes().begin(); it != nodes().end(); ++it) {
 		result = it->eval(env);
 	}
 
 	return result;
 }
 
-Expression Expression::handle_define(Environment & env) {
+Expression Expression::handle_define(Environment & env) const {
 
 	// tail must have size 3 or error
-	if (m_tail.size() != 2) {
+	if (nodes().size() != 2) {
 		throw SemanticError("Error during evaluation: invalid number of arguments to define");
 	}
 
 	// tail[0] must be symbol
-	if (!m_tail[0].isHeadSymbol()) {
+	if (!nodes()[0].isHeadSymbol()) {
 		throw SemanticError("Error during evaluation: first argument to define not symbol");
 	}
 
 	// but tail[0] must not be a special-form or procedure
-	std::string s = m_tail[0].head().asSymbol();
-	if ((s == "define") || (s == "begin") || (s == "lambda")) {
+	SymbolId s = nodes()[0].head().asSymbolId();
+	if ((s == SYM_DEFINE) || (s == SYM_BEGIN) || (s == SYM_LAMBDA)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a special-form");
 	}
 
@@ -188,34 +443,33 @@ Expression Expression::handle_define(Environment & env) {
 	}
 
 	// eval tail[1]
-	Expression result = m_tail[1].eval(env);
+	Expression result = nodes()[1].eval(env);
 
 	if (env.is_exp(m_head)) {
 		throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
 	}
 
 	// and add to env
-	env.add_exp(m_tail[0].head(), result);
+	env.add_exp(nodes()[0].head(), result);
 
 	return result;
 }
 
-Expression Expression::handle_lambda() {
-	if (m_tail.size() != 2) {
+Expression Expression::handle_lambda() const {
+	if (nodes().size() != 2) {
 		throw SemanticError("Error during evaluation: invalid number of arguments to lambda");
 	}
 
 	// initialize lambda with arguments
-	std::vector<Expression> args = exp_to_atom(m_tail[0]);
+	std::vector<Expression> args = exp_to_atom(nodes()[0]);
 	Expression tmp;
-	tmp.setTail(args);
+	tmp.setTail(std::move(args));
 	tmp.setList();
-	Expression result(tmp, m_tail[1]);
-	return result;
+	return Expression(std::move(tmp), nodes()[1]);
 }
 
 // helper function that converts an expression into a vector of atoms
-std::vector<Expression> Expression::exp_to_atom(Expression e) {
+std::vector<Expression> Expression::exp_to_atom(const Expression & e) const {
 	std::vector<Expression> result;
 	result.push_back(e.head());
 	for (ConstIteratorType it = e.tailConstBegin(); it != e.tailConstEnd(); ++it) {
@@ -224,90 +478,83 @@ std::vector<Expression> Expression::exp_to_atom(Expression e) {
 	return result;
 }
 
-Expression Expression::handle_recall_lambda(Environment &env) {
+Expression Expression::handle_recall_lambda(Environment &env) const {
 	std::vector<Expression> results;
-	for (Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it) {
+	for (ConstIteratorType it = nodes().begin(); it != nodes().end(); ++it) {
 		results.push_back(it->eval(env));
 	}
-	// create lambda environment
-	Environment lambda_env(env);
-	Expression result = env.get_exp(m_head);
+	const Expression & result = env.get_exp(m_head);
+
+	// a memoized lambda may have the result already, then no environment is set up
+	MemoCache * memo = result.memo();
+	std::string key;
+	if (memo != nullptr && MemoCache::key(TailView(results.data(), results.size()), key)) {
+		Expression cached;
+		if (memo->find(key, cached)) {
+			return cached;
+		}
+	}
+	else {
+		memo = nullptr;
+	}
 
-	// getting args and procedure
-	Expression lambda_a = *(result.tailConstBegin());
-	Expression lambda_e = *(result.tailConstBegin() + 1);
+	// create lambda environment, a frame in front of env, only it is changed while the lambda runs
+	Environment lambda_env(env, results.size());
 
-	// converting to vector for convenience
-	std::vector<Expression> l_args = lambda_a.getTail();
+	// getting args and procedure
+	const Expression & lambda_a = *(result.tailConstBegin());
+	const Expression & lambda_e = *(result.tailConstBegin() + 1);
 
 	// checking that number of args is the same
-	if (l_args.size() != results.size()) {
+	std::size_t arg_count = lambda_a.tailConstEnd() - lambda_a.tailConstBegin();
+	if (arg_count != results.size()) {
 		throw SemanticError("Error: incorrect number of arguments to lambda");
 	}
 
 	// defining arguments in lambda env
-	for (unsigned int i = 0; i < l_args.size(); ++i) {
-		lambda_env.add_exp(l_args.at(i).head(), results.at(i));
+	for (std::size_t i = 0; i < arg_count; ++i) {
+		lambda_env.bind((lambda_a.tailConstBegin() + i)->head(), std::move(results[i]));
 	}
 
 	// evaluating lambda
-	Expression lambda_res = lambda_e.eval(lambda_env);
-
-	return lambda_res;
+	Expression value = lambda_e.eval(lambda_env);
+	if (memo != nullptr) {
+		memo->insert(std::move(key), value);
+	}
+	return value;
 }
 
-bool is_lambda(Environment & env, const std::string & exp) {
-	return (env.is_exp(exp) && env.get_exp(exp).isHeadSymbol() && env.get_exp(exp).head().asSymbol() == "lambda");
+bool is_lambda(Environment & env, const Atom & exp) {
+	return (env.is_exp(exp) && env.get_exp(exp).head().asSymbolId() == SYM_LAMBDA);
 }
 
-Expression Expression::handle_apply_map(Environment & env) {
+Expression Expression::handle_apply_map(Environment & env) const {
 	// error checking
-	std::string name = m_head.asSymbol();
-	if (m_tail.size() == 2) {
-		if (m_tail[0].isHeadSymbol() && (is_lambda(env, m_tail[0].head().asSymbol()) || env.is_proc(m_tail[0].head().asSymbol())) && m_tail[0].isTailEmpty()) {
-			std::string op = m_tail[0].head().asSymbol();
-			Expression evaluated = m_tail[1].eval(env);
+	SymbolId name = m_head.asSymbolId();
+	if (nodes().size() == 2) {
+		if (nodes()[0].isHeadSymbol() && (is_lambda(env, nodes()[0].head()) || env.is_proc(nodes()[0].head())) && nodes()[0].isTailEmpty()) {
+			Atom op = nodes()[0].head();
+			Expression evaluated = nodes()[1].eval(env);
 			if (evaluated.isList()) {
-				// evaluate list and get list value
-				std::vector<Expression> arglist = m_tail[1].eval(env).getTail();
-
-				// prepare args by iterating through list
-				if (name == "apply") {
-					// initializing expression with op as head and results as tail
-					Expression a(Atom(op), arglist);
-					return a.eval(env);
-				}
-				else {
-					std::vector<Expression> results;
-					std::vector<Expression> arg;
-					Expression to_ret(Atom("islist"));
-					for (unsigned int i = 0; i < arglist.size(); ++i) {
-						arg.push_back(arglist[i]);
-						Expression tmp(op, arg);
-						arg.pop_back();
-						results.push_back(tmp.eval(env));
-					}
-					to_ret.setTail(results);
-					to_ret.setList();
-					return to_ret;
-				}
+				// take over the list value, it was only evaluated for this
+				return apply_or_map(op, name == SYM_MAP, std::move(evaluated).getTail(), env);
 			}
 			else {
-				if (name == "apply")
+				if (name == SYM_APPLY)
 					throw SemanticError("Error: second argument to apply not a list.");
 				else
 					throw SemanticError("Error: second argument to map not a list.");
 			}
 		}
 		else {
-			if (name == "apply")
+			if (name == SYM_APPLY)
 				throw SemanticError("Error: first argument to apply not a procedure.");
 			else
 				throw SemanticError("Error: first argument to map not a procedure.");
 		}
 	}
 	else {
-		if (name == "apply")
+		if (name == SYM_APPLY)
 			throw SemanticError("Error: apply takes two arguments");
 		else
 			throw SemanticError("Error: map takes two arguments");
@@ -315,19 +562,62 @@ Expression Expression::handle_apply_map(Environment & env) {
 	return Expression();
 }
 
-Expression Expression::handle_set_property(Environment & env) {
+bool is_lambda(const Expression * value) noexcept {
+	return value != nullptr && value->head().asSymbolId() == SYM_LAMBDA;
+}
+
+bool is_special_form(SymbolId op) noexcept {
+	switch (op) {
+	case SYM_BEGIN:
+	case SYM_DEFINE:
+	case SYM_APPLY:
+	case SYM_MAP:
+	case SYM_LAMBDA:
+	case SYM_SET_PROPERTY:
+	case SYM_GET_PROPERTY:
+	case SYM_CONTINUOUS_PLOT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool is_self_evaluating(const Expression & exp) noexcept {
+	const Atom & head = exp.head();
+	return exp.isTailEmpty() && (head.isString() || head.isNumber() || head.isComplex());
+}
+
+Expression apply_or_map(const Atom & op, bool map, std::vector<Expression> && elements, Environment & env) {
+	if (!map) {
+		// initializing expression with op as head and the elements as tail
+		Expression call(op, std::move(elements));
+		return call.eval(env);
+	}
+
+	std::vector<Expression> results;
+	results.reserve(elements.size());
+	for (auto & element : elements) {
+		std::vector<Expression> arg;
+		arg.push_back(std::move(element));
+		Expression call(op, std::move(arg));
+		results.push_back(call.eval(env));
+	}
+	return make_list(std::move(results));
+}
+
+Expression Expression::handle_set_property(Environment & env) const {
 	Expression result;
-	if (m_tail.size() == 3) {
-		if (m_tail[0].head().isString()) {
+	if (nodes().size() == 3) {
+		if (nodes()[0].head().isString()) {
 			std::vector<Expression> results;
-			for (Expression::IteratorType it = m_tail.begin() + 1; it != m_tail.end(); ++it) {
+			for (ConstIteratorType it = nodes().begin() + 1; it != nodes().end(); ++it) {
 					results.push_back(it->eval(env));
 			}
-			results[1].add_pair(m_tail[0], results[0]);
-			result = results[1];
+			results[1].add_pair(nodes()[0], results[0]);
 			if (env.is_exp(results[1].head().asSymbol())) {
 				env.add_exp(results[1].head().asSymbol(), results[1]);
 			}
+			result = std::move(results[1]);
 		}
 		else {
 			throw SemanticError("Error in call to set-property: first argument must be a string.");
@@ -339,16 +629,16 @@ Expression Expression::handle_set_property(Environment & env) {
 	return result;
 }
 
-Expression Expression::handle_get_property(Environment & env) {
-	if (m_tail.size() == 2) {
-		if (m_tail[0].head().isString()) {
-			Expression result = m_tail[1].eval(env);
-			if (m_tail[1].isHeadSymbol() && m_tail[1].isTailEmpty() && env.is_exp(m_tail[1].head().asSymbol())) {
-				Expression tmp = env.get_exp(m_tail[1].head().asSymbol());
-				return tmp.get_value(m_tail[0]);
+Expression Expression::handle_get_property(Environment & env) const {
+	if (nodes().size() == 2) {
+		if (nodes()[0].head().isString()) {
+			Expression result = nodes()[1].eval(env);
+			if (nodes()[1].isHeadSymbol() && nodes()[1].isTailEmpty() && env.is_exp(nodes()[1].head().asSymbol())) {
+				Expression tmp = env.get_exp(nodes()[1].head().asSymbol());
+				return tmp.get_value(nodes()[0]);
 			}
 			else {
-				return result.get_value(m_tail[0]);
+				return result.get_value(nodes()[0]);
 			}
 		}
 		else {
@@ -362,32 +652,38 @@ Expression Expression::handle_get_property(Environment & env) {
 }
 
 Expression make_point1(double x, double y) {
-	Expression point(Atom("islist"));
+	Expression point{ Atom(SYM_ISLIST) };
 	point.setList();
-	std::vector<Expression> coords = { Atom(x), Atom(y) };
-	point.setTail(coords);
-	point.add_pair(Expression(Atom("object-name")), Expression(Atom("point")));
-	point.add_pair(Expression(Atom("size")), Expression(0));
+	std::vector<Expression> coords;
+	coords.reserve(2);
+	coords.emplace_back(Atom(x));
+	coords.emplace_back(Atom(y));
+	point.setTail(std::move(coords));
+	point.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_POINT)));
+	point.add_pair(Expression(Atom(SYM_SIZE)), Expression(0));
 	return point;
 }
 
 Expression make_line2(Expression x, Expression y) {
-	Expression line(Atom("islist"));
+	Expression line{ Atom(SYM_ISLIST) };
 	line.setList();
-	std::vector<Expression> coords = { x, y };
-	line.setTail(coords);
-	line.add_pair(Expression(Atom("object-name")), Expression(Atom("line")));
-	line.add_pair(Expression(Atom("thickness")), Expression(0));
+	std::vector<Expression> coords;
+	coords.reserve(2);
+	coords.push_back(std::move(x));
+	coords.push_back(std::move(y));
+	line.setTail(std::move(coords));
+	line.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_LINE)));
+	line.add_pair(Expression(Atom(SYM_THICKNESS)), Expression(0));
 	return line;
 }
 
 bool line_split(Expression point1, Expression point2, Expression point3) {
-	double ax = -(point2.getTail()[0].head().asNumber() - point1.getTail()[0].head().asNumber());
-	double ay = -(point2.getTail()[1].head().asNumber() - point1.getTail()[1].head().asNumber());
+	double ax = -(point2.tailView()[0].head().asNumber() - point1.tailView()[0].head().asNumber());
+	double ay = -(point2.tailView()[1].head().asNumber() - point1.tailView()[1].head().asNumber());
 
 	// reversing direction of other one
-	double bx = point3.getTail()[0].head().asNumber() - point2.getTail()[0].head().asNumber();
-	double by = point3.getTail()[1].head().asNumber() - point2.getTail()[1].head().asNumber();
+	double bx = point3.tailView()[0].head().asNumber() - point2.tailView()[0].head().asNumber();
+	double by = point3.tailView()[1].head().asNumber() - point2.tailView()[1].head().asNumber();
 
 	double angle = std::acos((ax * bx + ay * by) / (sqrt((ax * ax) + (ay * ay))) / (sqrt((bx * bx) + (by * by))));
 	if (angle < 3.05433) {
@@ -446,35 +742,51 @@ std::string round_pop1(double x) {
 	return ret = precised.str();
 }
 
-Expression Expression::handle_continuous(Environment & env) {
-	std::vector<Expression> ret;
-	bool TRUE = true;
-	if (m_tail.size() == 3 || m_tail.size() == 2) {
+Expression Expression::handle_continuous(Environment & env) const {
+	if (nodes().size() == 3 || nodes().size() == 2) {
 		std::vector<Expression> results;
-		for (Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it) {
+		for (ConstIteratorType it = nodes().begin(); it != nodes().end(); ++it) {
 			results.push_back(it->eval(env));
 		}
-		if (results[0].head().asSymbol() == "lambda" && results[0].getTail()[0].getTail().size() == 1 && results[1].isList() && results[1].getTail().size() == 2 && results[1].getTail()[0].isHeadNumber() && results[1].getTail()[1].isHeadNumber()) {
+		return continuous_plot(results, env);
+	}
+	else {
+		throw SemanticError("Error in call to continuous-plot: incorrect number of arguments.");
+	}
+}
+
+Expression continuous_plot(const std::vector<Expression> & results, Environment & env) {
+	return continuous_plot(results, env, [](const Expression & call, Environment & env) {
+		return call.handle_recall_lambda(env);
+	});
+}
+
+Expression continuous_plot(const std::vector<Expression> & results, Environment & env,
+	const std::function<Expression(const Expression &, Environment &)> & sample) {
+	std::vector<Expression> ret;
+	bool TRUE = true;
+	if (results.size() == 3 || results.size() == 2) {
+		if (results[0].head().asSymbolId() == SYM_LAMBDA && results[0].tailView()[0].tailView().size() == 1 && results[1].isList() && results[1].tailView().size() == 2 && results[1].tailView()[0].isHeadNumber() && results[1].tailView()[1].isHeadNumber()) {
 			// getting text-scale
 			double text_scale = 1;
-			if (m_tail.size() == 3) {
-				for (unsigned int i = 0; i < results[2].getTail().size(); ++i) {
-					std::string hha = results[2].getTail()[i].getTail()[0].head().asSymbol();
-					if (hha == "text-scale" && results[2].getTail()[i].getTail()[1].isHeadNumber()) {
-						text_scale = results[2].getTail()[i].getTail()[1].head().asNumber();
+			if (results.size() == 3) {
+				for (unsigned int i = 0; i < results[2].tailView().size(); ++i) {
+					std::string hha = results[2].tailView()[i].tailView()[0].head().asSymbol();
+					if (hha == "text-scale" && results[2].tailView()[i].tailView()[1].isHeadNumber()) {
+						text_scale = results[2].tailView()[i].tailView()[1].head().asNumber();
 					}
 				}
 			}
 
 			// getting maxes and mins
-			double maxX = results[1].getTail()[1].head().asNumber(), maxY = -100000, minX = results[1].getTail()[0].head().asNumber(), minY = 10000;
+			double maxX = results[1].tailView()[1].head().asNumber(), maxY = -100000, minX = results[1].tailView()[0].head().asNumber(), minY = 10000;
 			double s_maxX, s_maxY, s_minX, s_minY;
 
 			std::vector<Expression> x, points, lines;
 			// sampling in bounds
-			double low_val = results[1].getTail()[0].head().asNumber();
-			double high_val = results[1].getTail()[1].head().asNumber();
-			env.add_exp(Atom("continuous_lambda"), results[0]);
+			double low_val = results[1].tailView()[0].head().asNumber();
+			double high_val = results[1].tailView()[1].head().asNumber();
+			env.add_exp(Atom(SYM_CONTINUOUS_LAMBDA), results[0]);
 
 			std::stringstream hm;
 			hm << ((high_val - low_val) / 50.0);
@@ -484,9 +796,9 @@ Expression Expression::handle_continuous(Environment & env) {
 
 			if (low_val < high_val) {
 				for (double i = low_val; i <= high_val; i += thing) {
-					Expression temp(Atom("continuous_lambda"));
+					Expression temp{ Atom(SYM_CONTINUOUS_LAMBDA) };
 					temp.append(i);
-					double result = temp.handle_recall_lambda(env).head().asNumber();
+					double result = sample(temp, env).head().asNumber();
 					if (result > maxY) {
 						maxY = result;
 					}
@@ -494,9 +806,9 @@ Expression Expression::handle_continuous(Environment & env) {
 						minY = result;
 					}
 				}
-				Expression temp(Atom("continuous_lambda"));
+				Expression temp{ Atom(SYM_CONTINUOUS_LAMBDA) };
 				temp.append(high_val);
-				double result = temp.handle_recall_lambda(env).head().asNumber();
+				double result = sample(temp, env).head().asNumber();
 				if (result > maxY) {
 					maxY = result;
 				}
@@ -516,45 +828,45 @@ Expression Expression::handle_continuous(Environment & env) {
 			if (low_val < high_val) {
 				for (double i = low_val; i < high_val; i += thing) {
 					// evaluate lambda
-					Expression temp(Atom("continuous_lambda"));
+					Expression temp{ Atom(SYM_CONTINUOUS_LAMBDA) };
 					temp.append(i);
 
 					// make the point
-					points.push_back(make_point1(i, temp.handle_recall_lambda(env).head().asNumber()));
+					points.push_back(make_point1(i, sample(temp, env).head().asNumber()));
 				}
-				Expression temp(Atom("continuous_lambda"));
+				Expression temp{ Atom(SYM_CONTINUOUS_LAMBDA) };
 				temp.append(high_val);
-				points.push_back(make_point1(high_val, temp.handle_recall_lambda(env).head().asNumber()));
+				points.push_back(make_point1(high_val, sample(temp, env).head().asNumber()));
 			}
 
 			// OU top left
 
 			Atom hmm = Atom(round_pop1(maxY), TRUE);
 			Expression OU(hmm);
-			OU.add_pair(Expression(Atom("position")), make_point1(s_minX - 2, s_maxY));
-			OU.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-			OU.add_pair(Expression(Atom("text-scale")), Expression(Atom(text_scale)));
+			OU.add_pair(Expression(Atom(SYM_POSITION)), make_point1(s_minX - 2, s_maxY));
+			OU.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+			OU.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(text_scale)));
 
 			// OL bottom left left
 			hmm = Atom(round_pop1(minY), TRUE);
 			Expression OL(hmm);
-			OL.add_pair(Expression(Atom("position")), make_point1(s_minX - 2, s_minY));
-			OL.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-			OL.add_pair(Expression(Atom("text-scale")), Expression(Atom(text_scale)));
+			OL.add_pair(Expression(Atom(SYM_POSITION)), make_point1(s_minX - 2, s_minY));
+			OL.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+			OL.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(text_scale)));
 
 			// AL bottom left bottom
 			hmm = Atom(round_pop1(minX), TRUE);
 			Expression AL(hmm);
-			AL.add_pair(Expression(Atom("position")), make_point1(s_minX, s_minY + 2));
-			AL.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-			AL.add_pair(Expression(Atom("text-scale")), Expression(Atom(text_scale)));
+			AL.add_pair(Expression(Atom(SYM_POSITION)), make_point1(s_minX, s_minY + 2));
+			AL.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+			AL.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(text_scale)));
 
 			// AU 
 			hmm = Atom(round_pop1(maxX), TRUE);
 			Expression AU(hmm);
-			AU.add_pair(Expression(Atom("position")), make_point1(s_maxX, s_minY + 2));
-			AU.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-			AU.add_pair(Expression(Atom("text-scale")), Expression(Atom(text_scale)));
+			AU.add_pair(Expression(Atom(SYM_POSITION)), make_point1(s_maxX, s_minY + 2));
+			AU.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+			AU.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(text_scale)));
 
 			ret.push_back(OL);
 			ret.push_back(OU);
@@ -568,28 +880,28 @@ Expression Expression::handle_continuous(Environment & env) {
 
 			// iterating through options	
 			Expression temp;
-			if (m_tail.size() != 2) {
-				for (unsigned int i = 0; i < results[2].getTail().size(); ++i) {
-					if (results[2].getTail()[i].isList() && results[2].getTail()[i].getTail()[0].head().isString()) {
-						std::string hha = results[2].getTail()[i].getTail()[0].head().asSymbol();
-						if (hha == "title" && results[2].getTail()[i].getTail()[1].head().isString()) {
-							temp = Atom(results[2].getTail()[i].getTail()[1].head().asSymbol(), TRUE);
-							temp.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-							temp.add_pair(Expression(Atom("position")), make_point1(0, s_maxY - 3));
-							temp.add_pair(Expression(Atom("text-scale")), Expression(Atom(text_scale)));
+			if (results.size() != 2) {
+				for (unsigned int i = 0; i < results[2].tailView().size(); ++i) {
+					if (results[2].tailView()[i].isList() && results[2].tailView()[i].tailView()[0].head().isString()) {
+						std::string hha = results[2].tailView()[i].tailView()[0].head().asSymbol();
+						if (hha == "title" && results[2].tailView()[i].tailView()[1].head().isString()) {
+							temp = Atom(results[2].tailView()[i].tailView()[1].head().asSymbol(), TRUE);
+							temp.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+							temp.add_pair(Expression(Atom(SYM_POSITION)), make_point1(0, s_maxY - 3));
+							temp.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(text_scale)));
 						}
-						else if (hha == "abscissa-label" && results[2].getTail()[i].getTail()[1].head().isString()) {
-							temp = Atom(results[2].getTail()[i].getTail()[1].head().asSymbol(), TRUE);
-							temp.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-							temp.add_pair(Expression(Atom("position")), make_point1(0, s_minY + 3));
-							temp.add_pair(Expression(Atom("text-scale")), Expression(Atom(text_scale)));
+						else if (hha == "abscissa-label" && results[2].tailView()[i].tailView()[1].head().isString()) {
+							temp = Atom(results[2].tailView()[i].tailView()[1].head().asSymbol(), TRUE);
+							temp.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+							temp.add_pair(Expression(Atom(SYM_POSITION)), make_point1(0, s_minY + 3));
+							temp.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(text_scale)));
 						}
-						else if (hha == "ordinate-label" && results[2].getTail()[i].getTail()[1].head().isString()) {
-							temp = Atom(results[2].getTail()[i].getTail()[1].head().asSymbol(), TRUE);
-							temp.add_pair(Expression(Atom("object-name")), Expression(Atom("text")));
-							temp.add_pair(Expression(Atom("text-rotation")), Expression(Atom(1.5708)));
-							temp.add_pair(Expression(Atom("position")), make_point1(s_minX - 3, s_minY - 10));
-							temp.add_pair(Expression(Atom("text-scale")), Expression(Atom(text_scale)));
+						else if (hha == "ordinate-label" && results[2].tailView()[i].tailView()[1].head().isString()) {
+							temp = Atom(results[2].tailView()[i].tailView()[1].head().asSymbol(), TRUE);
+							temp.add_pair(Expression(Atom(SYM_OBJECT_NAME)), Expression(Atom(SYM_TEXT)));
+							temp.add_pair(Expression(Atom(SYM_TEXT_ROTATION)), Expression(Atom(1.5708)));
+							temp.add_pair(Expression(Atom(SYM_POSITION)), make_point1(s_minX - 3, s_minY - 10));
+							temp.add_pair(Expression(Atom(SYM_TEXT_SCALE)), Expression(Atom(text_scale)));
 						}
 						else {
 							break;
@@ -610,9 +922,9 @@ Expression Expression::handle_continuous(Environment & env) {
 				unsigned int insert_c = 0;
 				for (unsigned int j = 0; j < points.size() - 2; ++j) {
 					if (line_split(points[j], points[j + 1], points[j + 2])) {
-						Expression temp(Atom("continuous_lambda"));
-						temp.append((points[j + 1].getTail()[0].head().asNumber() + points[j].getTail()[0].head().asNumber()) / 2);
-						Expression point1 = make_point1((points[j + 1].getTail()[0].head().asNumber() + points[j].getTail()[0].head().asNumber()) / 2, temp.handle_recall_lambda(env).head().asNumber());
+						Expression temp{ Atom(SYM_CONTINUOUS_LAMBDA) };
+						temp.append((points[j + 1].tailView()[0].head().asNumber() + points[j].tailView()[0].head().asNumber()) / 2);
+						Expression point1 = make_point1((points[j + 1].tailView()[0].head().asNumber() + points[j].tailView()[0].head().asNumber()) / 2, sample(temp, env).head().asNumber());
 
 						if (!inserted.at(j)) {
 							c_points.insert(c_points.begin() + j + 1 + insert_c, point1);
@@ -620,9 +932,9 @@ Expression Expression::handle_continuous(Environment & env) {
 							insert_c++;
 						}
 								
-						Expression temp1(Atom("continuous_lambda"));
-						temp1.append((points[j + 2].getTail()[0].head().asNumber() + points[j + 1].getTail()[0].head().asNumber()) / 2);
-						Expression point2 = make_point1((points[j + 2].getTail()[0].head().asNumber() + points[j + 1].getTail()[0].head().asNumber()) / 2, temp1.handle_recall_lambda(env).head().asNumber());
+						Expression temp1{ Atom(SYM_CONTINUOUS_LAMBDA) };
+						temp1.append((points[j + 2].tailView()[0].head().asNumber() + points[j + 1].tailView()[0].head().asNumber()) / 2);
+						Expression point2 = make_point1((points[j + 2].tailView()[0].head().asNumber() + points[j + 1].tailView()[0].head().asNumber()) / 2, sample(temp1, env).head().asNumber());
 
 						if (!inserted.at(j + 1)) {
 							c_points.insert(c_points.begin() + j + 2 + insert_c, point2);
@@ -639,7 +951,7 @@ Expression Expression::handle_continuous(Environment & env) {
 			}
 			// making lines
 			for (unsigned int i = 0; i < points.size(); ++i) {
-				Expression thing = (make_point1(points[i].getTail()[0].head().asNumber() * scaled_x, points[i].getTail()[1].head().asNumber() * -scaled_y));
+				Expression thing = (make_point1(points[i].tailView()[0].head().asNumber() * scaled_x, points[i].tailView()[1].head().asNumber() * -scaled_y));
 				points[i] = thing;				
 			}
 
@@ -655,62 +967,275 @@ Expression Expression::handle_continuous(Environment & env) {
 	else {
 		throw SemanticError("Error in call to continuous-plot: incorrect number of arguments.");
 	}
-	Expression to_return(Atom("islist"));
+	Expression to_return{ Atom(SYM_ISLIST) };
 	to_return.setList();
-	to_return.setTail(ret);
+	to_return.setTail(std::move(ret));
 	return to_return;
 }
-// this is a simple recursive version. the iterative version is more
-// difficult with the ast data structure used (no parent pointer).
-// this limits the practical depth of our AST
-Expression Expression::eval(Environment & env) {
-	if (m_tail.empty()) {
-		if (m_head.isSymbol() && m_head.asSymbol() == "list" && !m_head.isString()) {
+// this is a simple recursive version, so the thread's stack limits the
+// practical depth of our AST; IterativeEvaluator keeps its own stack instead
+Expression Expression::eval(Environment & env) const {
+	// only forms are timed, atoms count towards the form using them
+	Profiler * profiler = Profiler::active();
+	if (profiler == nullptr || nodes().empty() || m_span.begin.line == 0) {
+		return eval_node(env);
+	}
+
+	ProfileScope scope(*profiler, m_span.begin.line);
+	return eval_node(env);
+}
+
+void Expression::resolve() {
+	// an explicit stack rather than recursion, programs may be nested deeply
+	std::vector<Expression *> pending(1, this);
+	while (!pending.empty()) {
+		Expression * exp = pending.back();
+		pending.pop_back();
+		exp->resolve_kind();
+		if (exp->m_tail && !exp->m_packed) {
+			for (Expression & node : exp->own_tail()) {
+				pending.push_back(&node);
+			}
+		}
+	}
+}
+
+void Expression::resolve_kind() noexcept {
+	// the same decisions eval_unresolved makes, less those needing the environment
+	SymbolId form = m_head.asSymbolId();
+
+	if (nodes().empty()) {
+		if (form == SYM_LIST && !m_head.isString()) {
+			m_kind = BUILTIN_CALL;
+		}
+		else if (m_head.isString() || m_head.isNumber() || m_head.isComplex()) {
+			m_kind = CONSTANT;
+		}
+		else if (m_head.isSymbol()) {
+			m_kind = LOOKUP;
+		}
+		else {
+			m_kind = UNRESOLVED;
+		}
+		return;
+	}
+
+	switch (form) {
+	case SYM_BEGIN:
+		m_kind = BEGIN_FORM;
+		break;
+	case SYM_DEFINE:
+		m_kind = DEFINE_FORM;
+		break;
+	case SYM_APPLY:
+	case SYM_MAP:
+		m_kind = APPLY_MAP_FORM;
+		break;
+	case SYM_LAMBDA:
+		m_kind = LAMBDA_FORM;
+		break;
+	case SYM_SET_PROPERTY:
+		m_kind = SET_PROPERTY_FORM;
+		break;
+	case SYM_GET_PROPERTY:
+		m_kind = GET_PROPERTY_FORM;
+		break;
+	case SYM_CONTINUOUS_PLOT:
+		m_kind = CONTINUOUS_PLOT_FORM;
+		break;
+	default:
+		if (!m_head.isSymbol()) {
+			m_kind = UNRESOLVED;
+		}
+		else if (Environment::builtin(form) != nullptr) {
+			m_kind = BUILTIN_CALL;
+		}
+		else {
+			m_kind = CALL;
+		}
+		break;
+	}
+}
+
+// the most elements the value of a folded call may have, so that a
+// program does not carry large lists it built while being parsed
+static const std::size_t MAX_FOLDED_ELEMENTS = 256;
+
+// push the value of node onto args if it is known without an environment
+static bool constant_argument(const Expression & node, std::vector<Expression> & args) {
+	switch (node.kind()) {
+	case Expression::CONSTANT:
+		args.emplace_back(node.head());
+		return true;
+	case Expression::FOLDED_CALL:
+		args.push_back(*node.folded());
+		return true;
+	case Expression::LOOKUP:
+		break;
+	default:
+		return false;
+	}
+
+	SymbolId id = node.head().asSymbolId();
+	if (id < SYM_PI || id > SYM_I) {
+		return false;
+	}
+	static const Environment defaults;
+	args.push_back(defaults.get_exp(node.head()));
+	return true;
+}
+
+void Expression::fold_constants() {
+	// post-order with an explicit stack, programs may be nested deeply; the
+	// second of each pair says whether the tail has been pushed already
+	std::vector<std::pair<Expression *, bool>> pending(1, std::make_pair(this, false));
+	while (!pending.empty()) {
+		Expression * exp = pending.back().first;
+		if (pending.back().second || !exp->m_tail || exp->m_packed || exp->m_kind == FOLDED_CALL) {
+			pending.pop_back();
+			exp->fold_call();
+			continue;
+		}
+		pending.back().second = true;
+		for (Expression & node : exp->own_tail()) {
+			pending.emplace_back(&node, false);
+		}
+	}
+}
+
+void Expression::fold_call() {
+	SymbolId id = m_head.asSymbolId();
+	if (m_kind != BUILTIN_CALL || nodes().empty() || id == SYM_DISCRETE_PLOT) {
+		return;
+	}
+
+	// the value is kept with the program, beyond any evaluation
+	HeapScope heap;
+
+	std::vector<Expression> args;
+	args.reserve(nodes().size());
+	for (const Expression & node : nodes()) {
+		if (!constant_argument(node, args)) {
+			return;
+		}
+	}
+
+	// a long range would only be thrown away below
+	if (id == SYM_RANGE && args.size() == 3 && args[0].isHeadNumber() && args[1].isHeadNumber() && args[2].isHeadNumber()) {
+		double step = args[2].head().asNumber();
+		if (step > 0 && (args[1].head().asNumber() - args[0].head().asNumber()) / step > MAX_FOLDED_ELEMENTS) {
+			return;
+		}
+	}
+
+	std::shared_ptr<FoldedTail> tail = std::make_shared<FoldedTail>();
+	try {
+		tail->value = Environment::builtin(id)(args);
+	}
+	catch (...) {
+		// evaluating the call reports the error, when and if it is evaluated
+		return;
+	}
+	const PackedList * list = tail->value.packed();
+	if (tail->value.isList() && (list != nullptr ? list->size() : tail->value.tailView().size()) > MAX_FOLDED_ELEMENTS) {
+		return;
+	}
+
+	tail->swap(own_tail());
+	m_tail = std::move(tail);
+	m_kind = FOLDED_CALL;
+}
+
+Expression Expression::eval_node(Environment & env) const {
+	switch (m_kind) {
+	case UNRESOLVED:
+		return eval_unresolved(env);
+	case CONSTANT:
+		return Expression(m_head);
+	case LOOKUP:
+		return handle_symbol(env);
+	case BEGIN_FORM:
+		return handle_begin(env);
+	case DEFINE_FORM:
+		return handle_define(env);
+	case APPLY_MAP_FORM:
+		return handle_apply_map(env);
+	case LAMBDA_FORM:
+		return handle_lambda();
+	case CALL:
+		return handle_call(env);
+	default:
+		break;
+	}
+
+	// a lambda may have been bound to the name of a built-in procedure or
+	// of a form it takes the place of, then the name is looked up each time
+	if (env.shadows_builtins()) {
+		return eval_unresolved(env);
+	}
+
+	switch (m_kind) {
+	case FOLDED_CALL:
+		return *folded();
+	case SET_PROPERTY_FORM:
+		return handle_set_property(env);
+	case GET_PROPERTY_FORM:
+		return handle_get_property(env);
+	case CONTINUOUS_PLOT_FORM:
+		return handle_continuous(env);
+	default:
+		return handle_builtin(env);
+	}
+}
+
+Expression Expression::eval_unresolved(Environment & env) const {
+	// special forms are told apart by their interned symbol id
+	SymbolId form = m_head.asSymbolId();
+
+	if (nodes().empty()) {
+		if (form == SYM_LIST && !m_head.isString()) {
 			std::vector<Expression> results;
 			return apply(m_head, results, env);
 		}
 		return handle_lookup(m_head, env);
 	}
+
+	switch (form) {
 	// handle begin special-form
-	else if (m_head.isSymbol() && m_head.asSymbol() == "begin") {
+	case SYM_BEGIN:
 		return handle_begin(env);
-	}
 	// handle define special-form
-	else if (m_head.isSymbol() && m_head.asSymbol() == "define") {
+	case SYM_DEFINE:
 		return handle_define(env);
-	}
 	// handle apply
-	else if (m_head.isSymbol() && (m_head.asSymbol() == "apply" || m_head.asSymbol() == "map")) {
+	case SYM_APPLY:
+	case SYM_MAP:
 		return handle_apply_map(env);
-	}
 	// handle lambda special-form
-	else if (m_head.isSymbol() && m_head.asSymbol() == "lambda") {
+	case SYM_LAMBDA:
 		return handle_lambda();
+	default:
+		break;
 	}
+
 	// if lambda function is called
-	else if (env.is_exp(m_head) && env.get_exp(m_head).head().asSymbol() == "lambda") {
+	if (env.is_exp(m_head) && env.get_exp(m_head).head().asSymbolId() == SYM_LAMBDA) {
 		return handle_recall_lambda(env);
 	}
+
+	switch (form) {
 	// if set-property is called
-	else if (m_head.isSymbol() && m_head.asSymbol() == "set-property") {
-		// handle set property
+	case SYM_SET_PROPERTY:
 		return handle_set_property(env);
-	}
 	// if get-property is called
-	else if (m_head.isSymbol() && m_head.asSymbol() == "get-property") {
+	case SYM_GET_PROPERTY:
 		return handle_get_property(env);
-	}
 	// if continuous-plot is called
-	else if (m_head.isSymbol() && m_head.asSymbol() == "continuous-plot") {
+	case SYM_CONTINUOUS_PLOT:
 		return handle_continuous(env);
-	}
 	// else attempt to treat as procedure
-	else {
-		std::vector<Expression> results;
-		for (Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it) {
-			results.push_back(it->eval(env));
-		}
-		return apply(m_head, results, env);
+	default:
+		return handle_procedure(env);
 	}
 }
 
@@ -721,17 +1246,27 @@ std::ostream & operator<<(std::ostream & out, const Expression & exp) {
 	else {
 		static bool is_lambda = false;
 		out << "(";
-		if (exp.head().asSymbol() == "lambda") {
+		if (exp.head().asSymbolId() == SYM_LAMBDA) {
 			is_lambda = true;
 			if (!exp.isTailEmpty()) {
 				out << *exp.tailConstBegin();
-				if (exp.getTail().size() > 1) {
+				if (exp.tailView().size() > 1) {
 					out << " ";
 					out << *(exp.tailConstBegin() + 1);
 				} 
 			}
 			is_lambda = false;
 		}
+		else if (exp.packed() != nullptr) {
+			// print the values without boxing them
+			const PackedList & list = *exp.packed();
+			for (std::size_t i = 0; i < list.size(); ++i) {
+				if (i > 0) {
+					out << " ";
+				}
+				out << "(" << (list.isComplex() ? Atom(list.complexes()[i]) : Atom(list.reals()[i])) << ")";
+			}
+		}
 		else {
 			if (!exp.isList()) {
 				out << exp.head();
@@ -755,11 +1290,33 @@ bool Expression::operator==(const Expression & exp) const noexcept {
 
 	bool result = (m_head == exp.m_head);
 
-	result = result && (m_tail.size() == exp.m_tail.size());
+	// a shared tail is equal to itself
+	if (!result || m_tail == exp.m_tail) {
+		return result;
+	}
+
+	if (m_packed && exp.m_packed) {
+		const PackedList & left = *packed();
+		const PackedList & right = *exp.packed();
+		if (left.isComplex() != right.isComplex() || left.size() != right.size()) {
+			return false;
+		}
+		// compare as atoms, which allow for rounding
+		for (std::size_t i = 0; i < left.size(); ++i) {
+			if (left.isComplex() ? !(Atom(left.complexes()[i]) == Atom(right.complexes()[i])) : !(Atom(left.reals()[i]) == Atom(right.reals()[i]))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const Tail & left = nodes();
+	const Tail & right = exp.nodes();
+	result = result && (left.size() == right.size());
 
 	if (result) {
-		for (auto lefte = m_tail.begin(), righte = exp.m_tail.begin();
-			(lefte != m_tail.end()) && (righte != exp.m_tail.end());
+		for (auto lefte = left.begin(), righte = right.begin();
+			(lefte != left.end()) && (righte != right.end());
 			++lefte, ++righte) {
 			result = result && (*lefte == *righte);
 		}
@@ -769,23 +1326,21 @@ bool Expression::operator==(const Expression & exp) const noexcept {
 }
 
 void Expression::add_pair(const Expression & key, const Expression & value) {
-	if (m_properties.find(key.head().asSymbol()) != m_properties.end()) {
-		m_properties.at(key.head().asSymbol()) = value;
-	}
-	else {
-		m_properties.insert(std::make_pair(key.head().asSymbol(), value));
-	}
+	// copy before unsharing, value may be one of the properties
+	Expression copy(value);
+	own_properties().set(key.head().asSymbolId(), std::move(copy));
 }
 
-Expression Expression::get_value(Expression & key) {
-	if (m_properties.find(key.head().asSymbol()) == m_properties.end()) {
+Expression Expression::get_value(const Expression & key) const {
+	const Expression * found = properties().find(key.head().asSymbolId());
+	if (found == nullptr) {
 		return Expression();
 	}
-	return m_properties.at(key.head().asSymbol());
+	return *found;
 }
 
-bool Expression::is_value(Expression & key) {
-	return (m_properties.find(key.head().asSymbol()) != m_properties.end());
+bool Expression::is_value(const Expression & key) const {
+	return properties().find(key.head().asSymbolId()) != nullptr;
 }
 
 void Expression::setList()
@@ -798,6 +1353,11 @@ bool Expression::isList() const noexcept
 	return is_list;
 }
 
+const PropertyTable & Expression::properties() const noexcept
+{
+	return m_properties != nullptr ? *m_properties : PropertyTable::none();
+}
+
 bool operator!=(const Expression & left, const Expression & right) noexcept {
 
 	return !(left == right);
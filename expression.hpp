@@ -4,7 +4,9 @@ Defines the Expression type and assiciated functions.
 #ifndef EXPRESSION_HPP
 #define EXPRESSION_HPP
 
-#include <map>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -15,17 +17,98 @@ Defines the Expression type and assiciated functions.
  // forward declare Environment
 class Environment;
 
+// forward declare PropertyTable
+class PropertyTable;
+
+// forward declare PackedList
+class PackedList;
+
+// forward declare MemoCache
+class MemoCache;
+
 /*! \class Expression
 \brief An expression is a tree of Atoms.
 
 An expression is an atom called the head followed by a (possibly empty)
 list of expressions called the tail.
+
+The tail and the property table are shared between copies and cloned only
+when a copy that shares them is changed, so copying an expression takes
+constant time. Evaluation never changes an expression, and the sharing is
+reference counted atomically, so copies can be handed to another thread.
+
+A list of only real or only complex numbers may keep its tail as a
+PackedList, which reading the tail as expressions boxes on first use. The
+tail of a memoized lambda also holds the MemoCache its copies share.
  */
 
 class Expression {
 public:
 
-	typedef std::vector<Expression>::const_iterator ConstIteratorType;
+	/// the tail, the elements of a list or the arguments of a call
+	typedef std::vector<Expression> Tail;
+
+	/*! \enum Kind
+	\brief What an expression is, as far as can be told without an environment.
+
+	A call of a built-in procedure, or a set-property, get-property or
+	continuous-plot form, is a call of a lambda instead if one is bound to
+	its name, see Environment::shadows_builtins. The same goes for a folded
+	call when pi, e or I is bound in its place.
+	 */
+	enum Kind : std::uint8_t {
+		UNRESOLVED, ///< not resolved, eval works it out from the environment
+		CONSTANT,   ///< a number, complex or string, evaluating to itself
+		LOOKUP,     ///< a symbol, evaluating to its value
+		BEGIN_FORM,
+		DEFINE_FORM,
+		APPLY_MAP_FORM,
+		LAMBDA_FORM,
+		SET_PROPERTY_FORM,
+		GET_PROPERTY_FORM,
+		CONTINUOUS_PLOT_FORM,
+		BUILTIN_CALL, ///< a call of a built-in procedure
+		FOLDED_CALL,  ///< a call of a built-in procedure on constants, see fold_constants
+		CALL          ///< a call of any other symbol, a lambda or an error
+	};
+
+	typedef Tail::const_iterator ConstIteratorType;
+
+	/*! \class TailView
+	\brief A read-only view of an expression's tail, taken without copying it.
+
+	The view stays valid until the expression it was taken from, and every
+	copy sharing its tail, is changed or destroyed.
+	 */
+	class TailView {
+	public:
+		typedef const Expression * const_iterator;
+
+		TailView() noexcept : m_first(nullptr), m_size(0) {}
+		TailView(const Expression * first, std::size_t size) noexcept : m_first(first), m_size(size) {}
+
+		/// the number of expressions in the tail
+		std::size_t size() const noexcept { return m_size; }
+
+		/// whether the tail is empty
+		bool empty() const noexcept { return m_size == 0; }
+
+		/// the expression at index, which must be less than size()
+		const Expression & operator[](std::size_t index) const noexcept { return m_first[index]; }
+
+		/// the expression at index, throwing std::out_of_range past the end
+		const Expression & at(std::size_t index) const;
+
+		const Expression & front() const noexcept { return m_first[0]; }
+		const Expression & back() const noexcept { return m_first[m_size - 1]; }
+
+		const_iterator begin() const noexcept { return m_first; }
+		const_iterator end() const noexcept { return m_first + m_size; }
+
+	private:
+		const Expression * m_first;
+		std::size_t m_size;
+	};
 
 	/// Default construct and Expression, whose type in NoneType
 	Expression();
@@ -36,17 +119,39 @@ public:
 	Expression(const Atom & a);
 
 	/// lambda constructor
-	Expression(const Expression & a, const Expression & b);
+	Expression(Expression a, Expression b);
 
 	/// head and tail constructor
-	Expression(const Atom & a, const std::vector<Expression> & b) : m_head(a), m_tail(b) {};
+	Expression(const Atom & a, const std::vector<Expression> & b);
+
+	/// head and tail constructor, taking over the tail
+	Expression(const Atom & a, std::vector<Expression> && b);
 
-	/// deep-copy construct an expression (recursive)
+	/// make a list expression with a packed tail, see make_list
+	static Expression fromPacked(std::shared_ptr<const PackedList> list);
+
+	/*! Make a copy of a lambda value whose calls are looked up in a new
+	  MemoCache first
+	  \param lambda the lambda value
+	  \param capacity the most results the cache keeps
+	 */
+	static Expression memoized(const Expression & lambda, std::size_t capacity);
+
+	/// copy construct an expression, sharing its tail and properties
 	Expression(const Expression & a);
 
-	/// deep-copy assign an expression  (recursive)
+	/// move construct an expression, leaving a empty
+	Expression(Expression && a) noexcept;
+
+	/// copy assign an expression, sharing its tail and properties
 	Expression & operator=(const Expression & a);
 
+	/// move assign an expression, leaving a empty
+	Expression & operator=(Expression && a) noexcept;
+
+	/// release the tail and properties
+	~Expression();
+
 	/// return a reference to the head Atom
 	Atom & head();
 
@@ -61,17 +166,33 @@ public:
 	/// append Expression to tail of the expression
 	void append(const Expression & exp);
 
-	/// return a pointer to the last expression in the tail, or nullptr
+	/// move Expression onto the tail of the expression
+	void append(Expression && exp);
+
+	/// return a pointer to the last expression in the tail, or nullptr,
+	/// unsharing the tail first
 	Expression * tail();
 
 	/// returns whether tail is empty
 	bool isTailEmpty() const noexcept;
 
-	/// sets tail
+	/// sets tail, pass an rvalue to take over its elements
 	void setTail(std::vector<Expression> to_add);
 
-	/// gets tail
-	std::vector<Expression> getTail() const noexcept;
+	/// gets a view of the tail, without copying it
+	TailView tailView() const noexcept;
+
+	/// the packed tail of a list of numbers, or nullptr if the tail is not packed
+	const PackedList * packed() const noexcept;
+
+	/// the result cache of a lambda made by memoized, or nullptr if it has none
+	MemoCache * memo() const noexcept;
+
+	/// gets a copy of the tail
+	std::vector<Expression> getTail() const &;
+
+	/// gets the tail of a temporary, moving it out unless it is shared
+	std::vector<Expression> getTail() &&;
 
 	/// return a const-iterator to the beginning of tail
 	ConstIteratorType tailConstBegin() const noexcept;
@@ -86,54 +207,223 @@ public:
 	bool isHeadSymbol() const noexcept;
 
 	/// Evaluate expression using a post-order traversal (recursive)
-	Expression eval(Environment & env);
+	Expression eval(Environment & env) const;
 
 	/// equality comparison for two expressions (recursive)
 	bool operator==(const Expression & exp) const noexcept;
 
 	void add_pair(const Expression & key, const Expression & value);
-	Expression get_value(Expression & key);
-	bool is_value(Expression & key);
+	Expression get_value(const Expression & key) const;
+	bool is_value(const Expression & key) const;
 	void setList();
 
 	bool isList() const noexcept;
 
-	Expression handle_recall_lambda(Environment & env);
+	/*! The number of Expressions copied on the calling thread so far,
+	  including the elements of cloned tails, for tests and benchmarks to
+	  check that values are moved and shared
+	 */
+	static std::size_t copies() noexcept;
+
+	/// return the properties set on the expression, by name
+	const PropertyTable & properties() const noexcept;
+
+	/// where in the program text the expression was parsed from, line 0 if unknown
+	const SourceSpan & span() const noexcept;
+
+	/// set where in the program text the expression was parsed from
+	void setSpan(const SourceSpan & span) noexcept;
+
+	Expression handle_recall_lambda(Environment & env) const;
+
+	/// the lambda value a lambda form evaluates to, in any environment
+	Expression handle_lambda() const;
+
+	/*! Work out once what this expression and each expression in its tail
+	  is, a special form, a call of a built-in procedure or of another
+	  symbol, so eval can dispatch on it without looking at the environment
+	  first. parse does this for every program it returns; changing the
+	  head or tail afterwards undoes it for that expression.
+	 */
+	void resolve();
+
+	/// what resolve found the expression to be, UNRESOLVED if it was not resolved
+	Kind kind() const noexcept { return m_kind; }
+
+	/*! Evaluate ahead of time each call of a built-in procedure, other than
+	  discrete-plot, whose arguments are numbers, complexes, strings, pi, e,
+	  I or such calls themselves, keeping its value in the call. eval then
+	  returns the value while no lambda or constant is bound to a built-in
+	  name, and evaluates the call as before otherwise. A call that fails is
+	  left alone, so it fails as before when evaluated, as are calls whose
+	  value is a list of more than a few hundred elements. Call after
+	  resolve; the head and tail, and so printing and comparison, stay as
+	  they were.
+	 */
+	void fold_constants();
+
+	/// the value fold_constants found for the expression, or nullptr if it was not folded
+	const Expression * folded() const noexcept;
 private:
 
+	// the tail of a folded call, holding its value alongside its arguments
+	struct FoldedTail;
+
+	// the tail of a memoized lambda, holding its cache alongside its parameters and body
+	struct MemoTail;
+
 	// the head of the expression
 	Atom m_head;
 
 	// the tail list is expressed as a vector for access efficiency
-	// and cache coherence, at the cost of wasted memory.
-	std::vector<Expression> m_tail;
-
-	// convenience typedef
-	typedef std::vector<Expression>::iterator IteratorType;
+	// and cache coherence, shared between copies; null when empty
+	std::shared_ptr<Tail> m_tail;
 
-	// property map
-	std::map<std::string, Expression> m_properties;
+	// properties, shared between copies by the table's own count; null when empty
+	PropertyTable * m_properties = nullptr;
 
 	// list
 	bool is_list = false;
 
+	// whether m_tail is the boxed part of a PackedList; when m_kind is
+	// FOLDED_CALL it is part of a FoldedTail instead
+	bool m_packed = false;
+
+	// whether m_tail is part of a MemoTail
+	bool m_memo = false;
+
+	// what the expression is, see resolve
+	Kind m_kind = UNRESOLVED;
+
+	// source text the expression came from
+	SourceSpan m_span;
+
+	// the tail, read-only
+	const Tail & nodes() const noexcept;
+
+	// the tail, cloned first if another expression shares it or unpacked if packed
+	Tail & own_tail();
+
+	// the properties, cloned first if another expression shares them
+	PropertyTable & own_properties();
+
+	// drop this expression's ownership of its properties
+	static void release_properties(PropertyTable * properties) noexcept;
+
+	// drop the tail, freeing nested tails only it holds one at a time rather
+	// than recursively, as an expression may be nested deeply
+	void release_tail() noexcept;
+
+	// set m_kind, leaving the tail alone, see resolve
+	void resolve_kind() noexcept;
+
+	// fold this call if its arguments are folded already, see fold_constants
+	void fold_call();
+
+	// evaluate without profiling, see eval
+	Expression eval_node(Environment & env) const;
+
+	// evaluate without using m_kind
+	Expression eval_unresolved(Environment & env) const;
+
 	// internal helper methods
-	Expression handle_lookup(const Atom & head, const Environment & env);
-	Expression handle_define(Environment & env);
-	Expression handle_lambda();
-	std::vector<Expression> exp_to_atom(Expression e);
+	Expression handle_lookup(const Atom & head, const Environment & env) const;
+	Expression handle_symbol(const Environment & env) const;
+	Expression handle_call(Environment & env) const;
+	Expression handle_builtin(Environment & env) const;
+	Expression handle_procedure(Environment & env) const;
+	Expression handle_define(Environment & env) const;
+	std::vector<Expression> exp_to_atom(const Expression & e) const;
 	
-	Expression handle_begin(Environment & env);
-	Expression handle_apply_map(Environment & env);
-	Expression handle_set_property(Environment & env);
-	Expression handle_get_property(Environment & env);
-	Expression handle_continuous(Environment & env);
+	Expression handle_begin(Environment & env) const;
+	Expression handle_apply_map(Environment & env) const;
+	Expression handle_set_property(Environment & env) const;
+	Expression handle_get_property(Environment & env) const;
+	Expression handle_continuous(Environment & env) const;
 	Expression continuous_lambda(Environment & env, Expression func);
 };
 
+// moves and destruction are inline, they happen on every step of evaluation
+inline Expression::Expression(Expression && a) noexcept :
+	m_head(a.m_head), m_tail(std::move(a.m_tail)), m_properties(a.m_properties), is_list(a.is_list), m_packed(a.m_packed), m_memo(a.m_memo), m_kind(a.m_kind), m_span(a.m_span) {
+	a.m_properties = nullptr;
+	a.m_packed = false;
+	a.m_memo = false;
+}
+
+inline Expression::~Expression() {
+	if (m_properties != nullptr) {
+		release_properties(m_properties);
+	}
+	if (m_tail) {
+		release_tail();
+	}
+}
+
 /// Render expression to output stream
 std::ostream & operator<<(std::ostream & out, const Expression & exp);
 
+/*! Plot a function, given the evaluated arguments of a continuous-plot
+  form; the function is bound in env while it is sampled
+  \param results the function, the bounds and optionally the options
+  \param env the environment to call the function in
+  \return the graphics of the plot, as a list
+  \throws SemanticError if the arguments are invalid
+ */
+Expression continuous_plot(const std::vector<Expression> & results, Environment & env);
+
+/*! Plot a function like continuous_plot, evaluating each sample with sample
+  \param results the function, the bounds and optionally the options
+  \param env the environment to call the function in
+  \param sample evaluates a call of the function, bound in env, on one value
+  \return the graphics of the plot, as a list
+  \throws SemanticError if the arguments are invalid
+ */
+Expression continuous_plot(const std::vector<Expression> & results, Environment & env,
+	const std::function<Expression(const Expression &, Environment &)> & sample);
+
+/*! Call the procedure a symbol names in an environment, the way a call
+  that is not a lambda call is made
+  \param op the name of the procedure
+  \param args the evaluated arguments
+  \param env the environment to look op up in
+  \return the result of the call
+  \throws SemanticError if op is not a symbol naming a procedure
+ */
+Expression apply(const Atom & op, const std::vector<Expression> & args, const Environment & env);
+
+/*! Apply or map a procedure over the elements of an evaluated list, the
+  way an apply or map form does once its arguments are checked: each
+  element is evaluated again as an argument of a call of op
+  \param op the name of the procedure or lambda
+  \param map true to call op on each element, false to call it on all of them
+  \param elements the elements of the list
+  \param env the environment to make the calls in
+  \return the result of the call, or the list of results when mapping
+ */
+Expression apply_or_map(const Atom & op, bool map, std::vector<Expression> && elements, Environment & env);
+
+/*! Determine if what a symbol maps to is a lambda
+  \param value the expression the symbol maps to, or nullptr
+  \return true if value is a lambda
+ */
+bool is_lambda(const Expression * value) noexcept;
+
+/*! Determine if a symbol names a form the tree walker treats specially
+  even when called with one argument
+  \param op the symbol
+  \return true if op is begin, define, apply, map, lambda, set-property,
+  get-property or continuous-plot
+ */
+bool is_special_form(SymbolId op) noexcept;
+
+/*! Determine if a list element evaluates to its own head, see
+  Expression::handle_lookup
+  \param exp the element
+  \return true if exp is a number, complex number or string with no tail
+ */
+bool is_self_evaluating(const Expression & exp) noexcept;
+
 /// inequality comparison for two expressions (recursive)
 bool operator!=(const Expression & left, const Expression & right) noexcept;
 
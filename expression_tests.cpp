@@ -1,5 +1,8 @@
 #include "catch.hpp"
 
+#include <thread>
+#include <vector>
+
 #include "expression.hpp"
 
 TEST_CASE( "Test default expression", "[expression]" ) {
@@ -33,3 +36,113 @@ TEST_CASE("testing random bits of expression", "[expression]") {
 	Expression exp1(Atom("list"));
 	exp.is_value(exp1);
 }
+
+TEST_CASE("Test expressions move rather than copy", "[expression]") {
+	Expression list{ Atom("list") };
+	for (int i = 0; i < 100; ++i) {
+		list.append(Expression(i));
+	}
+
+	std::size_t before = Expression::copies();
+
+	Expression moved(std::move(list));
+	REQUIRE(moved.getTail().size() == 100);
+	std::size_t after_get = Expression::copies();
+	REQUIRE(after_get - before == 100);
+
+	Expression assigned;
+	assigned = std::move(moved);
+	std::vector<Expression> tail = std::move(assigned).getTail();
+	REQUIRE(tail.size() == 100);
+	Expression rebuilt(Atom("list"), std::move(tail));
+	rebuilt.append(Expression(100));
+	REQUIRE(Expression::copies() == after_get);
+
+	Expression copied(rebuilt);
+	REQUIRE(Expression::copies() - after_get == 1);
+}
+
+TEST_CASE("Test expression copies share their tail until changed", "[expression]") {
+	Expression list{ Atom("list") };
+	for (int i = 0; i < 100000; ++i) {
+		list.append(Expression(i));
+	}
+	list.add_pair(Expression(Atom("size")), Expression(1));
+
+	Expression copy(list);
+	REQUIRE(&*copy.tailConstBegin() == &*list.tailConstBegin());
+	REQUIRE(&copy.properties() == &list.properties());
+	REQUIRE(copy == list);
+
+	// changing the copy clones what it changes, the original is untouched
+	copy.append(Expression(100000));
+	copy.add_pair(Expression(Atom("size")), Expression(2));
+	REQUIRE(&*copy.tailConstBegin() != &*list.tailConstBegin());
+	REQUIRE(list.getTail().size() == 100000);
+	REQUIRE(copy.getTail().size() == 100001);
+	REQUIRE(list.get_value(Expression(Atom("size"))) == Expression(1));
+	REQUIRE(copy.get_value(Expression(Atom("size"))) == Expression(2));
+
+	// an expression can append a part of itself
+	Expression self{ Atom("list") };
+	self.append(Expression(1));
+	self.append(*self.tailConstBegin());
+	REQUIRE(self.getTail().size() == 2);
+	REQUIRE(self.getTail()[1] == Expression(1));
+}
+
+TEST_CASE("Test expression copies can change on other threads", "[expression]") {
+	Expression list{ Atom("list") };
+	for (int i = 0; i < 1000; ++i) {
+		list.append(Expression(i));
+	}
+
+	// each thread takes its own copy, as the kernel does handing a result over
+	std::vector<std::thread> threads;
+	std::vector<std::size_t> sizes(4);
+	for (std::size_t t = 0; t < sizes.size(); ++t) {
+		threads.emplace_back([list, t, &sizes]() mutable {
+			for (int i = 0; i < 100; ++i) {
+				Expression mine(list);
+				mine.append(Expression(i));
+				list = mine;
+			}
+			sizes[t] = list.getTail().size();
+		});
+	}
+	for (auto & thread : threads) {
+		thread.join();
+	}
+
+	REQUIRE(list.getTail().size() == 1000);
+	for (auto size : sizes) {
+		REQUIRE(size == 1100);
+	}
+}
+
+TEST_CASE("Test tail views read the tail without copying it", "[expression]") {
+	Expression list{ Atom("list") };
+	for (int i = 0; i < 10; ++i) {
+		list.append(Expression(i));
+	}
+
+	std::size_t before = Expression::copies();
+	Expression::TailView view = list.tailView();
+	REQUIRE(view.size() == 10);
+	REQUIRE(!view.empty());
+	REQUIRE(view[3] == Expression(3));
+	REQUIRE(view.at(9) == Expression(9));
+	REQUIRE(view.front() == Expression(0));
+	REQUIRE(view.back() == Expression(9));
+	REQUIRE(&view[0] == &*list.tailConstBegin());
+
+	double sum = 0;
+	for (const Expression & e : view) {
+		sum += e.head().asNumber();
+	}
+	REQUIRE(sum == 45);
+	REQUIRE(Expression::copies() == before);
+
+	REQUIRE_THROWS_AS(view.at(10), std::out_of_range);
+	REQUIRE(Expression().tailView().empty());
+}
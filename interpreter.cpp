@@ -1,8 +1,15 @@
 #include "interpreter.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "profiler.hpp"
+
 #define START "%start"
 #define STOP "%stop"
 #define RESET "%reset" 
 #define EXIT "%exit"
+#define CACHE "%cache"
 
 Interpreter::Interpreter()
 {
@@ -24,11 +31,26 @@ Interpreter::Interpreter(MessageQueue<MessageType>* ichannel, MessageQueue<Expre
 
 bool Interpreter::parseStream(std::istream & expression) noexcept{
 
-  TokenSequenceType tokens = tokenize(expression);
+  return parseBuffer(read_stream(expression));
+}
+
+bool Interpreter::parseBuffer(std::shared_ptr<const SourceBuffer> source) noexcept{
+
+  if (cache.find(source->data(), source->size(), ast)) {
+    return true;
+  }
+
+  TokenSequenceType tokens = tokenize(source);
 
   ast = parse(tokens);
 
-  return (ast != Expression());
+  if (ast == Expression()) {
+    return false;
+  }
+
+  cache.insert(source->data(), source->size(), ast);
+
+  return true;
 }
 		
 void Interpreter::operator()()
@@ -48,6 +70,15 @@ void Interpreter::operator()()
 		}
 		else if (iqueue->try_pop(input))
 		{
+			if (input == CACHE)
+			{
+				std::ostringstream report;
+				report << "parse cache: " << cache.hits() << " hits, " << cache.misses() << " misses, "
+					<< cache.entries() << " entries, " << cache.bytes() << " of " << cache.capacity() << " bytes";
+				oqueue->push(Expression(Atom(report.str(), true)));
+				continue;
+			}
+
 			std::istringstream expression(input);
 			if (!parseStream(expression))
 			{	
@@ -85,7 +116,56 @@ void Interpreter::connect_func(MessageQueue<MessageType>* ichannel, MessageQueue
 
 Expression Interpreter::evaluate(){
 
-  return ast.eval(env);
+  return evaluate(ast);
+}
+
+Expression Interpreter::evaluate(const Expression & exp){
+
+  // the environments of lambda calls come from the arena and are dropped together at the end
+  EvalArenaScope arena;
+
+  if (Profiler::active() == nullptr) {
+    if (eval_engine == BYTECODE) {
+      return vm.evaluate(exp, env);
+    }
+    if (eval_engine == CLOSURES) {
+      return closures.evaluate(exp, env);
+    }
+    if (eval_engine == ITERATIVE) {
+      return iterative.evaluate(exp, env);
+    }
+  }
+  return exp.eval(env);
+}
+
+void Interpreter::setEngine(Engine engine)
+{
+	eval_engine = engine;
+}
+
+Interpreter::Engine Interpreter::engine() const
+{
+	return eval_engine;
+}
+
+void Interpreter::setMaxDepth(std::size_t depth)
+{
+	iterative.setMaxDepth(depth);
+}
+
+Interpreter::Engine Interpreter::default_engine()
+{
+	const char * name = std::getenv("PLOTSCRIPT_ENGINE");
+	if (name != nullptr && std::strcmp(name, "bytecode") == 0) {
+		return BYTECODE;
+	}
+	if (name != nullptr && std::strcmp(name, "closures") == 0) {
+		return CLOSURES;
+	}
+	if (name != nullptr && std::strcmp(name, "iterative") == 0) {
+		return ITERATIVE;
+	}
+	return TREE_WALKER;
 }
 
 void Interpreter::setGUI()
@@ -93,3 +173,13 @@ void Interpreter::setGUI()
 
 	gui = true; 
 }
+
+void Interpreter::setParseCacheCapacity(std::size_t bytes)
+{
+	cache.setCapacity(bytes);
+}
+
+const ParseCache & Interpreter::parseCache() const
+{
+	return cache;
+}
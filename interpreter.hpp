@@ -10,7 +10,11 @@
 #include "tsQueue.hpp"
 #include "token.hpp"
 #include "parse.hpp"
+#include "parse_cache.hpp"
+#include "closure_engine.hpp"
+#include "iterative_evaluator.hpp"
 #include "semantic_error.hpp"
+#include "virtual_machine.hpp"
 #include <iostream>
 typedef std::string MessageType;
 /*! \class Interpreter
@@ -28,12 +32,32 @@ struct QueueItem {
 
 class Interpreter {
 public:
+	/*! \enum Engine
+	\brief The ways the interpreter can evaluate a program; all give the
+	same results and errors.
+
+	The default is read from the PLOTSCRIPT_ENGINE environment variable,
+	"bytecode", "closures", "iterative" or anything else for the tree walker.
+	 */
+	enum Engine {
+		TREE_WALKER, ///< walk the AST, see Expression::eval
+		BYTECODE,    ///< compile to bytecode and run it, see VirtualMachine
+		CLOSURES,    ///< compile to a tree of closures and call it, see ClosureEngine
+		ITERATIVE    ///< walk the AST with an explicit stack, see IterativeEvaluator
+	};
+
 	Interpreter(); 
 
 	Interpreter(MessageQueue<MessageType> * ichannel, MessageQueue<Expression> * ochannel, MessageQueue<std::string> * echannel, MessageQueue<MessageType> * kernel_cmd_channel , MessageQueue<bool> * kernel_ichannel );
 
 	bool parseStream(std::istream &expression) noexcept;
 
+	/*! Parse a whole program held in a buffer, e.g. a memory-mapped file.
+	  \param source the program text
+	  \return true if the buffer held exactly one valid expression
+	 */
+	bool parseBuffer(std::shared_ptr<const SourceBuffer> source) noexcept;
+
 	/*!
 	Interpreter Kernel Thread Function
 	*/
@@ -50,8 +74,39 @@ public:
 	 */
 	Expression evaluate();
 
+	/*! Evaluate a given Expression in the current environment, e.g. one
+	  top-level form handed back by a StreamParser.
+	  \param exp the expression to evaluate
+	  \return the Expression resulting from the evaluation
+	  \throws SemanticError when a semantic error is encountered
+	 */
+	Expression evaluate(const Expression & exp);
+
 	void setGUI(); 
 
+	/*! Choose how later evaluations are done. While a Profiler is active
+	  the tree walker is used whatever the engine, as only it times forms.
+	  \param engine the engine
+	 */
+	void setEngine(Engine engine);
+
+	/*! The engine evaluations are done with */
+	Engine engine() const;
+
+	/*! Set how deeply the ITERATIVE engine lets an evaluation nest before it
+	  fails with a SemanticError, see IterativeEvaluator::setMaxDepth.
+	  \param depth the most forms and lambda calls waiting at once
+	 */
+	void setMaxDepth(std::size_t depth);
+
+	/*! Set the memory cap of the parse cache, evicting entries as needed.
+	  \param bytes the cap in bytes, 0 disables caching
+	 */
+	void setParseCacheCapacity(std::size_t bytes);
+
+	/*! The cache of parsed programs, e.g. for its hit and miss counters */
+	const ParseCache & parseCache() const;
+
 private:
 
 	//Input Message Queue
@@ -75,6 +130,24 @@ private:
 	// the AST
 	Expression ast;
 
+	// ASTs of recently parsed programs, by source text
+	ParseCache cache;
+
 	bool gui = false; 
+
+	// how programs are evaluated
+	Engine eval_engine = default_engine();
+
+	// runs programs when the engine is BYTECODE
+	VirtualMachine vm;
+
+	// runs programs when the engine is CLOSURES
+	ClosureEngine closures;
+
+	// runs programs when the engine is ITERATIVE
+	IterativeEvaluator iterative;
+
+	// the engine named by PLOTSCRIPT_ENGINE
+	static Engine default_engine();
 };
 #endif
\ No newline at end of file
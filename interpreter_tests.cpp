@@ -634,4 +634,66 @@ TEST_CASE("testing gui stuff", "[interpreter]") {
 	ok = interp.parseStream(iss2);
 	REQUIRE(ok == true);
 	exp = interp.evaluate();
-}
\ No newline at end of file
+}
+TEST_CASE("Test Interpreter reuses parsed programs", "[interpreter]") {
+	Interpreter interp;
+	std::string program = "(begin (define r 10) (* pi (* r r)))";
+
+	for (int i = 0; i < 3; ++i) {
+		std::istringstream iss(program);
+		REQUIRE(interp.parseStream(iss));
+	}
+	REQUIRE(interp.parseCache().misses() == 1);
+	REQUIRE(interp.parseCache().hits() == 2);
+
+	// failures are not cached
+	std::istringstream bad("(+ 1");
+	REQUIRE(!interp.parseStream(bad));
+	REQUIRE(interp.parseCache().entries() == 1);
+
+	interp.setParseCacheCapacity(0);
+	std::istringstream iss(program);
+	REQUIRE(interp.parseStream(iss));
+	REQUIRE(interp.parseCache().entries() == 0);
+	REQUIRE(interp.evaluate() == Expression(std::atan2(0, -1) * 100));
+}
+
+TEST_CASE("Test builtins move their results", "[interpreter]") {
+
+  std::istringstream iss("(begin (define f (lambda (x) (* 2 x))) (map f (range 0 999 1)))");
+  Interpreter interp;
+  REQUIRE(interp.parseStream(iss));
+
+  std::size_t before = Expression::copies();
+  Expression result = interp.evaluate();
+  std::size_t copies = Expression::copies() - before;
+
+  REQUIRE(result.getTail().size() == 1000);
+
+  // what is left is a lookup or two of the argument in each lambda call;
+  // the environment is not copied for the call, and no element of the
+  // range or of the mapped list is copied on its way to the result
+  INFO("copies: " << copies);
+  REQUIRE(copies <= 2 * 1000 + 100);
+}
+
+TEST_CASE("Test calls resolved at parse time follow later definitions", "[interpreter]") {
+
+  // + is the built-in procedure until a lambda is bound to it
+  Expression result = run("(begin (define f (lambda (x) (+ x 1))) (define a (f 1)) (define + (lambda (x y) (* x y))) (list a (f 3)))");
+  REQUIRE(result == run("(list 2 3)"));
+
+  // or only while a lambda taking it as a parameter runs
+  result = run("(begin (define f (lambda (x) (+ x 1))) (define g (lambda (+) (f 5))) (list (f 5) (g (lambda (x y) (- x y))) (f 5)))");
+  REQUIRE(result == run("(list 6 4 6)"));
+
+  // the same for the forms a lambda may take the place of
+  result = run("(begin (define set-property (lambda (k v e) v)) (set-property \"note\" 1 2))");
+  REQUIRE(result == Expression(1));
+
+  // and a name bound to something else no longer names a procedure
+  std::istringstream iss("(begin (define sqrt 4) (sqrt 4))");
+  Interpreter interp;
+  REQUIRE(interp.parseStream(iss));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+}
@@ -0,0 +1,443 @@
+#include "iterative_evaluator.hpp"
+
+#include "memo_cache.hpp"
+#include "packed_list.hpp"
+#include "semantic_error.hpp"
+
+namespace {
+
+// whether a lambda is bound to the name of a call, see Expression::eval_unresolved
+bool names_lambda(const Atom & head, const Environment & env) {
+	return env.is_exp(head) && env.get_exp(head).head().asSymbolId() == SYM_LAMBDA;
+}
+
+// the value of an expression with an empty tail, see Expression::handle_lookup
+Expression lookup(const Atom & head, const Environment & env) {
+	if (head.isString() || head.isNumber() || head.isComplex()) {
+		return Expression(head);
+	}
+	if (head.isSymbol()) {
+		if (env.is_exp(head)) {
+			return env.get_exp(head);
+		}
+		throw SemanticError("Error during evaluation: unknown symbol");
+	}
+	throw SemanticError("Error during evaluation: Invalid type in terminal expression");
+}
+
+}
+
+const std::size_t IterativeEvaluator::DEFAULT_MAX_DEPTH;
+
+IterativeEvaluator::IterativeEvaluator(const IterativeEvaluator & other) :
+	m_max_depth(other.m_max_depth) {}
+
+IterativeEvaluator & IterativeEvaluator::operator=(const IterativeEvaluator & other) {
+	m_max_depth = other.m_max_depth;
+	return *this;
+}
+
+Expression IterativeEvaluator::evaluate(const Expression & exp, Environment & env) {
+	return run(exp, env, false);
+}
+
+void IterativeEvaluator::setMaxDepth(std::size_t depth) noexcept {
+	m_max_depth = depth;
+}
+
+std::size_t IterativeEvaluator::maxDepth() const noexcept {
+	return m_max_depth;
+}
+
+Expression IterativeEvaluator::run(const Expression & exp, Environment & env, bool call) {
+	// continuous-plot samples its function from inside a frame, so a run may
+	// nest in another; it only uses the stacks above what is on them already
+	std::size_t depth = m_frames.size();
+	std::size_t values = m_values.size();
+	std::size_t envs = m_envs.size();
+	std::size_t memos = m_memos.size();
+
+	try {
+		if (call) {
+			push(exp, env, LAMBDA_ARGUMENTS, 0, exp.tailView().size());
+		}
+		else {
+			start(exp, env);
+		}
+		execute(depth);
+	}
+	catch (...) {
+		m_frames.resize(depth);
+		m_values.resize(values);
+		m_envs.resize(envs);
+		m_memos.resize(memos);
+		throw;
+	}
+
+	Expression result = std::move(m_values.back());
+	m_values.pop_back();
+	return result;
+}
+
+void IterativeEvaluator::execute(std::size_t depth) {
+	while (m_frames.size() > depth) {
+		Frame & frame = m_frames.back();
+		if (frame.next == frame.end) {
+			finish();
+			continue;
+		}
+
+		// begin only keeps the value of its last form
+		if (frame.action == BEGIN && m_values.size() > frame.base) {
+			m_values.pop_back();
+		}
+		const Expression & next = frame.exp->tailView()[frame.next++];
+		start(next, *frame.env);
+	}
+}
+
+void IterativeEvaluator::start(const Expression & exp, Environment & env) {
+	const Atom & head = exp.head();
+	Expression::TailView tail = exp.tailView();
+	SymbolId form = head.asSymbolId();
+
+	// what exp is, as Expression::eval_node decides it
+	Expression::Kind kind = exp.kind();
+	switch (kind) {
+	case Expression::SET_PROPERTY_FORM:
+	case Expression::GET_PROPERTY_FORM:
+	case Expression::CONTINUOUS_PLOT_FORM:
+	case Expression::BUILTIN_CALL:
+	case Expression::FOLDED_CALL:
+		if (!env.shadows_builtins()) {
+			break;
+		}
+		// a lambda may be bound to the name
+		// fall through
+	case Expression::UNRESOLVED:
+		if (tail.empty()) {
+			if (form == SYM_LIST && !head.isString()) {
+				push(exp, env, PROCEDURE, 0, 0);
+			}
+			else {
+				m_values.push_back(lookup(head, env));
+			}
+			return;
+		}
+		switch (form) {
+		case SYM_BEGIN:
+			kind = Expression::BEGIN_FORM;
+			break;
+		case SYM_DEFINE:
+			kind = Expression::DEFINE_FORM;
+			break;
+		case SYM_APPLY:
+		case SYM_MAP:
+			kind = Expression::APPLY_MAP_FORM;
+			break;
+		case SYM_LAMBDA:
+			kind = Expression::LAMBDA_FORM;
+			break;
+		default:
+			if (names_lambda(head, env)) {
+				push(exp, env, LAMBDA_ARGUMENTS, 0, tail.size());
+				return;
+			}
+			if (form == SYM_SET_PROPERTY) {
+				kind = Expression::SET_PROPERTY_FORM;
+			}
+			else if (form == SYM_GET_PROPERTY) {
+				kind = Expression::GET_PROPERTY_FORM;
+			}
+			else if (form == SYM_CONTINUOUS_PLOT) {
+				kind = Expression::CONTINUOUS_PLOT_FORM;
+			}
+			else {
+				push(exp, env, PROCEDURE, 0, tail.size());
+				return;
+			}
+			break;
+		}
+		break;
+	default:
+		break;
+	}
+
+	switch (kind) {
+	case Expression::CONSTANT:
+		m_values.push_back(Expression(head));
+		return;
+	case Expression::LOOKUP: {
+		Procedure proc = nullptr;
+		const Expression * value = env.find(form, proc);
+		if (value == nullptr) {
+			throw SemanticError("Error during evaluation: unknown symbol");
+		}
+		m_values.push_back(*value);
+		return;
+	}
+	case Expression::BEGIN_FORM:
+		if (tail.empty()) {
+			throw SemanticError("Error during evaluation: zero arguments to begin");
+		}
+		push(exp, env, BEGIN, 0, tail.size());
+		return;
+	case Expression::DEFINE_FORM: {
+		// the checks Expression::handle_define makes before evaluating the value
+		if (tail.size() != 2) {
+			throw SemanticError("Error during evaluation: invalid number of arguments to define");
+		}
+		if (!tail[0].isHeadSymbol()) {
+			throw SemanticError("Error during evaluation: first argument to define not symbol");
+		}
+		SymbolId name = tail[0].head().asSymbolId();
+		if (name == SYM_DEFINE || name == SYM_BEGIN || name == SYM_LAMBDA) {
+			throw SemanticError("Error during evaluation: attempt to redefine a special-form");
+		}
+		if (env.is_proc(head)) {
+			throw SemanticError("Error during evaluation: attempt to redefine a built-in procedure");
+		}
+		push(exp, env, DEFINE, 1, 2);
+		return;
+	}
+	case Expression::APPLY_MAP_FORM: {
+		bool map = (form == SYM_MAP);
+		if (tail.size() != 2) {
+			throw SemanticError(map ? "Error: map takes two arguments" : "Error: apply takes two arguments");
+		}
+		const Expression & op = tail[0];
+		if (!op.isHeadSymbol() || !(names_lambda(op.head(), env) || env.is_proc(op.head())) || !op.isTailEmpty()) {
+			throw SemanticError(map ? "Error: first argument to map not a procedure." : "Error: first argument to apply not a procedure.");
+		}
+		push(exp, env, APPLY_MAP, 1, 2);
+		return;
+	}
+	case Expression::LAMBDA_FORM:
+		m_values.push_back(exp.handle_lambda());
+		return;
+	case Expression::SET_PROPERTY_FORM:
+		if (tail.size() != 3) {
+			throw SemanticError("Error in call to set-property: invalid number of arguments.");
+		}
+		if (!tail[0].head().isString()) {
+			throw SemanticError("Error in call to set-property: first argument must be a string.");
+		}
+		push(exp, env, SET_PROPERTY, 1, 3);
+		return;
+	case Expression::GET_PROPERTY_FORM:
+		if (tail.size() != 2) {
+			throw SemanticError("Error in call to get-property: invalid number of arguments.");
+		}
+		if (!tail[0].head().isString()) {
+			throw SemanticError("Error in call to get-property: first argument must be a string.");
+		}
+		push(exp, env, GET_PROPERTY, 1, 2);
+		return;
+	case Expression::CONTINUOUS_PLOT_FORM:
+		if (tail.size() != 2 && tail.size() != 3) {
+			throw SemanticError("Error in call to continuous-plot: incorrect number of arguments.");
+		}
+		push(exp, env, CONTINUOUS_PLOT, 0, tail.size());
+		return;
+	case Expression::BUILTIN_CALL:
+		push(exp, env, BUILTIN, 0, tail.size());
+		return;
+	case Expression::FOLDED_CALL:
+		m_values.push_back(*exp.folded());
+		return;
+	default: {
+		// one lookup tells a lambda call from a call that fails in apply
+		Procedure proc = nullptr;
+		bool lambda = is_lambda(env.find(form, proc));
+		push(exp, env, lambda ? LAMBDA_ARGUMENTS : PROCEDURE, 0, tail.size());
+		return;
+	}
+	}
+}
+
+void IterativeEvaluator::push(const Expression & exp, Environment & env, Action action, std::size_t first, std::size_t end) {
+	if (m_frames.size() >= m_max_depth) {
+		throw SemanticError("Error during evaluation: maximum evaluation depth exceeded");
+	}
+
+	m_frames.emplace_back();
+	Frame & frame = m_frames.back();
+	frame.exp = &exp;
+	frame.env = &env;
+	frame.action = action;
+	frame.next = first;
+	frame.end = end;
+	frame.base = m_values.size();
+}
+
+void IterativeEvaluator::take_arguments(std::size_t base) {
+	m_args.clear();
+	for (std::size_t i = base; i < m_values.size(); ++i) {
+		m_args.push_back(std::move(m_values[i]));
+	}
+	m_values.resize(base);
+}
+
+void IterativeEvaluator::finish() {
+	Frame & frame = m_frames.back();
+	Environment & env = *frame.env;
+	const Expression & exp = *frame.exp;
+
+	switch (frame.action) {
+	case BEGIN:
+		// the value of the last form is already in place
+		break;
+	case DEFINE: {
+		const Expression & result = m_values.back();
+		if (env.is_exp(exp.head())) {
+			throw SemanticError("Error during evaluation: attempt to redefine a previously defined symbol");
+		}
+		env.add_exp(exp.tailView()[0].head(), result);
+		break;
+	}
+	case APPLY_MAP: {
+		Expression list = std::move(m_values.back());
+		m_values.pop_back();
+		bool map = (exp.head().asSymbolId() == SYM_MAP);
+		if (!list.isList()) {
+			throw SemanticError(map ? "Error: second argument to map not a list." : "Error: second argument to apply not a list.");
+		}
+
+		// the procedure is called on the elements like apply_or_map does,
+		// each call evaluating them again
+		frame.mapping.reset(new Mapping{ exp.tailView()[0].head(), map, std::move(list).getTail(), 0, Expression() });
+		frame.action = MAPPING;
+		next_call();
+		return;
+	}
+	case MAPPING:
+		next_call();
+		return;
+	case SET_PROPERTY: {
+		Expression result = std::move(m_values.back());
+		m_values.pop_back();
+		result.add_pair(exp.tailView()[0], m_values.back());
+		if (env.is_exp(result.head().asSymbol())) {
+			env.add_exp(result.head().asSymbol(), result);
+		}
+		m_values.back() = std::move(result);
+		break;
+	}
+	case GET_PROPERTY: {
+		// the properties of a symbol's value rather than of its evaluation
+		const Expression & key = exp.tailView()[0];
+		const Expression & value = exp.tailView()[1];
+		if (value.isHeadSymbol() && value.isTailEmpty() && env.is_exp(value.head().asSymbol())) {
+			m_values.back() = env.get_exp(value.head().asSymbol()).get_value(key);
+		}
+		else {
+			m_values.back() = m_values.back().get_value(key);
+		}
+		break;
+	}
+	case CONTINUOUS_PLOT: {
+		// sampling runs on the stacks above this frame, which may move them
+		std::vector<Expression> args(std::make_move_iterator(m_values.begin() + frame.base), std::make_move_iterator(m_values.end()));
+		m_values.resize(frame.base);
+		m_frames.pop_back();
+		m_values.push_back(continuous_plot(args, env, [this](const Expression & call, Environment & env) {
+			return run(call, env, true);
+		}));
+		return;
+	}
+	case BUILTIN:
+		take_arguments(frame.base);
+		// the arguments may have rebound the name
+		if (env.shadows_builtins()) {
+			m_values.push_back(apply(exp.head(), m_args, env));
+		}
+		else {
+			m_values.push_back(Environment::builtin(exp.head().asSymbolId())(m_args));
+		}
+		break;
+	case PROCEDURE:
+		take_arguments(frame.base);
+		m_values.push_back(apply(exp.head(), m_args, env));
+		break;
+	case LAMBDA_ARGUMENTS: {
+		// the arguments may have rebound the name
+		Procedure proc = nullptr;
+		const Expression * value = env.find(exp.head().asSymbolId(), proc);
+		if (!is_lambda(value)) {
+			throw SemanticError("Error during evaluation: symbol does not name a procedure");
+		}
+		Expression::TailView parameters = value->tailView()[0].tailView();
+		if (parameters.size() != m_values.size() - frame.base) {
+			throw SemanticError("Error: incorrect number of arguments to lambda");
+		}
+
+		// a memoized lambda may have the result already, then no environment is set up
+		MemoCache * memo = value->memo();
+		std::string key;
+		bool memoized = false;
+		if (memo != nullptr && MemoCache::key(Expression::TailView(m_values.data() + frame.base, parameters.size()), key)) {
+			Expression cached;
+			if (memo->find(key, cached)) {
+				m_values.resize(frame.base);
+				m_values.push_back(std::move(cached));
+				break;
+			}
+			m_memos.emplace_back(memo, std::move(key));
+			memoized = true;
+		}
+
+		// the lambda runs in a frame in front of the environment, as in the
+		// tree walker; the lambda stays bound in env, which the call does not change
+		m_envs.emplace_back(env, parameters.size());
+		Environment & lambda_env = m_envs.back();
+		for (std::size_t i = 0; i < parameters.size(); ++i) {
+			lambda_env.bind(parameters[i].head(), std::move(m_values[frame.base + i]));
+		}
+		m_values.resize(frame.base);
+
+		frame.action = memoized ? MEMOIZED_BODY : LAMBDA_BODY;
+		start(value->tailView()[1], lambda_env);
+		return;
+	}
+	case LAMBDA_BODY:
+		m_envs.pop_back();
+		break;
+	case MEMOIZED_BODY:
+		m_memos.back().first->insert(std::move(m_memos.back().second), m_values.back());
+		m_memos.pop_back();
+		m_envs.pop_back();
+		break;
+	}
+
+	m_frames.pop_back();
+}
+
+void IterativeEvaluator::next_call() {
+	Frame & frame = m_frames.back();
+	Mapping & mapping = *frame.mapping;
+
+	if (!mapping.map) {
+		if (mapping.next == 0) {
+			mapping.next = 1;
+			mapping.call = Expression(mapping.op, std::move(mapping.elements));
+			start(mapping.call, *frame.env);
+			return;
+		}
+		// the result of the call is in place
+		m_frames.pop_back();
+		return;
+	}
+
+	if (mapping.next < mapping.elements.size()) {
+		std::vector<Expression> arg;
+		arg.push_back(std::move(mapping.elements[mapping.next++]));
+		mapping.call = Expression(mapping.op, std::move(arg));
+		start(mapping.call, *frame.env);
+		return;
+	}
+
+	std::vector<Expression> results(std::make_move_iterator(m_values.begin() + frame.base), std::make_move_iterator(m_values.end()));
+	m_values.resize(frame.base);
+	m_frames.pop_back();
+	m_values.push_back(make_list(std::move(results)));
+}
@@ -0,0 +1,136 @@
+/*! \file iterative_evaluator.hpp
+Defines an evaluator walking the AST with an explicit stack instead of recursion.
+ */
+#ifndef ITERATIVE_EVALUATOR_HPP
+#define ITERATIVE_EVALUATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class IterativeEvaluator
+\brief Evaluates expressions the way Expression::eval does, without recursion.
+
+The forms waiting on the value of a subexpression, lambda calls among
+them, are kept on a stack on the heap, so how deeply a program may nest
+does not depend on the size of the thread's stack. Instead the depth of
+that stack is capped, and a program going deeper fails with a
+SemanticError. Results and errors are otherwise those of the tree walker:
+each lambda call runs in a frame in front of the environment it was made in.
+ */
+class IterativeEvaluator {
+public:
+
+	/// the default cap on the depth of the stack
+	static const std::size_t DEFAULT_MAX_DEPTH = 1000000;
+
+	/// Construct an evaluator with empty stacks
+	IterativeEvaluator() = default;
+
+	/// Copy-construct an evaluator, with the same cap and empty stacks
+	IterativeEvaluator(const IterativeEvaluator & other);
+
+	/// Assign the cap of another evaluator
+	IterativeEvaluator & operator=(const IterativeEvaluator & other);
+
+	/*! Evaluate an expression
+	  \param exp the expression
+	  \param env the environment to evaluate it in, changed by its definitions
+	  \return the result of the evaluation
+	  \throws SemanticError when a semantic error is encountered, or the
+	  evaluation nests deeper than the cap
+	 */
+	Expression evaluate(const Expression & exp, Environment & env);
+
+	/// Set the most forms and lambda calls the evaluation may have waiting at once
+	void setMaxDepth(std::size_t depth) noexcept;
+
+	/// the most forms and lambda calls the evaluation may have waiting at once
+	std::size_t maxDepth() const noexcept;
+
+private:
+
+	// what a frame does with the values of its subexpressions
+	enum Action : std::uint8_t {
+		BEGIN,
+		DEFINE,
+		APPLY_MAP,
+		MAPPING,
+		SET_PROPERTY,
+		GET_PROPERTY,
+		CONTINUOUS_PLOT,
+		BUILTIN,
+		PROCEDURE,
+		LAMBDA_ARGUMENTS,
+		LAMBDA_BODY,
+		MEMOIZED_BODY,
+	};
+
+	// an apply or map form part way through calling its procedure
+	struct Mapping {
+		Atom op;
+		bool map;
+		std::vector<Expression> elements;
+		std::size_t next;
+		// the call being evaluated
+		Expression call;
+	};
+
+	// a form waiting on the values of its subexpressions
+	struct Frame {
+		const Expression * exp;
+		Environment * env;
+		Action action;
+		// the next subexpression to evaluate, and one past the last
+		std::size_t next;
+		std::size_t end;
+		// where the values of the subexpressions start on the value stack
+		std::size_t base;
+		std::unique_ptr<Mapping> mapping;
+	};
+
+	std::size_t m_max_depth = DEFAULT_MAX_DEPTH;
+
+	std::vector<Frame> m_frames;
+	std::vector<Expression> m_values;
+
+	// the environments of running lambda calls, innermost last
+	std::deque<Environment> m_envs;
+
+	// the caches and keys of running memoized lambda calls, innermost last
+	std::vector<std::pair<MemoCache *, std::string>> m_memos;
+
+	// the arguments of a procedure call, reused between calls
+	std::vector<Expression> m_args;
+
+	// evaluate exp, or if call the call of the lambda its head names, nesting
+	// on the stacks above what is already on them
+	Expression run(const Expression & exp, Environment & env, bool call);
+
+	// evaluate until the frame count drops to depth
+	void execute(std::size_t depth);
+
+	// start evaluating exp: push its value, or a frame to work it out
+	void start(const Expression & exp, Environment & env);
+
+	// push a frame evaluating the subexpressions of exp from first to end
+	void push(const Expression & exp, Environment & env, Action action, std::size_t first, std::size_t end);
+
+	// the top frame has the values of all its subexpressions
+	void finish();
+
+	// start the next call of the top frame's mapping, or finish it
+	void next_call();
+
+	// move the values from base on into m_args
+	void take_arguments(std::size_t base);
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "interpreter.hpp"
+#include "iterative_evaluator.hpp"
+#include "semantic_error.hpp"
+
+// the result of a program, or its error message, evaluated with the given engine
+static std::string run_with(Interpreter::Engine engine, const std::string & program) {
+  std::istringstream iss(program);
+  Interpreter interp;
+  interp.setEngine(engine);
+  REQUIRE(interp.parseStream(iss));
+
+  std::ostringstream out;
+  try {
+    out << interp.evaluate();
+  }
+  catch (const SemanticError & ex) {
+    out << "error: " << ex.what();
+  }
+  return out.str();
+}
+
+// a program adding depth ones to x, nested as deeply; x keeps the
+// sums from being folded while parsing
+static std::string nested_sum(std::size_t depth) {
+  std::string program;
+  for (std::size_t i = 0; i < depth; ++i) {
+    program += "(+ 1 ";
+  }
+  program += "x";
+  program += std::string(depth, ')');
+  return program;
+}
+
+TEST_CASE( "Test the iterative evaluator agrees with the tree walker", "[iterative_evaluator]" ) {
+
+  std::vector<std::string> programs = {
+    // atoms, procedures and special forms
+    "(1)", "(\"text\")", "(pi)", "(I)", "(+ 1 2 3)", "(list)", "(- 4)",
+    "(begin (define r 10) (* pi (* r r)))",
+    "(define + 2)", "(begin (define sqrt 2) (sqrt 4))",
+    "(lambda (x y) (+ x y))",
+    // lambda calls, nested and with dynamic scope
+    "(begin (define f (lambda (x) (* x x))) (f 3))",
+    "(begin (define f (lambda (x y) (+ x y))) (f 1))",
+    "(begin (define f (lambda (x) (+ x y))) (define g (lambda (y) (f 1))) (g 5))",
+    "(begin (define f (lambda (x) (begin (define y x) y))) (f 1) y)",
+    "(begin (define f (lambda (sqrt) (sqrt 4))) (f 1))",
+    "(begin (define f (lambda (x) (f x))) (define f (lambda (x) x)))",
+    // built-in names rebound, before, by and after a call
+    "(begin (define f (lambda (x) (+ x 1))) (define g (lambda (+) (f 1))) (list (f 1) (g (lambda (x y) (* x y))) (f 1)))",
+    "(+ (define + 2) 1)",
+    "(begin (define list (lambda (x) x)) (list))",
+    // apply and map
+    "(apply + (list 1 2 3))", "(apply + (list))", "(apply + 3)", "(apply 1 (list 1))",
+    "(begin (define f (lambda (x y) (+ x y))) (apply f (list 1 2)))",
+    "(map sqrt (list 1 4 9))", "(map + (list 1 I \"a\"))", "(map (+ 1) (list 1))", "(map + (list))",
+    "(begin (define f (lambda (x) (list x))) (map f (list (list 1 2) 3)))",
+    "(begin (define f (lambda (x) x)) (map f (begin (define f 2) (list 1))))",
+    "(begin (define map (lambda (x) x)) (map map (list 1)))",
+    // properties and plots
+    "(set-property \"note\" 1 (2))",
+    "(begin (define a 1) (set-property \"note\" 2 a) (get-property \"note\" a))",
+    "(begin (define a \"a\") (set-property \"note\" 2 a) (get-property \"note\" \"a\"))",
+    "(get-property \"note\" 1)", "(get-property note 1)", "(set-property 1 2)",
+    "(begin (define set-property (lambda (x y z) z)) (set-property 1 2 3))",
+    "(continuous-plot (lambda (x) (* 2 x)) (list 0 1))",
+    "(begin (define f (lambda (x) (g x))) (define g (lambda (x) (^ x 2))) (continuous-plot f (list -1 1)))",
+    "(continuous-plot (lambda (x) (undefined x)) (list 0 1))",
+    "(continuous-plot 1 2)",
+    // errors
+    "(undefined)", "(undefined 1)", "(1 2)", "(define 1 2)", "(define begin 1)", "(define a)",
+    "(lambda (x))", "(begin)",
+  };
+
+  for (auto & program : programs) {
+    INFO(program);
+    REQUIRE(run_with(Interpreter::ITERATIVE, program) == run_with(Interpreter::TREE_WALKER, program));
+  }
+}
+
+TEST_CASE( "Test the iterative evaluator is not limited by the thread's stack", "[iterative_evaluator]" ) {
+
+  // deeper than the tree walker can recurse on a default stack
+  const std::size_t depth = 200000;
+  std::istringstream iss("(begin (define x 0) " + nested_sum(depth) + ")");
+  Interpreter interp;
+  interp.setEngine(Interpreter::ITERATIVE);
+  REQUIRE(interp.parseStream(iss));
+  REQUIRE(interp.evaluate() == Expression(double(depth)));
+
+  // lambda calls nest on the same stack
+  std::istringstream calls("(begin (define f (lambda (x) (+ 1 x))) (f (f (f (f (f 0))))))");
+  REQUIRE(interp.parseStream(calls));
+  REQUIRE(interp.evaluate() == Expression(5));
+}
+
+TEST_CASE( "Test the iterative evaluator fails cleanly past its maximum depth", "[iterative_evaluator]" ) {
+
+  Environment env;
+  env.add_exp(Atom("x"), Expression(0));
+  IterativeEvaluator evaluator;
+  REQUIRE(evaluator.maxDepth() == IterativeEvaluator::DEFAULT_MAX_DEPTH);
+  evaluator.setMaxDepth(10);
+
+  std::istringstream shallow(nested_sum(10));
+  REQUIRE(evaluator.evaluate(parse(tokenize(shallow)), env) == Expression(10));
+
+  std::istringstream deep(nested_sum(11));
+  REQUIRE_THROWS_AS(evaluator.evaluate(parse(tokenize(deep)), env), SemanticError);
+
+  // a lambda call takes a level too
+  std::istringstream define("(define f (lambda (x) (+ 1 x)))");
+  evaluator.evaluate(parse(tokenize(define)), env);
+  std::istringstream calls("(f (f (f (f (f (f (f (f (f (f 0))))))))))");
+  REQUIRE_THROWS_AS(evaluator.evaluate(parse(tokenize(calls)), env), SemanticError);
+
+  // the evaluator is ready for the next evaluation after the error
+  std::istringstream again("(f (f 1))");
+  REQUIRE(evaluator.evaluate(parse(tokenize(again)), env) == Expression(3));
+
+  // the interpreter passes the cap on
+  std::istringstream iss("(begin (define x 0) " + nested_sum(100) + ")");
+  Interpreter interp;
+  interp.setEngine(Interpreter::ITERATIVE);
+  interp.setMaxDepth(50);
+  REQUIRE(interp.parseStream(iss));
+  REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+}
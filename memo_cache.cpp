@@ -0,0 +1,98 @@
+#include "memo_cache.hpp"
+
+#include <cstring>
+
+#include "property_table.hpp"
+
+const std::size_t MemoCache::DEFAULT_CAPACITY;
+
+MemoCache::MemoCache(std::size_t capacity) :
+	m_capacity(capacity > 0 ? capacity : 1) {}
+
+// append the bytes of a value to a key
+template<typename T>
+static void append(std::string & key, const T & value) {
+	char bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	key.append(bytes, sizeof(T));
+}
+
+bool MemoCache::key(Expression::TailView args, std::string & key) {
+	key.clear();
+	for (const Expression & arg : args) {
+		// a procedure may read the tail or properties of its argument
+		if (arg.isList() || !arg.isTailEmpty() || !arg.properties().empty()) {
+			return false;
+		}
+
+		const Atom & atom = arg.head();
+		if (atom.isNumber()) {
+			key.push_back('n');
+			append(key, atom.asNumber());
+		}
+		else if (atom.isComplex()) {
+			key.push_back('c');
+			append(key, atom.ComplexReal());
+			append(key, atom.ComplexImag());
+		}
+		else if (atom.isString()) {
+			key.push_back('s');
+			append(key, atom.asSymbolId());
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool MemoCache::find(const std::string & key, Expression & result) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto found = m_index.find(key);
+	if (found == m_index.end()) {
+		++m_misses;
+		return false;
+	}
+
+	m_entries.splice(m_entries.begin(), m_entries, found->second);
+	result = found->second->second;
+	++m_hits;
+	return true;
+}
+
+void MemoCache::insert(std::string key, Expression result) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// another call with the same arguments may have finished first
+	auto found = m_index.find(key);
+	if (found != m_index.end()) {
+		m_entries.splice(m_entries.begin(), m_entries, found->second);
+		return;
+	}
+
+	if (m_entries.size() == m_capacity) {
+		m_index.erase(m_entries.back().first);
+		m_entries.pop_back();
+	}
+	m_entries.emplace_front(std::move(key), std::move(result));
+	m_index.emplace(m_entries.front().first, m_entries.begin());
+}
+
+std::size_t MemoCache::capacity() const noexcept {
+	return m_capacity;
+}
+
+std::size_t MemoCache::size() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+std::size_t MemoCache::hits() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_hits;
+}
+
+std::size_t MemoCache::misses() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_misses;
+}
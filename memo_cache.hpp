@@ -0,0 +1,86 @@
+/*! \file memo_cache.hpp
+Defines the cache of results a memoized lambda keeps.
+ */
+#ifndef MEMO_CACHE_HPP
+#define MEMO_CACHE_HPP
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "expression.hpp"
+
+/*! \class MemoCache
+\brief The results of a lambda's calls, keyed by the values of their arguments.
+
+The lambda memoize returns keeps one of these, shared by every copy of it,
+and each engine looks a call up here before binding its arguments, so a
+cached call runs no environment setup at all. Only calls whose arguments
+are all numbers, complexes or strings without properties are cached. The
+key holds their exact bits and kinds, so 1 and the complex (1,0), or 0 and
+-0, are different keys. A call that fails is not cached and fails again.
+
+Once capacity results are kept, caching another drops the one least
+recently used. Calls from several threads may share a cache.
+ */
+class MemoCache {
+public:
+
+	/// the number of results kept when memoize is not given a capacity
+	static const std::size_t DEFAULT_CAPACITY = 1024;
+
+	/// construct an empty cache keeping at most capacity results, at least one
+	explicit MemoCache(std::size_t capacity = DEFAULT_CAPACITY);
+
+	MemoCache(const MemoCache &) = delete;
+	MemoCache & operator=(const MemoCache &) = delete;
+
+	/*! Make the key of a call
+	  \param args the values of the arguments
+	  \param key set to the key
+	  \return false if an argument cannot be part of a key, the call is
+	  then not cached
+	 */
+	static bool key(Expression::TailView args, std::string & key);
+
+	/*! Look up a call, counting a hit or a miss
+	  \param key the key of the call
+	  \param result set to the cached result if there is one
+	  \return true if the result was cached
+	 */
+	bool find(const std::string & key, Expression & result);
+
+	/// cache the result of a call, dropping the least recently used if full
+	void insert(std::string key, Expression result);
+
+	/// the most results kept
+	std::size_t capacity() const noexcept;
+
+	/// the number of results kept
+	std::size_t size() const;
+
+	/// the number of calls found in the cache
+	std::size_t hits() const;
+
+	/// the number of cacheable calls not found in the cache
+	std::size_t misses() const;
+
+private:
+	typedef std::list<std::pair<std::string, Expression> > Entries;
+
+	const std::size_t m_capacity;
+
+	mutable std::mutex m_mutex;
+
+	// most recently used first, and where each key is in that order
+	Entries m_entries;
+	std::unordered_map<std::string, Entries::iterator> m_index;
+
+	std::size_t m_hits = 0;
+	std::size_t m_misses = 0;
+};
+
+#endif
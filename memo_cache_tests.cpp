@@ -0,0 +1,117 @@
+#include "catch.hpp"
+
+#include <complex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "interpreter.hpp"
+#include "memo_cache.hpp"
+#include "semantic_error.hpp"
+
+// the result of a program, or its error message, with the engine the environment selects
+static std::string run(const std::string & program) {
+  std::istringstream iss(program);
+  Interpreter interp;
+  REQUIRE(interp.parseStream(iss));
+
+  std::ostringstream out;
+  try {
+    out << interp.evaluate();
+  }
+  catch (const SemanticError & ex) {
+    out << "error: " << ex.what();
+  }
+  return out.str();
+}
+
+// the key of a call, or "none" if it cannot be cached
+static std::string key_of(const std::vector<Expression> & args) {
+  std::string key;
+  return MemoCache::key(Expression::TailView(args.data(), args.size()), key) ? key : "none";
+}
+
+TEST_CASE( "Test the keys of memoized calls", "[memo_cache]" ) {
+
+  std::vector<Expression> one = { Expression(1.) };
+  std::vector<Expression> complex_one = { Expression(std::complex<double>(1, 0)) };
+  std::vector<Expression> zero = { Expression(0.) };
+  std::vector<Expression> negative_zero = { Expression(-0.) };
+  std::vector<Expression> text = { Expression(Atom("1", true)) };
+
+  REQUIRE(key_of(one) == key_of(one));
+  REQUIRE(key_of(one) != key_of(complex_one));
+  REQUIRE(key_of(zero) != key_of(negative_zero));
+  REQUIRE(key_of(one) != key_of(text));
+  REQUIRE(key_of({}) == "");
+  REQUIRE(key_of({ Expression(1.), Expression(2.) }) != key_of({ Expression(2.), Expression(1.) }));
+
+  // lists, lambdas and values with properties are not cached
+  Expression list{ Atom(SYM_ISLIST) };
+  list.setList();
+  REQUIRE(key_of({ list }) == "none");
+  REQUIRE(key_of({ Expression(Expression(Atom("x")), Expression(Atom("x"))) }) == "none");
+  Expression noted(1.);
+  noted.add_pair(Expression(Atom("note", true)), Expression(2.));
+  REQUIRE(key_of({ noted }) == "none");
+}
+
+TEST_CASE( "Test the memo cache drops the least recently used result", "[memo_cache]" ) {
+
+  MemoCache cache(2);
+  REQUIRE(cache.capacity() == 2);
+  REQUIRE(MemoCache(0).capacity() == 1);
+
+  Expression result;
+  REQUIRE_FALSE(cache.find("a", result));
+  cache.insert("a", Expression(1.));
+  cache.insert("b", Expression(2.));
+  REQUIRE(cache.find("a", result));
+  REQUIRE(result == Expression(1.));
+
+  // b is now the least recently used
+  cache.insert("c", Expression(3.));
+  REQUIRE(cache.size() == 2);
+  REQUIRE_FALSE(cache.find("b", result));
+  REQUIRE(cache.find("a", result));
+  REQUIRE(cache.find("c", result));
+  REQUIRE(result == Expression(3.));
+
+  // a result already cached is only touched
+  cache.insert("a", Expression(4.));
+  REQUIRE(cache.find("a", result));
+  REQUIRE(result == Expression(1.));
+
+  REQUIRE(cache.hits() == 4);
+  REQUIRE(cache.misses() == 2);
+}
+
+TEST_CASE( "Test memoized lambdas", "[memo_cache]" ) {
+
+  // hits, misses, results kept and capacity
+  REQUIRE(run("(begin (define f (memoize (lambda (x) (* x x)) 2)) (list (map f (list 1 2 1 3 1)) (memo-stats f)))")
+    == "(((1) (4) (1) (9) (1)) ((2) (3) (2) (2)))");
+
+  // copies share the cache, and it is kept across apply and lambda calls
+  REQUIRE(run("(begin (define f (memoize (lambda (x y) (+ x y)))) (define g f) (define h (lambda (x) (g x 1))) (g 1 1) (h 1) (apply f (list 1 1)) (memo-stats f))")
+    == "((2) (1) (1) (1024))");
+
+  // a complex key is not the real number of the same value
+  REQUIRE(run("(begin (define f (memoize (lambda (x) (sqrt x)))) (list (f 4) (f (+ 4 (- I I))) (f 4) (memo-stats f)))")
+    == "((2) (2,0) (2) ((1) (2) (2) (1024)))");
+
+  // calls on lists, and failing calls, are not cached
+  REQUIRE(run("(begin (define f (memoize (lambda (x) (first x)))) (f (list 1)) (memo-stats f))") == "((0) (0) (0) (1024))");
+  REQUIRE(run("(begin (define f (memoize (lambda (x) (first x)))) (f 1))") == "error: Error in call to first: argument not a list.");
+  REQUIRE(run("(begin (define f (memoize (lambda (x) x))) (f 1 2))") == "error: Error: incorrect number of arguments to lambda");
+
+  // plots sample through the cache, the second plot only hits
+  REQUIRE(run("(begin (define f (memoize (lambda (x) (* 2 x)))) (continuous-plot f (list 0 1)) (define s (memo-stats f)) (continuous-plot f (list 0 1)) (list s (memo-stats f)))")
+    == "(((51) (51) (51) (1024)) ((153) (51) (51) (1024)))");
+
+  REQUIRE(run("(memoize 1)") == "error: Error in call to memoize: first argument not a lambda.");
+  REQUIRE(run("(memoize (lambda (x) x) 0)") == "error: Error in call to memoize: capacity must be a positive integer.");
+  REQUIRE(run("(memoize (lambda (x) x) 1.5)") == "error: Error in call to memoize: capacity must be a positive integer.");
+  REQUIRE(run("(memoize (lambda (x) x) 1 2)") == "error: Error in call to memoize: invalid number of arguments.");
+  REQUIRE(run("(memo-stats (lambda (x) x))") == "error: Error in call to memo-stats: argument not a memoized lambda.");
+}
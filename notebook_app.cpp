@@ -114,12 +114,13 @@ void NotebookApp::evaluate_it(Expression exp, bool first) {
 		text_add(exp, first);
 	}
 	else if (exp.isList()) {
-		for (unsigned int i = 0; i < exp.getTail().size(); ++i) {
+		Expression::TailView items = exp.tailView();
+		for (unsigned int i = 0; i < items.size(); ++i) {
 			if (i == 0) {
-				evaluate_it(exp.getTail()[i], true);
+				evaluate_it(items[i], true);
 			}
 			else {
-				evaluate_it(exp.getTail()[i], false);
+				evaluate_it(items[i], false);
 			}
 		}
 	}
@@ -164,7 +165,7 @@ void NotebookApp::text_output(std::string str, bool clear) {
 	output->show_scene(msg, clear);
 }
 void NotebookApp::point_create(Expression exp, bool clear) {
-	std::vector<Expression> points = exp.getTail();
+	Expression::TailView points = exp.tailView();
 	if (points.size() != 2) {
 		output_command("Error: Wrong number of arguments for point creation",true);
 	}
@@ -200,7 +201,7 @@ void NotebookApp::point_create(Expression exp, bool clear) {
 }
 
 void NotebookApp::line_create(Expression exp, bool clear) {
-	std::vector<Expression> points = exp.getTail();
+	Expression::TailView points = exp.tailView();
 	Expression obj(Atom("object-name", true));
 	Expression point(Atom("point", true));
 	Expression thick(Atom("thickness", true));
@@ -227,7 +228,7 @@ void NotebookApp::line_create(Expression exp, bool clear) {
 			pen->setStyle(Qt::SolidLine);
 			pen->setWidth(t);
 			pen->setBrush(Qt::black);
-			QGraphicsLineItem *line1 = new QGraphicsLineItem(points[0].getTail()[0].head().asNumber(), points[0].getTail()[1].head().asNumber(), points[1].getTail()[0].head().asNumber(), points[1].getTail()[1].head().asNumber());
+			QGraphicsLineItem *line1 = new QGraphicsLineItem(points[0].tailView()[0].head().asNumber(), points[0].tailView()[1].head().asNumber(), points[1].tailView()[0].head().asNumber(), points[1].tailView()[1].head().asNumber());
 			line1->setPen(*pen);
 			output->show_scene(line1, clear);
 		}
@@ -254,8 +255,8 @@ void NotebookApp::text_add(Expression exp, bool clear) {
 		int text_rotation;
 		if (exp.is_value(posit)) {
 			Expression point = exp.get_value(posit);
-			if (point.get_value(obj) == Expression(pt) && point.getTail().size() == 2 && point.getTail()[0].isHeadNumber() && point.getTail()[1].isHeadNumber()) {
-				ptvalues = point.getTail();
+			if (point.get_value(obj) == Expression(pt) && point.tailView().size() == 2 && point.tailView()[0].isHeadNumber() && point.tailView()[1].isHeadNumber()) {
+				ptvalues.assign(point.tailView().begin(), point.tailView().end());
 			}
 			else {
 				error = true;
@@ -0,0 +1,87 @@
+#include "optimize.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// whether folding is on before set_constant_folding is called
+static bool default_folding() {
+	const char * setting = std::getenv("PLOTSCRIPT_FOLDING");
+	return setting == nullptr || std::strcmp(setting, "off") != 0;
+}
+
+// the folding switch, read from the environment the first time it is used
+static std::atomic<bool> & folding() {
+	static std::atomic<bool> enabled(default_folding());
+	return enabled;
+}
+
+void optimize(Expression & ast) {
+	if (constant_folding()) {
+		ast.fold_constants();
+	}
+}
+
+void set_constant_folding(bool enabled) noexcept {
+	folding().store(enabled);
+}
+
+bool constant_folding() noexcept {
+	return folding().load();
+}
+
+// the name dump_ast gives a kind
+static const char * kind_name(Expression::Kind kind) {
+	switch (kind) {
+	case Expression::CONSTANT:
+		return "constant";
+	case Expression::LOOKUP:
+		return "lookup";
+	case Expression::BEGIN_FORM:
+		return "begin";
+	case Expression::DEFINE_FORM:
+		return "define";
+	case Expression::APPLY_MAP_FORM:
+		return "apply-map";
+	case Expression::LAMBDA_FORM:
+		return "lambda";
+	case Expression::SET_PROPERTY_FORM:
+		return "set-property";
+	case Expression::GET_PROPERTY_FORM:
+		return "get-property";
+	case Expression::CONTINUOUS_PLOT_FORM:
+		return "continuous-plot";
+	case Expression::BUILTIN_CALL:
+		return "builtin";
+	case Expression::FOLDED_CALL:
+		return "folded";
+	case Expression::CALL:
+		return "call";
+	default:
+		return "unresolved";
+	}
+}
+
+void dump_ast(std::ostream & out, const Expression & ast) {
+	// pre-order with an explicit stack, programs may be nested deeply
+	std::vector<std::pair<const Expression *, std::size_t>> pending(1, std::make_pair(&ast, std::size_t(0)));
+	while (!pending.empty()) {
+		const Expression * exp = pending.back().first;
+		std::size_t depth = pending.back().second;
+		pending.pop_back();
+
+		out << std::string(2 * depth, ' ') << exp->head() << " [" << kind_name(exp->kind()) << "]";
+		if (exp->folded() != nullptr) {
+			out << " = " << *exp->folded();
+		}
+		out << "\n";
+
+		Expression::TailView tail = exp->tailView();
+		for (std::size_t i = tail.size(); i > 0; --i) {
+			pending.emplace_back(&tail[i - 1], depth + 1);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+/*! \file optimize.hpp
+Defines the optimizations run over parsed programs, and a way to look at
+the result.
+ */
+#ifndef OPTIMIZE_HPP
+#define OPTIMIZE_HPP
+
+#include <ostream>
+
+#include "expression.hpp"
+
+/*! \fn optimize
+\brief optimize a resolved program in place, if optimizations are enabled
+
+Folds calls of built-in procedures on constants, see
+Expression::fold_constants. A folded program evaluates to the same values,
+and fails with the same errors, as the program it was parsed from.
+parse and load_compiled call this for every program they return.
+
+\param ast the program, resolved
+ */
+void optimize(Expression & ast);
+
+/*! \fn set_constant_folding
+\brief enable or disable constant folding for programs parsed from now on
+
+Folding is enabled unless the environment variable PLOTSCRIPT_FOLDING is
+"off" when the first program is parsed.
+ */
+void set_constant_folding(bool enabled) noexcept;
+
+/// whether programs parsed from now on are folded
+bool constant_folding() noexcept;
+
+/*! \fn dump_ast
+\brief write a program as a tree, one expression per line
+
+Each line holds the head of an expression and its kind, with the value of a
+folded call after it, indented two spaces deeper than its parent.
+
+\param out the stream to write to
+\param ast the program
+ */
+void dump_ast(std::ostream & out, const Expression & ast);
+
+#endif
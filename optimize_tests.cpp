@@ -0,0 +1,129 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "interpreter.hpp"
+#include "optimize.hpp"
+#include "semantic_error.hpp"
+
+// a program parsed with folding set as given, leaving the switch as it was
+static Expression parse_with(bool folding, const std::string & program) {
+  bool was = constant_folding();
+  set_constant_folding(folding);
+  std::istringstream iss(program);
+  Expression ast = parse(tokenize(iss));
+  set_constant_folding(was);
+  return ast;
+}
+
+// the result of a program, or its error message, parsed with folding set as given
+static std::string run_with(bool folding, Interpreter::Engine engine, const std::string & program) {
+  bool was = constant_folding();
+  set_constant_folding(folding);
+  std::istringstream iss(program);
+  Interpreter interp;
+  interp.setEngine(engine);
+  bool parsed = interp.parseStream(iss);
+  set_constant_folding(was);
+  REQUIRE(parsed);
+
+  std::ostringstream out;
+  try {
+    out << interp.evaluate();
+  }
+  catch (const SemanticError & ex) {
+    out << "error: " << ex.what();
+  }
+  return out.str();
+}
+
+TEST_CASE( "Test calls of built-in procedures on constants are folded", "[optimize]" ) {
+
+  Expression ast = parse_with(true, "(+ (* 2 pi) (/ 1 4) (sqrt 4))");
+  REQUIRE(ast.kind() == Expression::FOLDED_CALL);
+  REQUIRE(*ast.folded() == Expression(2 * std::atan2(0, -1) + 0.25 + 2));
+  REQUIRE(ast.tailView()[0].kind() == Expression::FOLDED_CALL);
+
+  // the program itself is unchanged
+  REQUIRE(ast == parse_with(false, "(+ (* 2 pi) (/ 1 4) (sqrt 4))"));
+  REQUIRE(parse_with(false, "(+ 1 2)").folded() == nullptr);
+
+  // complex arithmetic folds as it evaluates
+  REQUIRE(*parse_with(true, "(* I I)").folded() == Expression(std::complex<double>(-1, 0)));
+  REQUIRE(*parse_with(true, "(sqrt -4)").folded() == Expression(std::complex<double>(0, 2)));
+
+  // lists and strings
+  Expression list = parse_with(true, "(list 1 (first (list \"a\" e)) (range 0 3 1))");
+  REQUIRE(list.kind() == Expression::FOLDED_CALL);
+  REQUIRE(list.folded()->isList());
+
+  // inside forms that are not folded themselves
+  Expression lambda = parse_with(true, "(lambda (x) (* x (/ 1 3)))");
+  REQUIRE(lambda.folded() == nullptr);
+  REQUIRE(lambda.tailView()[1].folded() == nullptr);
+  REQUIRE(*lambda.tailView()[1].tailView()[1].folded() == Expression(1.0 / 3));
+}
+
+TEST_CASE( "Test calls that cannot be folded are left alone", "[optimize]" ) {
+
+  std::vector<std::string> programs = {
+    // a symbol the environment decides
+    "(+ x 1)", "(+ 1 (f 2))", "(list)",
+    // failing calls fail when evaluated
+    "(+ 1 \"a\")", "(first (list))", "(sqrt 1 2)", "(range 0 1 -1)",
+    // lists too long to keep with the program
+    "(range 0 1000 1)", "(join (range 0 200 1) (range 0 200 1))",
+    // plots and forms
+    "(discrete-plot (list (list 0 0)))", "(begin 1 2)", "(set-property \"a\" 1 2)",
+  };
+
+  for (auto & program : programs) {
+    INFO(program);
+    REQUIRE(parse_with(true, program).folded() == nullptr);
+  }
+}
+
+TEST_CASE( "Test folded programs evaluate as unfolded ones", "[optimize]" ) {
+
+  std::vector<std::string> programs = {
+    "(+ 1 2)", "(* 2 pi)", "(^ e (* I pi))", "(list 1 (+ 1 1) \"a\")", "(range 0 5 1)",
+    "(+ 1 \"a\")", "(first (list))", "(map sqrt (list 1 4))", "(apply + (list (+ 1 2) 4))",
+    // built-in names and constants rebound before, by and after a folded call
+    "(begin (define pi 3) (* 2 pi))",
+    "(begin (define f (lambda (e) (* 2 e))) (list (f 1) (* 2 e)))",
+    "(begin (define f (lambda (+) (+ 2 1))) (list (+ 2 1) (f -) (+ 2 1)))",
+    "(begin (define I 2) (* I I))",
+    "(+ (define + 2) (+ 1 1))",
+    "(begin (define a \"pi\") (define pi 1) (set-property \"b\" 1 a) (* 2 pi))",
+    "(begin (define f (lambda (x) (+ x (/ 1 4)))) (map f (range 0 3 1)))",
+    "(continuous-plot (lambda (x) (* x (sqrt 2))) (list 0 1))",
+  };
+
+  std::vector<Interpreter::Engine> engines = {
+    Interpreter::TREE_WALKER, Interpreter::BYTECODE, Interpreter::CLOSURES, Interpreter::ITERATIVE
+  };
+
+  for (auto & program : programs) {
+    for (auto engine : engines) {
+      INFO(program << " with engine " << engine);
+      REQUIRE(run_with(true, engine, program) == run_with(false, Interpreter::TREE_WALKER, program));
+    }
+  }
+}
+
+TEST_CASE( "Test dumping a program's tree", "[optimize]" ) {
+
+  std::ostringstream out;
+  dump_ast(out, parse_with(true, "(define a (+ 1 2 x))"));
+  REQUIRE(out.str() == "define [define]\n  a [lookup]\n  + [builtin]\n    1 [constant]\n    2 [constant]\n    x [lookup]\n");
+
+  std::ostringstream folded;
+  dump_ast(folded, parse_with(true, "(- (* 2 3))"));
+  REQUIRE(folded.str() == "- [folded] = (-6)\n  * [folded] = (6)\n    2 [constant]\n    3 [constant]\n");
+
+  std::ostringstream unfolded;
+  dump_ast(unfolded, parse_with(false, "(- (* 2 3))"));
+  REQUIRE(unfolded.str() == "- [builtin]\n  * [builtin]\n    2 [constant]\n    3 [constant]\n");
+}
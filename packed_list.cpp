@@ -0,0 +1,106 @@
+#include "packed_list.hpp"
+
+#include "property_table.hpp"
+
+PackedList::PackedList(std::vector<double> && values) : m_complex(false), m_reals(std::move(values)) {}
+
+PackedList::PackedList(std::vector<std::complex<double> > && values) : m_complex(true), m_complexes(std::move(values)) {}
+
+std::size_t PackedList::size() const noexcept {
+	return m_complex ? m_complexes.size() : m_reals.size();
+}
+
+bool PackedList::isComplex() const noexcept {
+	return m_complex;
+}
+
+const std::vector<double> & PackedList::reals() const noexcept {
+	return m_reals;
+}
+
+const std::vector<std::complex<double> > & PackedList::complexes() const noexcept {
+	return m_complexes;
+}
+
+Expression PackedList::element(std::size_t index) const {
+	return m_complex ? Expression(Atom(m_complexes[index])) : Expression(Atom(m_reals[index]));
+}
+
+std::vector<Expression> PackedList::elements() const {
+	std::vector<Expression> result;
+	result.reserve(size());
+	for (std::size_t i = 0; i < size(); ++i) {
+		result.push_back(element(i));
+	}
+	return result;
+}
+
+const Expression::Tail & PackedList::boxed() const {
+	std::call_once(m_boxed, [this] {
+		// the only change ever made to the list, before any reader sees the result
+		const_cast<PackedList *>(this)->Expression::Tail::operator=(elements());
+	});
+	return *this;
+}
+
+bool PackedList::packable(const Expression & exp) noexcept {
+	return (exp.isHeadNumber() || exp.isHeadComplex()) && !exp.isList()
+		&& exp.isTailEmpty() && exp.properties().empty();
+}
+
+// pack elements into list if they are all real or all complex numbers
+static bool pack(const std::vector<Expression> & elements, Expression & list) {
+	bool reals = !elements.empty();
+	bool complexes = !elements.empty();
+	for (auto & e : elements) {
+		if (!PackedList::packable(e)) {
+			return false;
+		}
+		reals = reals && e.isHeadNumber();
+		complexes = complexes && e.isHeadComplex();
+	}
+
+	if (reals) {
+		std::vector<double> values;
+		values.reserve(elements.size());
+		for (auto & e : elements) {
+			values.push_back(e.head().asNumber());
+		}
+		list = make_list(std::move(values));
+	}
+	else if (complexes) {
+		std::vector<std::complex<double> > values;
+		values.reserve(elements.size());
+		for (auto & e : elements) {
+			values.push_back(e.head().asComplex());
+		}
+		list = make_list(std::move(values));
+	}
+	return reals || complexes;
+}
+
+Expression make_list(const std::vector<Expression> & elements) {
+	Expression result{ Atom(SYM_ISLIST) };
+	if (!pack(elements, result)) {
+		result.setList();
+		result.setTail(elements);
+	}
+	return result;
+}
+
+Expression make_list(std::vector<Expression> && elements) {
+	Expression result{ Atom(SYM_ISLIST) };
+	if (!pack(elements, result)) {
+		result.setList();
+		result.setTail(std::move(elements));
+	}
+	return result;
+}
+
+Expression make_list(std::vector<double> && values) {
+	return Expression::fromPacked(std::make_shared<const PackedList>(std::move(values)));
+}
+
+Expression make_list(std::vector<std::complex<double> > && values) {
+	return Expression::fromPacked(std::make_shared<const PackedList>(std::move(values)));
+}
@@ -0,0 +1,105 @@
+/*! \file packed_list.hpp
+Defines the packed representation of lists holding only numbers.
+ */
+#ifndef PACKED_LIST_HPP
+#define PACKED_LIST_HPP
+
+#include <complex>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "expression.hpp"
+
+/*! \class PackedList
+\brief The elements of a list of only real, or only complex, numbers,
+stored as one contiguous array of values.
+
+A packed list is the tail of a list expression, so copies of the
+expression share it like any other tail. The builtins that build and take
+apart lists read the values directly. Code that walks the tail as
+expressions, through Expression::tailView and friends, gets boxed copies of
+the elements, made once on first use and kept until the list is freed.
+ */
+class PackedList : private Expression::Tail {
+public:
+
+	/// pack real values
+	explicit PackedList(std::vector<double> && values);
+
+	/// pack complex values
+	explicit PackedList(std::vector<std::complex<double> > && values);
+
+	PackedList(const PackedList &) = delete;
+	PackedList & operator=(const PackedList &) = delete;
+
+	/// the number of elements
+	std::size_t size() const noexcept;
+
+	/// whether the elements are complex rather than real
+	bool isComplex() const noexcept;
+
+	/// the values of a real list
+	const std::vector<double> & reals() const noexcept;
+
+	/// the values of a complex list
+	const std::vector<std::complex<double> > & complexes() const noexcept;
+
+	/// the element at index, boxed as a new expression
+	Expression element(std::size_t index) const;
+
+	/// the elements, each boxed as a new expression
+	std::vector<Expression> elements() const;
+
+	/// whether exp is a number that can be an element of a packed list
+	static bool packable(const Expression & exp) noexcept;
+
+private:
+	friend class Expression;
+
+	bool m_complex;
+	std::vector<double> m_reals;
+	std::vector<std::complex<double> > m_complexes;
+
+	// guards boxing, which readers on several threads may ask for at once
+	mutable std::once_flag m_boxed;
+
+	// the elements as expressions, boxing them on the first call
+	const Expression::Tail & boxed() const;
+};
+
+/*! \fn make_list
+\brief Make a list expression of the given elements, packed if they are
+all real or all complex numbers
+
+\param elements the elements
+\return the list
+ */
+Expression make_list(const std::vector<Expression> & elements);
+
+/*! \fn make_list
+\brief Make a list expression like make_list above, taking over the
+elements when they are not packed
+
+\param elements the elements
+\return the list
+ */
+Expression make_list(std::vector<Expression> && elements);
+
+/*! \fn make_list
+\brief Make a packed list of real numbers
+
+\param values the elements, at least one
+\return the list
+ */
+Expression make_list(std::vector<double> && values);
+
+/*! \fn make_list
+\brief Make a packed list of complex numbers
+
+\param values the elements, at least one
+\return the list
+ */
+Expression make_list(std::vector<std::complex<double> > && values);
+
+#endif
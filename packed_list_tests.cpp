@@ -0,0 +1,128 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "interpreter.hpp"
+#include "packed_list.hpp"
+#include "property_table.hpp"
+
+static Expression run_packed(const std::string & program) {
+  std::istringstream iss(program);
+  Interpreter interp;
+  REQUIRE(interp.parseStream(iss));
+  return interp.evaluate();
+}
+
+// the same list built element by element, never packed
+static Expression boxed_list(const std::vector<Expression> & elements) {
+  Expression list{ Atom("islist") };
+  list.setList();
+  for (auto & e : elements) {
+    list.append(e);
+  }
+  return list;
+}
+
+TEST_CASE( "Test lists of numbers are packed", "[packed_list]" ) {
+
+  Expression reals = make_list(std::vector<Expression>{ Expression(1), Expression(2), Expression(3) });
+  REQUIRE(reals.packed() != nullptr);
+  REQUIRE(!reals.packed()->isComplex());
+  REQUIRE(reals.packed()->size() == 3);
+  REQUIRE(reals.isList());
+  REQUIRE(!reals.isTailEmpty());
+
+  Expression complexes = make_list(std::vector<Expression>{ Expression(Atom(std::complex<double>(0, 1))) });
+  REQUIRE(complexes.packed() != nullptr);
+  REQUIRE(complexes.packed()->isComplex());
+
+  // anything but only reals or only complexes stays boxed
+  std::vector<std::vector<Expression> > unpackable = {
+    {},
+    { Expression(1), Expression(Atom(std::complex<double>(0, 1))) },
+    { Expression(1), Expression(Atom("a")) },
+    { Expression(1), reals },
+  };
+  for (auto & elements : unpackable) {
+    Expression list = make_list(std::vector<Expression>(elements));
+    REQUIRE(list.packed() == nullptr);
+    REQUIRE(list.isList());
+    REQUIRE(list == boxed_list(elements));
+  }
+
+  Expression point = Expression(1);
+  point.add_pair(Expression(Atom("size")), Expression(2));
+  REQUIRE(!PackedList::packable(point));
+}
+
+TEST_CASE( "Test packed lists read like boxed ones", "[packed_list]" ) {
+
+  std::vector<Expression> elements = { Expression(1), Expression(2), Expression(3) };
+  Expression packed = make_list(std::vector<Expression>(elements));
+  Expression boxed = boxed_list(elements);
+
+  REQUIRE(packed == boxed);
+  REQUIRE(boxed == packed);
+  REQUIRE(packed.tailView().size() == 3);
+  REQUIRE(packed.tailView()[1] == Expression(2));
+  REQUIRE(packed.getTail() == elements);
+
+  std::ostringstream packed_text, boxed_text;
+  packed_text << packed;
+  boxed_text << boxed;
+  REQUIRE(packed_text.str() == boxed_text.str());
+
+  // changing a copy unpacks it and leaves the original alone
+  Expression copy(packed);
+  copy.append(Expression(Atom("a")));
+  REQUIRE(copy.packed() == nullptr);
+  REQUIRE(copy.tailView().size() == 4);
+  REQUIRE(packed.packed() != nullptr);
+  REQUIRE(packed.packed()->size() == 3);
+
+  // boxing on several threads at once gives every reader the same elements
+  Expression shared = make_list(std::vector<double>(1000, 1.5));
+  std::vector<std::thread> readers;
+  std::vector<const Expression *> firsts(4);
+  for (std::size_t i = 0; i < firsts.size(); ++i) {
+    readers.emplace_back([&shared, &firsts, i] { firsts[i] = &*shared.tailConstBegin(); });
+  }
+  for (auto & reader : readers) {
+    reader.join();
+  }
+  for (auto first : firsts) {
+    REQUIRE(first == firsts[0]);
+  }
+  REQUIRE(shared.tailView()[999] == Expression(1.5));
+}
+
+TEST_CASE( "Test list builtins keep lists packed", "[packed_list]" ) {
+
+  std::vector<std::string> packed_programs = {
+    "(range 0 5 1)",
+    "(list 1 2 3)",
+    "(list I (* 2 I))",
+    "(rest (list 1 2 3))",
+    "(append (list 1 2) 3)",
+    "(join (list 1 2) (range 3 4 1))",
+    "(begin (define f (lambda (x) (* x x))) (map f (range 0 5 1)))",
+    "(map sqrt (list 4 9))",
+  };
+  for (auto & program : packed_programs) {
+    INFO(program);
+    REQUIRE(run_packed(program).packed() != nullptr);
+  }
+
+  REQUIRE(run_packed("(first (range 3 5 1))") == Expression(3));
+  REQUIRE(run_packed("(length (range 0 999999 1))") == Expression(1000000));
+  REQUIRE(run_packed("(apply + (range 1 4 1))") == Expression(10));
+  REQUIRE(run_packed("(rest (list 1))") == boxed_list({}));
+  REQUIRE(run_packed("(join (list 1) (list I))") == boxed_list({ Expression(1), Expression(Atom(std::complex<double>(0, 1))) }));
+
+  Expression appended = run_packed("(append (list 1 2) (list 3))");
+  REQUIRE(appended.packed() == nullptr);
+  REQUIRE(appended.tailView().size() == 3);
+}
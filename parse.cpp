@@ -1,7 +1,13 @@
 #include "parse.hpp"
 #include "parse.hpp"
 
+#include <atomic>
+#include <cctype>
 #include <stack>
+#include <system_error>
+#include <thread>
+
+#include "optimize.hpp"
 
 bool setHead(Expression &exp, const Token &token) {
 
@@ -33,6 +39,23 @@ bool append(Expression *exp, const Token &token) {
 	return !a.isNone();
 }
 
+// record that exp was parsed from the text between begin and end
+static void mark(Expression *exp, const SourceLocation &begin, const SourceLocation &end) {
+	SourceSpan span;
+	span.begin = begin;
+	span.end = end;
+	exp->setSpan(span);
+}
+
+// the location of the last character of a SYM token
+static SourceLocation token_end(const Token &token) {
+	SourceLocation end = token.location();
+	if (end.line != 0 && token.size() > 0) {
+		end.column += static_cast<std::uint32_t>(token.size() - 1);
+	}
+	return end;
+}
+
 Expression parse(const TokenSequenceType &tokens) noexcept {
 
 	Expression ast;
@@ -45,6 +68,8 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 	bool atstringhead = false;
 	bool stringhead = false;
 	bool inquote = false;
+	// where the innermost form opened
+	SourceLocation open_at;
 	// stack tracks the last node created
 	std::stack<Expression *> stack;
 
@@ -54,11 +79,13 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 
 		if (t.type() == Token::OPEN) {
 			athead = true;
+			open_at = t.location();
 		}
 		else if (t.type() == Token::CLOSE) {
 			if (stack.empty()) {
 				return Expression();
 			}
+			mark(stack.top(), stack.top()->span().begin, t.location());
 			stack.pop();
 
 			if (stack.empty()) {
@@ -91,6 +118,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 						return Expression();
 					}
 					stack.push(&ast);
+					mark(&ast, open_at, open_at);
 				}
 				else {
 					if (stack.empty()) {
@@ -101,6 +129,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 						return Expression();
 					}
 					stack.push(stack.top()->tail());
+					mark(stack.top(), open_at, open_at);
 				}
 				athead = false;
 			}
@@ -111,6 +140,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 						return Expression();
 					}
 					stack.push(&ast);
+					mark(&ast, t.location(), token_end(t));
 				}
 				else {
 					if (stack.empty()) {
@@ -121,6 +151,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 						return Expression();
 					}
 					stack.push(stack.top()->tail());
+					mark(stack.top(), t.location(), token_end(t));
 				}
 				atstringhead = false;
 			}
@@ -131,6 +162,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 						return Expression();
 					}
 					stack.push(&ast);
+					mark(&ast, open_at, open_at);
 				}
 				else {
 					if (stack.empty()) {
@@ -141,6 +173,7 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 						return Expression();
 					}
 					stack.push(stack.top()->tail());
+					mark(stack.top(), open_at, open_at);
 				}
 				athead = false;
 				atstringhead = false;
@@ -153,14 +186,237 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
 				if (!append(stack.top(), t)) {
 					return Expression();
 				}
+				mark(stack.top()->tail(), t.location(), token_end(t));
 			}
 		}
 		num_tokens_seen += 1;
 	}
 
 	if (stack.empty() && (num_tokens_seen == tokens.size())) {
+		ast.resolve();
+		optimize(ast);
 		return ast;
 	}
 
 	return Expression();
 };
+
+FormScanner::Status FormScanner::scan(const char *& pos, const char * end) noexcept {
+
+	for (; pos != end; ++pos) {
+		char c = *pos;
+
+		if (m_in_comment) {
+			m_in_comment = (c != '\n');
+		}
+		else if (c == ';') {
+			m_in_comment = true;
+		}
+		else if (c == '(') {
+			++m_depth;
+		}
+		else if (c == ')') {
+			if (m_depth == 0) {
+				return Malformed;
+			}
+			if (--m_depth == 0) {
+				++pos;
+				return FormEnd;
+			}
+		}
+		else if (m_depth == 0 && !isspace(static_cast<unsigned char>(c))) {
+			// a top-level form must be parenthesized
+			return Malformed;
+		}
+	}
+
+	return NeedMore;
+}
+
+bool FormScanner::inForm() const noexcept {
+	return m_depth != 0;
+}
+
+void StreamParser::feed(const char * data, std::size_t size) {
+
+	if (m_failed) return;
+
+	m_pending.append(data, size);
+
+	while (true) {
+		const char * begin = m_pending.data();
+		const char * pos = begin + m_scanned;
+		FormScanner::Status status = m_scanner.scan(pos, begin + m_pending.size());
+		m_scanned = pos - begin;
+
+		if (status == FormScanner::Malformed) {
+			m_failed = true;
+			return;
+		}
+		if (status == FormScanner::NeedMore) {
+			break;
+		}
+
+		std::shared_ptr<const SourceBuffer> form = std::make_shared<const SourceBuffer>(m_pending.substr(m_form, m_scanned - m_form));
+		TokenSequenceType tokens = tokenize(form, form->data(), form->end(), m_location);
+		Expression exp = parse(tokens);
+		if (exp == Expression()) {
+			m_failed = true;
+			return;
+		}
+		m_ready.push_back(exp);
+
+		// counted from the form just read, so a chunk holding many forms is
+		// not counted over again for each
+		m_location = advance_location(m_location, begin + m_form, begin + m_scanned);
+		m_form = m_scanned;
+	}
+
+	// drop text belonging to forms already parsed, or to white-space and
+	// comments between them
+	if (!m_scanner.inForm()) {
+		m_location = advance_location(m_location, m_pending.data() + m_form, m_pending.data() + m_scanned);
+		m_form = m_scanned;
+	}
+	if (m_form > 0) {
+		m_pending.erase(0, m_form);
+		m_scanned -= m_form;
+		m_form = 0;
+	}
+}
+
+void StreamParser::feed(const std::string & chunk) {
+	feed(chunk.data(), chunk.size());
+}
+
+void StreamParser::finish() {
+	if (m_scanner.inForm()) {
+		m_failed = true;
+	}
+}
+
+bool StreamParser::next(Expression & exp) {
+	if (m_ready.empty()) {
+		return false;
+	}
+	exp = m_ready.front();
+	m_ready.pop_front();
+	return true;
+}
+
+bool StreamParser::failed() const noexcept {
+	return m_failed;
+}
+
+bool parse_program(const std::shared_ptr<const SourceBuffer> & source, std::vector<Expression> & forms) noexcept {
+
+	FormScanner scanner;
+	const char * pos = source->data();
+	const char * form = pos;
+	SourceLocation location(1, 1);
+
+	while (true) {
+		FormScanner::Status status = scanner.scan(pos, source->end());
+
+		if (status == FormScanner::Malformed) {
+			return false;
+		}
+		if (status == FormScanner::NeedMore) {
+			break;
+		}
+
+		Expression exp = parse(tokenize(source, form, pos, location));
+		if (exp == Expression()) {
+			return false;
+		}
+		forms.push_back(exp);
+		location = advance_location(location, form, pos);
+		form = pos;
+	}
+
+	return !scanner.inForm() && !forms.empty();
+}
+
+bool parse_program(const std::shared_ptr<const SourceBuffer> & source, std::vector<Expression> & forms, unsigned threads) noexcept {
+
+	if (threads <= 1) {
+		return parse_program(source, forms);
+	}
+
+	// where each form is, found the same way the single-threaded parse does
+	struct Form {
+		const char * begin;
+		const char * end;
+		SourceLocation start;
+	};
+	std::vector<Form> bounds;
+
+	FormScanner scanner;
+	const char * pos = source->data();
+	Form form = { pos, pos, SourceLocation(1, 1) };
+
+	while (true) {
+		FormScanner::Status status = scanner.scan(pos, source->end());
+
+		if (status == FormScanner::Malformed) {
+			return false;
+		}
+		if (status == FormScanner::NeedMore) {
+			break;
+		}
+
+		form.end = pos;
+		bounds.push_back(form);
+		form.start = advance_location(form.start, form.begin, form.end);
+		form.begin = pos;
+	}
+
+	if (scanner.inForm() || bounds.empty()) {
+		return false;
+	}
+
+	std::vector<Expression> parsed(bounds.size());
+	std::atomic<bool> ok(true);
+
+	// tokenize and parse the forms [first, last)
+	auto work = [&](std::size_t first, std::size_t last) {
+		for (std::size_t i = first; i < last && ok; ++i) {
+			Expression exp = parse(tokenize(source, bounds[i].begin, bounds[i].end, bounds[i].start));
+			if (exp == Expression()) {
+				ok = false;
+				return;
+			}
+			parsed[i] = exp;
+		}
+	};
+
+	// hand each thread a run of forms holding about as much text as the others
+	std::size_t target = source->size() / threads + 1;
+	std::vector<std::thread> workers;
+	std::size_t first = 0;
+	try {
+		while (workers.size() + 1 < threads && first < bounds.size()) {
+			std::size_t last = first;
+			while (last < bounds.size() && bounds[last].begin - bounds[first].begin < static_cast<std::ptrdiff_t>(target)) {
+				++last;
+			}
+			workers.emplace_back(work, first, last);
+			first = last;
+		}
+	}
+	catch (const std::system_error &) {
+		// out of threads, whatever is left is done here
+	}
+
+	work(first, bounds.size());
+	for (auto & w : workers) {
+		w.join();
+	}
+
+	if (!ok) {
+		return false;
+	}
+
+	forms.insert(forms.end(), parsed.begin(), parsed.end());
+	return true;
+}
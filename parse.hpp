@@ -4,6 +4,11 @@ Defines the parse function.
 #ifndef PARSE_HPP
 #define PARSE_HPP
 
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "token.hpp"
 #include "expression.hpp"
 
@@ -15,4 +20,105 @@ Defines the parse function.
  */
 Expression parse(const TokenSequenceType & tokens) noexcept;
 
+/*! \class FormScanner
+\brief Finds where top-level forms end in program text, chunk by chunk.
+
+The scanner tracks parenthesis depth and comments the same way tokenize
+does, so a form it reports is exactly the text tokenize and parse would
+consume for it. State carries across calls, so text may arrive in pieces.
+*/
+class FormScanner {
+public:
+
+	/// result of a call to scan
+	enum Status {
+		NeedMore,  //< reached the end of the text inside or between forms
+		FormEnd,   //< a top-level form just closed
+		Malformed, //< text outside any form, or an unmatched ')'
+	};
+
+	/*! Scan forward from pos up to end
+	  \param pos where to start, advanced to where scanning stopped
+	  (one past the closing ')' on FormEnd)
+	  \param end one past the last available character
+	 */
+	Status scan(const char *& pos, const char * end) noexcept;
+
+	/// true if a form has been opened but not yet closed
+	bool inForm() const noexcept;
+
+private:
+	std::size_t m_depth = 0;
+	bool m_in_comment = false;
+};
+
+/*! \class StreamParser
+\brief Push-style parser that yields each top-level expression as it closes.
+
+Feed program text in chunks of any size; as soon as a top-level form is
+complete it is tokenized, parsed, and queued for next(). Only the text of
+the form currently being read is retained, so memory is bounded by the
+largest single form rather than the length of the input.
+ */
+class StreamParser {
+public:
+
+	/// feed the next size characters of program text
+	void feed(const char * data, std::size_t size);
+
+	/// feed the next chunk of program text
+	void feed(const std::string & chunk);
+
+	/// signal that no more text will be fed
+	void finish();
+
+	/*! Take the next complete expression
+	  \param exp set to the expression if one is ready
+	  \return true if an expression was ready
+	 */
+	bool next(Expression & exp);
+
+	/// true once malformed or truncated input has been seen
+	bool failed() const noexcept;
+
+private:
+	FormScanner m_scanner;
+
+	// text not yet handed to the parser; m_form is where the open form
+	// starts and m_scanned is how far the scanner has read
+	std::string m_pending;
+	std::size_t m_form = 0;
+	std::size_t m_scanned = 0;
+
+	// line and column of the character at m_form
+	SourceLocation m_location = SourceLocation(1, 1);
+
+	std::deque<Expression> m_ready;
+	bool m_failed = false;
+};
+
+/*! \fn parse_program
+\brief parse every top-level form in a buffer, in order
+
+\param source the program text
+\param forms receives one expression per top-level form
+\returns true if the buffer held one or more forms and all of them parsed
+ */
+bool parse_program(const std::shared_ptr<const SourceBuffer> & source, std::vector<Expression> & forms) noexcept;
+
+/*! \fn parse_program
+\brief parse every top-level form in a buffer, in order, using several threads
+
+\param source the program text
+\param forms receives one expression per top-level form
+\param threads the number of threads to tokenize and parse with
+\returns true if the buffer held one or more forms and all of them parsed
+
+The buffer is first split at top-level form boundaries on the calling
+thread, then contiguous runs of forms of about equal size are tokenized
+and parsed in parallel. The forms come out in program order, exactly as
+the single-threaded overload would produce them.
+ */
+bool parse_program(const std::shared_ptr<const SourceBuffer> & source, std::vector<Expression> & forms, unsigned threads) noexcept;
+
 #endif
@@ -0,0 +1,135 @@
+#include "parse_cache.hpp"
+
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+std::uint64_t hash_text(const char * text, std::size_t size) noexcept {
+	std::uint64_t hash = 14695981039346656037ULL;
+	for (std::size_t i = 0; i < size; ++i) {
+		hash ^= static_cast<unsigned char>(text[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// estimated memory held by an AST, walked without recursion as it may be deep
+static std::size_t footprint(const Expression & exp) {
+	std::size_t bytes = 0;
+	std::vector<const Expression *> pending(1, &exp);
+	while (!pending.empty()) {
+		const Expression * node = pending.back();
+		pending.pop_back();
+		bytes += sizeof(Expression);
+		for (auto & e : node->tailView()) {
+			pending.push_back(&e);
+		}
+	}
+	return bytes;
+}
+
+ParseCache::ParseCache(std::size_t capacity) : m_capacity(capacity) {}
+
+ParseCache::ParseCache(const ParseCache & other) :
+	m_entries(other.m_entries), m_capacity(other.m_capacity), m_bytes(other.m_bytes),
+	m_hits(other.m_hits), m_misses(other.m_misses) {
+	reindex();
+}
+
+ParseCache & ParseCache::operator=(const ParseCache & other) {
+	if (this != &other) {
+		m_entries = other.m_entries;
+		m_capacity = other.m_capacity;
+		m_bytes = other.m_bytes;
+		m_hits = other.m_hits;
+		m_misses = other.m_misses;
+		reindex();
+	}
+	return *this;
+}
+
+bool ParseCache::find(const char * text, std::size_t size, Expression & ast) {
+	std::uint64_t hash = hash_text(text, size);
+
+	auto range = m_index.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		const Entry & entry = *it->second;
+		if (entry.text.size() == size && std::memcmp(entry.text.data(), text, size) == 0) {
+			// move to the front as most recently used
+			m_entries.splice(m_entries.begin(), m_entries, it->second);
+			ast = entry.ast;
+			++m_hits;
+			return true;
+		}
+	}
+
+	++m_misses;
+	return false;
+}
+
+void ParseCache::insert(const char * text, std::size_t size, const Expression & ast) {
+	std::size_t bytes = sizeof(Entry) + size + footprint(ast);
+	if (bytes > m_capacity) {
+		return;
+	}
+
+	Entry entry = { hash_text(text, size), std::string(text, size), ast, bytes };
+	m_entries.push_front(entry);
+	m_index.emplace(entry.hash, m_entries.begin());
+	m_bytes += bytes;
+
+	evict();
+}
+
+void ParseCache::setCapacity(std::size_t capacity) {
+	m_capacity = capacity;
+	evict();
+}
+
+void ParseCache::clear() {
+	m_entries.clear();
+	m_index.clear();
+	m_bytes = 0;
+}
+
+std::size_t ParseCache::capacity() const noexcept {
+	return m_capacity;
+}
+
+std::size_t ParseCache::bytes() const noexcept {
+	return m_bytes;
+}
+
+std::size_t ParseCache::entries() const noexcept {
+	return m_entries.size();
+}
+
+std::size_t ParseCache::hits() const noexcept {
+	return m_hits;
+}
+
+std::size_t ParseCache::misses() const noexcept {
+	return m_misses;
+}
+
+void ParseCache::evict() {
+	while (m_bytes > m_capacity && !m_entries.empty()) {
+		auto last = std::prev(m_entries.end());
+		auto range = m_index.equal_range(last->hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second == last) {
+				m_index.erase(it);
+				break;
+			}
+		}
+		m_bytes -= last->bytes;
+		m_entries.erase(last);
+	}
+}
+
+void ParseCache::reindex() {
+	m_index.clear();
+	for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+		m_index.emplace(it->hash, it);
+	}
+}
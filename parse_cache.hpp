@@ -0,0 +1,108 @@
+/*! \file parse_cache.hpp
+Defines the ParseCache type used by the Interpreter to skip re-parsing.
+ */
+#ifndef PARSE_CACHE_HPP
+#define PARSE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "expression.hpp"
+
+/*! \fn hash_text
+\brief 64-bit FNV-1a hash of some text
+
+\param text the first character
+\param size the number of characters
+\return the hash value
+ */
+std::uint64_t hash_text(const char * text, std::size_t size) noexcept;
+
+/*! \class ParseCache
+\brief A least-recently-used cache from program text to its parsed AST.
+
+Entries are keyed by a hash of the text, and the text itself is kept to
+confirm a hit. The cache evicts least recently used entries to stay
+within a memory cap, estimated from the text and AST node counts.
+ */
+class ParseCache {
+public:
+
+	/// the memory cap used unless another is set, in bytes
+	static const std::size_t DEFAULT_CAPACITY = 16 * 1024 * 1024;
+
+	/// Construct an empty cache with the given memory cap in bytes
+	explicit ParseCache(std::size_t capacity = DEFAULT_CAPACITY);
+
+	/// Copy-construct a cache, entries and counters included
+	ParseCache(const ParseCache & other);
+
+	/// Assign a cache, entries and counters included
+	ParseCache & operator=(const ParseCache & other);
+
+	/*! Look up the AST for some program text, counting a hit or a miss
+	  \param text the first character of the program
+	  \param size the number of characters
+	  \param ast set to the cached AST on a hit
+	  \return true on a hit
+	 */
+	bool find(const char * text, std::size_t size, Expression & ast);
+
+	/*! Remember the AST parsed from some program text
+	  \param text the first character of the program
+	  \param size the number of characters
+	  \param ast the parsed expression
+	 */
+	void insert(const char * text, std::size_t size, const Expression & ast);
+
+	/// change the memory cap in bytes, evicting entries as needed
+	void setCapacity(std::size_t capacity);
+
+	/// remove every entry, keeping the counters
+	void clear();
+
+	/// memory cap in bytes
+	std::size_t capacity() const noexcept;
+
+	/// estimated memory held by the entries in bytes
+	std::size_t bytes() const noexcept;
+
+	/// number of cached programs
+	std::size_t entries() const noexcept;
+
+	/// number of lookups that found their program
+	std::size_t hits() const noexcept;
+
+	/// number of lookups that did not
+	std::size_t misses() const noexcept;
+
+private:
+	struct Entry {
+		std::uint64_t hash;
+		std::string text;
+		Expression ast;
+		std::size_t bytes;
+	};
+
+	// entries, most recently used first
+	std::list<Entry> m_entries;
+
+	// index from hash to entry, rebuilt on copy
+	std::unordered_multimap<std::uint64_t, std::list<Entry>::iterator> m_index;
+
+	std::size_t m_capacity;
+	std::size_t m_bytes = 0;
+	std::size_t m_hits = 0;
+	std::size_t m_misses = 0;
+
+	// drop least recently used entries until within capacity
+	void evict();
+
+	// rebuild m_index from m_entries
+	void reindex();
+};
+
+#endif
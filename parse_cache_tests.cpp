@@ -0,0 +1,62 @@
+#include "catch.hpp"
+
+#include "parse_cache.hpp"
+
+#include <string>
+
+TEST_CASE( "Test parse cache hits and misses", "[parse_cache]" ) {
+
+  ParseCache cache;
+  std::string program = "(+ 1 2)";
+  Expression ast;
+
+  REQUIRE(!cache.find(program.data(), program.size(), ast));
+  REQUIRE(cache.misses() == 1);
+
+  Expression parsed(Atom("+"));
+  parsed.append(Atom(1.0));
+  parsed.append(Atom(2.0));
+  cache.insert(program.data(), program.size(), parsed);
+  REQUIRE(cache.entries() == 1);
+  REQUIRE(cache.bytes() > 0);
+
+  REQUIRE(cache.find(program.data(), program.size(), ast));
+  REQUIRE(ast == parsed);
+  REQUIRE(cache.hits() == 1);
+
+  // same length, different text
+  std::string other = "(+ 1 3)";
+  REQUIRE(!cache.find(other.data(), other.size(), ast));
+
+  // copies keep a working index
+  ParseCache copy(cache);
+  REQUIRE(copy.find(program.data(), program.size(), ast));
+  REQUIRE(copy.hits() == 2);
+}
+
+TEST_CASE( "Test parse cache evicts least recently used", "[parse_cache]" ) {
+
+  std::string a = "(a)", b = "(b)", c = "(c)";
+  Expression ast(Atom("x"));
+
+  ParseCache probe;
+  probe.insert(a.data(), a.size(), ast);
+  std::size_t entry = probe.bytes();
+
+  ParseCache cache(2 * entry);
+  cache.insert(a.data(), a.size(), ast);
+  cache.insert(b.data(), b.size(), ast);
+
+  // touch a so b is the oldest
+  REQUIRE(cache.find(a.data(), a.size(), ast));
+  cache.insert(c.data(), c.size(), ast);
+
+  REQUIRE(cache.entries() == 2);
+  REQUIRE(cache.find(a.data(), a.size(), ast));
+  REQUIRE(!cache.find(b.data(), b.size(), ast));
+  REQUIRE(cache.find(c.data(), c.size(), ast));
+
+  cache.setCapacity(0);
+  REQUIRE(cache.entries() == 0);
+  REQUIRE(cache.bytes() == 0);
+}
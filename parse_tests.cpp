@@ -57,3 +57,147 @@ TEST_CASE( "Test empty parens", "[parse]" ) {
   REQUIRE(parse(tokens) == Expression());
 }
 
+TEST_CASE( "Test stream parser yields forms as they close", "[parse]" ) {
+
+  StreamParser parser;
+  Expression exp;
+
+  parser.feed("(define a 1");
+  REQUIRE(!parser.next(exp));
+
+  // a chunk boundary may split a token
+  parser.feed("0) ; comment (\n(+ a");
+  REQUIRE(parser.next(exp));
+  REQUIRE(exp.head() == Atom("define"));
+  REQUIRE(!parser.next(exp));
+
+  parser.feed(" 2)(list \"a b\")");
+  REQUIRE(parser.next(exp));
+  REQUIRE(exp.head() == Atom("+"));
+  REQUIRE(parser.next(exp));
+  REQUIRE(exp.head() == Atom("list"));
+
+  parser.finish();
+  REQUIRE(!parser.next(exp));
+  REQUIRE(!parser.failed());
+}
+
+TEST_CASE( "Test stream parser with bad input", "[parse]" ) {
+
+  {
+    StreamParser parser;
+    parser.feed("(+ 1 2))");
+    REQUIRE(parser.failed());
+  }
+
+  {
+    StreamParser parser;
+    parser.feed("(+ 1 2) hello");
+    REQUIRE(parser.failed());
+  }
+
+  {
+    StreamParser parser;
+    parser.feed("(define a 1abc)");
+    REQUIRE(parser.failed());
+  }
+
+  {
+    StreamParser parser;
+    parser.feed("(+ 1 (- 2");
+    REQUIRE(!parser.failed());
+    parser.finish();
+    REQUIRE(parser.failed());
+  }
+}
+
+TEST_CASE( "Test parse_program", "[parse]" ) {
+
+  std::vector<Expression> forms;
+
+  REQUIRE(parse_program(std::make_shared<const SourceBuffer>("(define a 1)\n(+ a 2) ; done"), forms));
+  REQUIRE(forms.size() == 2);
+
+  forms.clear();
+  REQUIRE(!parse_program(std::make_shared<const SourceBuffer>(" ; nothing here"), forms));
+  REQUIRE(!parse_program(std::make_shared<const SourceBuffer>("(+ 1 2) (+ 3"), forms));
+}
+
+TEST_CASE( "Test parse records source spans", "[parse]" ) {
+
+  std::vector<Expression> forms;
+  REQUIRE(parse_program(std::make_shared<const SourceBuffer>("(define a 1)\n\n(+ a\n   (- 2 \"s\"))"), forms));
+  REQUIRE(forms.size() == 2);
+
+  REQUIRE(forms[0].span().begin.line == 1);
+  REQUIRE(forms[0].span().begin.column == 1);
+  REQUIRE(forms[0].span().end.column == 12);
+
+  const Expression & sum = forms[1];
+  REQUIRE(sum.span().begin.line == 3);
+  REQUIRE(sum.span().end.line == 4);
+  REQUIRE(sum.span().end.column == 13);
+
+  const Expression & a = *sum.tailConstBegin();
+  REQUIRE(a.span().begin.line == 3);
+  REQUIRE(a.span().begin.column == 4);
+
+  const Expression & difference = *(sum.tailConstBegin() + 1);
+  REQUIRE(difference.span().begin.line == 4);
+  REQUIRE(difference.span().begin.column == 4);
+  REQUIRE((difference.tailConstBegin() + 1)->span().begin.column == 10);
+
+  // the stream parser counts lines across forms and chunks
+  StreamParser parser;
+  parser.feed("(define a 1)\n");
+  parser.feed("  (+ a");
+  parser.feed(" 2)");
+  Expression exp;
+  REQUIRE(parser.next(exp));
+  REQUIRE(parser.next(exp));
+  REQUIRE(exp.span().begin.line == 2);
+  REQUIRE(exp.span().begin.column == 3);
+  REQUIRE((exp.tailConstBegin() + 1)->span().begin.column == 8);
+
+  // and across several forms fed at once
+  parser.feed("\n(a)\n  (b) (c\n d)");
+  REQUIRE(parser.next(exp));
+  REQUIRE(exp.span().begin.line == 3);
+  REQUIRE(exp.span().begin.column == 1);
+  REQUIRE(parser.next(exp));
+  REQUIRE(exp.span().begin.line == 4);
+  REQUIRE(exp.span().begin.column == 3);
+  REQUIRE(parser.next(exp));
+  REQUIRE(exp.span().begin.line == 4);
+  REQUIRE(exp.span().begin.column == 7);
+  REQUIRE(exp.tailConstBegin()->span().begin.line == 5);
+  REQUIRE(exp.tailConstBegin()->span().begin.column == 2);
+  REQUIRE(!parser.next(exp));
+}
+
+TEST_CASE( "Test parse_program on several threads", "[parse]" ) {
+
+  std::string program;
+  for (int i = 0; i < 500; ++i) {
+    program += "(define v" + std::to_string(i) + " (list " + std::to_string(i) + " \"s\" (+ 1 2)))\n";
+  }
+  std::shared_ptr<const SourceBuffer> source = std::make_shared<const SourceBuffer>(program);
+
+  std::vector<Expression> serial;
+  REQUIRE(parse_program(source, serial));
+
+  for (unsigned threads : {2u, 3u, 8u, 1000u}) {
+    std::vector<Expression> parallel;
+    REQUIRE(parse_program(source, parallel, threads));
+    REQUIRE(parallel.size() == serial.size());
+    for (std::size_t i = 0; i < serial.size(); ++i) {
+      REQUIRE(parallel[i] == serial[i]);
+      REQUIRE(parallel[i].span().begin.line == i + 1);
+    }
+  }
+
+  std::vector<Expression> forms;
+  REQUIRE(!parse_program(std::make_shared<const SourceBuffer>(program + "(define bad 1abc)"), forms, 4));
+  REQUIRE(!parse_program(std::make_shared<const SourceBuffer>(program + "(+ 1"), forms, 4));
+  REQUIRE(!parse_program(std::make_shared<const SourceBuffer>(""), forms, 4));
+}
@@ -0,0 +1,256 @@
+/*! \file persistent_map.hpp
+Defines the persistent map the environment keeps its definitions in.
+ */
+#ifndef PERSISTENT_MAP_HPP
+#define PERSISTENT_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "symbol.hpp"
+
+/*! \class PersistentMap
+\brief A hash array mapped trie from interned symbols to values, whose
+copies share their nodes.
+
+Copying a map copies one pointer, and the copy and the original then share
+every node. Changing either copies only the nodes on the way from the root
+to the changed entry, at most one per 5 bits of the hash, and leaves the
+other as it was; nodes that only one map holds are changed in place.
+
+Each node has a bit for each of the 32 values of its 5 bits of the hash,
+saying whether they lead to an entry, a child node or nothing, and keeps
+only the entries and children it has. Hashing a symbol scatters its id
+without losing any of it, so two symbols never share a whole hash and the
+trie needs no collision lists.
+
+Each entry also keeps the slot it was given when its symbol was added,
+which stays the same while the symbol is rebound or others are added. A
+caller looking the same symbol up over and over can keep the slot get
+hands out: the map keeps a pointer to each entry found that way, by slot,
+until the map next changes, so following a slot is a single indexed load.
+The pointers are not copied with the map, which keeps copying cheap, and
+are filled in by lookups on a const map, so a map looked up with slots must
+not be shared between threads.
+
+Nodes always come from the heap, since a node may be shared by a map that
+outlives the evaluation it was made in.
+ */
+template<typename T>
+class PersistentMap {
+public:
+
+	/// what a slot starts out as, before get has filled it in
+	static const std::size_t NO_SLOT = std::size_t(-1);
+
+	PersistentMap() = default;
+
+	/// a copy sharing every node of map
+	PersistentMap(const PersistentMap & map) :
+		m_root(map.m_root), m_size(map.m_size), m_next(map.m_next) {}
+
+	PersistentMap(PersistentMap && map) = default;
+
+	PersistentMap & operator=(const PersistentMap & map) {
+		m_root = map.m_root;
+		m_size = map.m_size;
+		m_next = map.m_next;
+		m_found.clear();
+		return *this;
+	}
+
+	PersistentMap & operator=(PersistentMap && map) = default;
+
+	/// the number of entries
+	std::size_t size() const noexcept { return m_size; }
+
+	/// whether the map has no entries
+	bool empty() const noexcept { return m_size == 0; }
+
+	/// the value bound to sym, or nullptr
+	const T * get(SymbolId sym) const noexcept;
+
+	/*! The value bound to sym, starting with slot
+	  \param sym the symbol to look up
+	  \param slot NO_SLOT or a slot from an earlier call, set to the slot of
+	  sym if it is bound; a slot of another symbol, or from before the map
+	  last changed, is checked and costs a lookup without it
+	  \return the value, or nullptr
+	 */
+	const T * get(SymbolId sym, std::size_t & slot) const;
+
+	/// bind sym to value
+	void set(SymbolId sym, T value);
+
+	/// remove every entry, leaving copies of the map alone
+	void clear() noexcept {
+		m_root.reset();
+		m_size = 0;
+		m_next = 0;
+		m_found.clear();
+	}
+
+private:
+	struct Entry {
+		SymbolId sym;
+		std::size_t slot;
+		T value;
+	};
+
+	struct Node {
+		// the hash values with an entry here, and those with a child
+		std::uint32_t datamap = 0;
+		std::uint32_t nodemap = 0;
+
+		// in the order of their bits
+		std::vector<Entry> entries;
+		std::vector<std::shared_ptr<Node> > children;
+	};
+
+	std::shared_ptr<Node> m_root;
+	std::size_t m_size = 0;
+
+	// the slot the next new symbol gets
+	std::size_t m_next = 0;
+
+	// the entries get has found by slot since the map last changed, or nullptr
+	mutable std::vector<const Entry *> m_found;
+
+	// the entry for sym, or nullptr
+	const Entry * find(SymbolId sym) const noexcept;
+
+	// ids are dense, so they are scattered by Fibonacci hashing; the
+	// multiplier is odd, so different ids have different hashes
+	static std::uint32_t hash(SymbolId sym) noexcept {
+		return static_cast<std::uint32_t>(sym * 2654435769u);
+	}
+
+	// the bit for the 5 bits of hash at shift
+	static std::uint32_t bit(std::uint32_t hash, unsigned shift) noexcept {
+		return std::uint32_t(1) << ((hash >> shift) & 31);
+	}
+
+	// where the item for bit is among those bitmap has, i.e. the number of
+	// lower bits set; counted in parallel, which std::bitset::count leaves
+	// to a library call unless the target has an instruction for it
+	static std::size_t index(std::uint32_t bitmap, std::uint32_t bit) noexcept {
+		std::uint32_t v = bitmap & (bit - 1);
+		v = v - ((v >> 1) & 0x55555555u);
+		v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+		v = (v + (v >> 4)) & 0x0f0f0f0fu;
+		return (v * 0x01010101u) >> 24;
+	}
+
+	// the node at, made first if there is none, or copied if another map
+	// holds it too
+	static Node & own(std::shared_ptr<Node> & at);
+
+	// bind the symbol of entry in the trie under at, whose level is at
+	// shift; a new symbol keeps the slot of entry, returns whether it is new
+	static bool insert(std::shared_ptr<Node> & at, unsigned shift, Entry && entry);
+};
+
+template<typename T>
+const std::size_t PersistentMap<T>::NO_SLOT;
+
+template<typename T>
+const typename PersistentMap<T>::Entry * PersistentMap<T>::find(SymbolId sym) const noexcept {
+	std::uint32_t h = hash(sym);
+	const Node * node = m_root.get();
+	for (unsigned shift = 0; node != nullptr; shift += 5) {
+		std::uint32_t b = bit(h, shift);
+		if (node->datamap & b) {
+			const Entry & entry = node->entries[index(node->datamap, b)];
+			return (entry.sym == sym) ? &entry : nullptr;
+		}
+		if (!(node->nodemap & b)) {
+			return nullptr;
+		}
+		node = node->children[index(node->nodemap, b)].get();
+	}
+	return nullptr;
+}
+
+template<typename T>
+const T * PersistentMap<T>::get(SymbolId sym) const noexcept {
+	const Entry * entry = find(sym);
+	return (entry != nullptr) ? &entry->value : nullptr;
+}
+
+template<typename T>
+const T * PersistentMap<T>::get(SymbolId sym, std::size_t & slot) const {
+	if (slot < m_found.size() && m_found[slot] != nullptr && m_found[slot]->sym == sym) {
+		return &m_found[slot]->value;
+	}
+
+	const Entry * entry = find(sym);
+	if (entry == nullptr) {
+		return nullptr;
+	}
+	slot = entry->slot;
+	if (slot >= m_found.size()) {
+		m_found.resize(slot + 1, nullptr);
+	}
+	m_found[slot] = entry;
+	return &entry->value;
+}
+
+template<typename T>
+void PersistentMap<T>::set(SymbolId sym, T value) {
+	// the entries found may move or be freed
+	m_found.clear();
+	if (insert(m_root, 0, Entry{ sym, m_next, std::move(value) })) {
+		++m_size;
+		++m_next;
+	}
+}
+
+template<typename T>
+typename PersistentMap<T>::Node & PersistentMap<T>::own(std::shared_ptr<Node> & at) {
+	if (!at) {
+		at = std::make_shared<Node>();
+	}
+	else if (at.use_count() != 1) {
+		at = std::make_shared<Node>(*at);
+	}
+	return *at;
+}
+
+template<typename T>
+bool PersistentMap<T>::insert(std::shared_ptr<Node> & at, unsigned shift, Entry && entry) {
+	Node & node = own(at);
+	std::uint32_t b = bit(hash(entry.sym), shift);
+
+	if (node.nodemap & b) {
+		return insert(node.children[index(node.nodemap, b)], shift + 5, std::move(entry));
+	}
+
+	std::size_t i = index(node.datamap, b);
+	if (!(node.datamap & b)) {
+		node.entries.insert(node.entries.begin() + i, std::move(entry));
+		node.datamap |= b;
+		return true;
+	}
+
+	// a symbol rebound keeps its slot
+	if (node.entries[i].sym == entry.sym) {
+		node.entries[i].value = std::move(entry.value);
+		return false;
+	}
+
+	// another symbol has the same bits here, both move down to a new child
+	std::shared_ptr<Node> child;
+	insert(child, shift + 5, std::move(node.entries[i]));
+	insert(child, shift + 5, std::move(entry));
+
+	node.entries.erase(node.entries.begin() + i);
+	node.datamap &= ~b;
+	node.children.insert(node.children.begin() + index(node.nodemap, b), std::move(child));
+	node.nodemap |= b;
+	return true;
+}
+
+#endif
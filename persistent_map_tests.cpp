@@ -0,0 +1,105 @@
+#include "catch.hpp"
+
+#include <string>
+
+#include "environment.hpp"
+#include "persistent_map.hpp"
+
+TEST_CASE( "Test copies of a persistent map are independent", "[persistent_map]" ) {
+
+  PersistentMap<int> map;
+  REQUIRE(map.empty());
+  REQUIRE(map.get(intern("a")) == nullptr);
+
+  // enough symbols for several levels of the trie
+  const int count = 5000;
+  for (int i = 0; i < count; ++i) {
+    map.set(intern("key" + std::to_string(i)), i);
+  }
+  REQUIRE(map.size() == count);
+
+  PersistentMap<int> copy(map);
+  for (int i = 0; i < count; i += 2) {
+    copy.set(intern("key" + std::to_string(i)), -i);
+  }
+  copy.set(intern("extra"), 1);
+  REQUIRE(copy.size() == count + 1);
+  REQUIRE(map.size() == count);
+
+  for (int i = 0; i < count; ++i) {
+    SymbolId sym = intern("key" + std::to_string(i));
+    REQUIRE(*map.get(sym) == i);
+    REQUIRE(*copy.get(sym) == ((i % 2 == 0) ? -i : i));
+  }
+  REQUIRE(map.get(intern("extra")) == nullptr);
+  REQUIRE(*copy.get(intern("extra")) == 1);
+
+  // rebinding keeps the size
+  map.set(intern("key1"), 10);
+  REQUIRE(*map.get(intern("key1")) == 10);
+  REQUIRE(*copy.get(intern("key1")) == 1);
+  REQUIRE(map.size() == count);
+
+  map.clear();
+  REQUIRE(map.empty());
+  REQUIRE(map.get(intern("key1")) == nullptr);
+  REQUIRE(*copy.get(intern("key1")) == 1);
+}
+
+TEST_CASE( "Test looking a persistent map up by slot", "[persistent_map]" ) {
+
+  PersistentMap<int> map;
+  for (int i = 0; i < 100; ++i) {
+    map.set(intern("slot" + std::to_string(i)), i);
+  }
+
+  std::size_t a = PersistentMap<int>::NO_SLOT;
+  std::size_t b = PersistentMap<int>::NO_SLOT;
+  REQUIRE(*map.get(intern("slot3"), a) == 3);
+  REQUIRE(*map.get(intern("slot4"), b) == 4);
+  REQUIRE(a != b);
+
+  // a slot of another symbol is checked rather than trusted
+  std::size_t wrong = b;
+  REQUIRE(*map.get(intern("slot3"), wrong) == 3);
+  REQUIRE(wrong == a);
+  REQUIRE(map.get(intern("missing"), wrong) == nullptr);
+
+  // slots survive rebinding, other definitions and copying
+  map.set(intern("slot3"), -3);
+  map.set(intern("extra"), 0);
+  PersistentMap<int> copy(map);
+  copy.set(intern("slot3"), 30);
+  std::size_t slot = a;
+  REQUIRE(*map.get(intern("slot3"), slot) == -3);
+  REQUIRE(slot == a);
+  REQUIRE(*copy.get(intern("slot3"), slot) == 30);
+  REQUIRE(slot == a);
+  REQUIRE(*map.get(intern("slot3"), slot) == -3);
+
+  map.clear();
+  REQUIRE(map.get(intern("slot3"), slot) == nullptr);
+}
+
+TEST_CASE( "Test snapshots of an environment", "[persistent_map]" ) {
+
+  Environment env;
+  env.add_exp(Atom("a"), Expression(1));
+  env.add_exp(Atom("b"), Expression(2));
+
+  Environment snapshot(env);
+  env.add_exp(Atom("a"), Expression(3));
+  env.add_exp(Atom("c"), Expression(4));
+  REQUIRE(env.get_exp(Atom("a")) == Expression(3));
+  REQUIRE(env.get_exp(Atom("c")) == Expression(4));
+  REQUIRE(snapshot.get_exp(Atom("a")) == Expression(1));
+  REQUIRE(snapshot.get_exp(Atom("b")) == Expression(2));
+  REQUIRE(!snapshot.is_known(Atom("c")));
+
+  // going back to the snapshot
+  env = snapshot;
+  REQUIRE(env.get_exp(Atom("a")) == Expression(1));
+  REQUIRE(!env.is_known(Atom("c")));
+  snapshot.reset();
+  REQUIRE(env.get_exp(Atom("b")) == Expression(2));
+}
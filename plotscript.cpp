@@ -100,7 +100,10 @@ inline void install_handler() {
 #include <iostream>
 #include <fstream>
 
+#include "compiled_program.hpp"
 #include "interpreter.hpp"
+#include "optimize.hpp"
+#include "profiler.hpp"
 #include "semantic_error.hpp"
 #include "startup_config.hpp"
 #include "tsQueue.hpp"
@@ -148,64 +151,226 @@ void info(const std::string & err_str) {
 
 int eval_startup(Interpreter & interp)
 {
-	std::ifstream ifs(STARTUP_FILE);
+	std::shared_ptr<const SourceBuffer> source = read_file(STARTUP_FILE);
 
-	if (!ifs) {
+	if (!source) {
 		error("Could not open file for reading.");
 		return EXIT_FAILURE;
 	}
 
-	if (!interp.parseStream(ifs)) {
-		error("Invalid Program. Could not parse.");
-		return EXIT_FAILURE;
-	}
-	else {
-		try {
-			Expression exp = interp.evaluate();
-		}
-		catch (const SemanticError & ex) {
-			std::cerr << ex.what() << std::endl;
+	// the build compiles the startup file; use that unless the text has changed since
+	std::vector<Expression> forms;
+	std::shared_ptr<const SourceBuffer> image = read_file(STARTUP_COMPILED_FILE);
+	if (!image || !load_compiled(*image, forms, source.get())) {
+		forms.clear();
+		if (!parse_program(source, forms)) {
+			error("Invalid Program. Could not parse.");
 			return EXIT_FAILURE;
 		}
 	}
 
+	try {
+		for (auto & form : forms) {
+			interp.evaluate(form);
+		}
+	}
+	catch (const SemanticError & ex) {
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
 	return EXIT_SUCCESS;
 }
 
-int eval_from_stream(std::istream & stream) {
+// programs at least this many bytes long may be parsed on several threads;
+// the size is a guess, no speedup from it has been measured yet (see the
+// parallel_parse benchmark)
+const std::size_t PARALLEL_PARSE_BYTES = 1 << 20;
+
+// the number of threads to parse a program of size bytes with; one unless
+// PLOTSCRIPT_PARSE_THREADS asks for 2 to 64, since no more than one has
+// been shown to help
+unsigned parse_threads(std::size_t size) {
+	const char * setting = std::getenv("PLOTSCRIPT_PARSE_THREADS");
+	if (size < PARALLEL_PARSE_BYTES || setting == nullptr) {
+		return 1;
+	}
+	long threads = std::strtol(setting, nullptr, 10);
+	return (threads > 1 && threads <= 64) ? static_cast<unsigned>(threads) : 1;
+}
+
+// evaluate each top-level form of a whole program, printing the last result;
+// if profiler is given, the program (but not the startup file) is profiled
+int eval_from_buffer(std::shared_ptr<const SourceBuffer> source, Profiler * profiler = nullptr) {
 
 	Interpreter interp;
 
 	eval_startup(interp);
 
-	if (!interp.parseStream(stream)) {
+	std::vector<Expression> forms;
+	if (!load_program(source, forms, parse_threads(source->size()))) {
 		error("Invalid Program. Could not parse.");
 		return EXIT_FAILURE;
 	}
-	else {
-		try {
-			Expression exp = interp.evaluate();
-			std::cout << exp << std::endl;
+
+	int status = EXIT_SUCCESS;
+	Profiler::activate(profiler);
+	try {
+		Expression exp;
+		for (auto & form : forms) {
+			exp = interp.evaluate(form);
 		}
-		catch (const SemanticError & ex) {
-			std::cerr << ex.what() << std::endl;
-			return EXIT_FAILURE;
+		std::cout << exp << std::endl;
+	}
+	catch (const SemanticError & ex) {
+		std::cerr << ex.what() << std::endl;
+		status = EXIT_FAILURE;
+	}
+	Profiler::activate(nullptr);
+
+	if (profiler != nullptr) {
+		profiler->report(std::cerr, source.get());
+	}
+
+	return status;
+}
+
+// evaluate each top-level form as soon as it has been read from the stream,
+// printing the last result; the stream is read a line at a time, so a form
+// typed at a terminal or written to a pipe is evaluated once its line ends
+// the most of a line read from a stream before it is fed to the parser
+const std::size_t STREAM_CHUNK_BYTES = 4096;
+
+int eval_from_stream(std::istream & stream) {
+
+	Interpreter interp;
+
+	eval_startup(interp);
+
+	StreamParser parser;
+	Expression form, exp;
+	bool evaluated = false;
+
+	// a line is fed as soon as it ends, so a form is evaluated once the line
+	// closing it arrives; a longer line is fed in pieces as they are read,
+	// so only the form being read is held, however long its line
+	char chunk[STREAM_CHUNK_BYTES + 1];
+
+	try {
+		while (!parser.failed()) {
+			stream.getline(chunk, sizeof(chunk));
+			std::size_t count = static_cast<std::size_t>(stream.gcount());
+			bool end = stream.eof() || stream.bad();
+			bool full = !end && stream.fail();
+			if (full) {
+				stream.clear();
+			}
+			else if (!end) {
+				// getline counts the newline but stores a terminator instead
+				chunk[count - 1] = '\n';
+			}
+
+			// the last line may have no newline, it is fed all the same
+			parser.feed(chunk, count);
+			if (end) {
+				parser.finish();
+			}
+
+			while (parser.next(form)) {
+				exp = interp.evaluate(form);
+				evaluated = true;
+			}
+
+			if (end) break;
 		}
 	}
+	catch (const SemanticError & ex) {
+		std::cerr << ex.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (parser.failed() || !evaluated) {
+		error("Invalid Program. Could not parse.");
+		return EXIT_FAILURE;
+	}
+
+	std::cout << exp << std::endl;
 
 	return EXIT_SUCCESS;
 }
 
 int eval_from_file(std::string filename) {
 
-	std::ifstream ifs(filename);
+	std::shared_ptr<const SourceBuffer> source = read_file(filename);
 
-	if (!ifs) {
+	if (!source) {
 		error("Could not open file for reading.");
 		return EXIT_FAILURE;
 	}
 
-	return eval_from_stream(ifs);
+	return eval_from_buffer(source);
+}
+
+int eval_with_profile(std::string filename) {
+
+	std::shared_ptr<const SourceBuffer> source = read_file(filename);
+
+	if (!source) {
+		error("Could not open file for reading.");
+		return EXIT_FAILURE;
+	}
+
+	Profiler profiler;
+	return eval_from_buffer(source, &profiler);
+}
+
+// parse a program file and write it out in compiled form
+int compile_file(std::string input, std::string output) {
+
+	std::shared_ptr<const SourceBuffer> source = read_file(input);
+
+	if (!source) {
+		error("Could not open file for reading.");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Expression> forms;
+	if (!parse_program(source, forms, parse_threads(source->size()))) {
+		error("Invalid Program. Could not parse.");
+		return EXIT_FAILURE;
+	}
+
+	std::ofstream ofs(output, std::ios::binary);
+	ofs << compile_program(*source, forms);
+	if (!ofs) {
+		error("Could not write compiled program.");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// parse a program file and write the tree of each form, as optimized
+int dump_file(std::string filename) {
+
+	std::shared_ptr<const SourceBuffer> source = read_file(filename);
+
+	if (!source) {
+		error("Could not open file for reading.");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Expression> forms;
+	if (!load_program(source, forms, parse_threads(source->size()))) {
+		error("Invalid Program. Could not parse.");
+		return EXIT_FAILURE;
+	}
+
+	for (const Expression & form : forms) {
+		dump_ast(std::cout, form);
+	}
+
+	return EXIT_SUCCESS;
 }
 
 int eval_from_command(std::string argexp) {
@@ -339,16 +504,28 @@ void repl() {
 int main(int argc, char *argv[])
 {
 	if (argc == 2) {
+		if (std::string(argv[1]) == "-") {
+			return eval_from_stream(std::cin);
+		}
 		return eval_from_file(argv[1]);
 	}
 	else if (argc == 3) {
 		if (std::string(argv[1]) == "-e") {
 			return eval_from_command(argv[2]);
 		}
+		else if (std::string(argv[1]) == "--profile") {
+			return eval_with_profile(argv[2]);
+		}
+		else if (std::string(argv[1]) == "--dump-ast") {
+			return dump_file(argv[2]);
+		}
 		else {
 			error("Incorrect number of command line arguments.");
 		}
 	}
+	else if (argc == 5 && std::string(argv[1]) == "--compile" && std::string(argv[3]) == "-o") {
+		return compile_file(argv[2], argv[4]);
+	}
 	else 
 	{	
 		repl();
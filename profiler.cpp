@@ -0,0 +1,89 @@
+#include "profiler.hpp"
+
+#include <iomanip>
+#include <string>
+
+Profiler * Profiler::s_active = nullptr;
+
+void Profiler::activate(Profiler * profiler) noexcept {
+	s_active = profiler;
+}
+
+void Profiler::enter(std::uint32_t line) {
+	LineProfile & stats = m_lines[line];
+	++stats.calls;
+	++stats.open;
+
+	Frame frame;
+	frame.line = &stats;
+	frame.children = 0;
+	m_frames.push_back(frame);
+
+	// read the clock last so bookkeeping is not charged to the line
+	m_frames.back().start = Clock::now();
+}
+
+void Profiler::exit() noexcept {
+	Clock::time_point stop = Clock::now();
+
+	Frame frame = m_frames.back();
+	m_frames.pop_back();
+
+	double elapsed = std::chrono::duration<double>(stop - frame.start).count();
+
+	--frame.line->open;
+	if (frame.line->open == 0) {
+		frame.line->inclusive += elapsed;
+	}
+	frame.line->exclusive += elapsed - frame.children;
+
+	if (!m_frames.empty()) {
+		m_frames.back().children += elapsed;
+	}
+}
+
+const std::map<std::uint32_t, Profiler::LineProfile> & Profiler::lines() const noexcept {
+	return m_lines;
+}
+
+// the text of a line of source, without its line break
+static std::string line_text(const SourceBuffer & source, std::uint32_t line) {
+	const char * c = source.data();
+	const char * end = source.end();
+
+	for (std::uint32_t n = 1; n < line && c != end; ++c) {
+		if (*c == '\n') ++n;
+	}
+
+	const char * stop = c;
+	while (stop != end && *stop != '\n' && *stop != '\r') {
+		++stop;
+	}
+	return std::string(c, stop);
+}
+
+void Profiler::report(std::ostream & out, const SourceBuffer * source) const {
+	out << std::setw(6) << "line" << std::setw(10) << "calls"
+		<< std::setw(16) << "inclusive ms" << std::setw(16) << "exclusive ms";
+	if (source != nullptr) {
+		out << "  source";
+	}
+	out << "\n";
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+
+	for (auto & entry : m_lines) {
+		out << std::setw(6) << entry.first << std::setw(10) << entry.second.calls
+			<< std::setw(16) << entry.second.inclusive * 1000
+			<< std::setw(16) << entry.second.exclusive * 1000;
+		if (source != nullptr) {
+			out << "  " << line_text(*source, entry.first);
+		}
+		out << "\n";
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
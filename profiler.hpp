@@ -0,0 +1,101 @@
+/*! \file profiler.hpp
+Defines the Profiler type, which times evaluation per source line.
+ */
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "source_buffer.hpp"
+
+/*! \class Profiler
+\brief Collects call counts and evaluation times per source line.
+
+While a profiler is active, Expression::eval reports every form it
+evaluates that carries a source location. Time spent in a form is charged
+to the line the form starts on: inclusive time covers everything the form
+did, exclusive time leaves out the time of forms nested in it that were
+charged themselves. A line evaluated recursively only counts its outermost
+evaluation towards its inclusive time.
+
+When no profiler is active, eval pays one pointer test per call. The active
+profiler is process-wide, so only one thread should evaluate while it is set.
+ */
+class Profiler {
+public:
+
+	/// statistics gathered for one source line
+	struct LineProfile {
+		std::uint64_t calls = 0; ///< forms evaluated
+		double inclusive = 0;    ///< seconds, nested forms included
+		double exclusive = 0;    ///< seconds, nested forms left out
+		unsigned open = 0;       ///< evaluations currently running
+	};
+
+	/// the profiler currently collecting, or nullptr
+	static Profiler * active() noexcept {
+		return s_active;
+	}
+
+	/// make profiler the one collecting, nullptr to stop profiling
+	static void activate(Profiler * profiler) noexcept;
+
+	/// note that evaluation of a form starting on line has begun
+	void enter(std::uint32_t line);
+
+	/// note that evaluation of the most recently entered form has ended
+	void exit() noexcept;
+
+	/// the statistics gathered so far, by line
+	const std::map<std::uint32_t, LineProfile> & lines() const noexcept;
+
+	/*! Write the statistics as a table, one row per line
+	  \param out the stream to write to
+	  \param source the profiled program, used to show each line's text; may be null
+	 */
+	void report(std::ostream & out, const SourceBuffer * source = nullptr) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// an evaluation in progress
+	struct Frame {
+		LineProfile * line;
+		Clock::time_point start;
+		double children; // seconds charged to nested frames
+	};
+
+	std::map<std::uint32_t, LineProfile> m_lines;
+	std::vector<Frame> m_frames;
+
+	static Profiler * s_active;
+};
+
+/*! \class ProfileScope
+\brief Enters a line on construction and exits it on destruction.
+ */
+class ProfileScope {
+public:
+
+	/// begin timing an evaluation on line
+	ProfileScope(Profiler & profiler, std::uint32_t line) : m_profiler(profiler) {
+		m_profiler.enter(line);
+	}
+
+	/// end timing, also when evaluation throws
+	~ProfileScope() {
+		m_profiler.exit();
+	}
+
+	ProfileScope(const ProfileScope &) = delete;
+	ProfileScope & operator=(const ProfileScope &) = delete;
+
+private:
+	Profiler & m_profiler;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "catch.hpp"
+
+#include "interpreter.hpp"
+#include "parse.hpp"
+#include "profiler.hpp"
+
+#include <sstream>
+#include <vector>
+
+TEST_CASE( "Test profiler counts calls per line", "[profiler]" ) {
+
+  std::shared_ptr<const SourceBuffer> source = std::make_shared<const SourceBuffer>(
+    "(define f (lambda (n)\n"
+    "  (+ n 1)))\n"
+    "(f (f 1))\n");
+
+  std::vector<Expression> forms;
+  REQUIRE(parse_program(source, forms));
+
+  Interpreter interp;
+  Profiler profiler;
+  Profiler::activate(&profiler);
+  Expression result;
+  for (auto & form : forms) {
+    result = interp.evaluate(form);
+  }
+  Profiler::activate(nullptr);
+
+  REQUIRE(result == Expression(3.));
+
+  auto & lines = profiler.lines();
+  REQUIRE(lines.size() == 3);
+  // the define and the lambda it evaluates
+  REQUIRE(lines.at(1).calls == 2);
+  REQUIRE(lines.at(2).calls == 2);
+  REQUIRE(lines.at(3).calls == 2);
+
+  // the calls on line 3 nest, the outer one covers both
+  REQUIRE(lines.at(3).inclusive >= lines.at(2).inclusive);
+  REQUIRE(lines.at(3).exclusive <= lines.at(3).inclusive);
+  REQUIRE(lines.at(3).open == 0);
+
+  std::ostringstream out;
+  profiler.report(out, source.get());
+  REQUIRE(out.str().find("(f (f 1))") != std::string::npos);
+}
+
+TEST_CASE( "Test profiler is off by default", "[profiler]" ) {
+
+  REQUIRE(Profiler::active() == nullptr);
+
+  Profiler profiler;
+  std::vector<Expression> forms;
+  REQUIRE(parse_program(std::make_shared<const SourceBuffer>("(+ 1 2)"), forms));
+
+  Interpreter interp;
+  interp.evaluate(forms[0]);
+  REQUIRE(profiler.lines().empty());
+}
@@ -0,0 +1,80 @@
+#include "property_table.hpp"
+
+PropertyTable::PropertyTable() : m_owners(1) {
+	for (auto & slot : m_slots) {
+		slot = NO_ENTRY;
+	}
+}
+
+PropertyTable::PropertyTable(const PropertyTable & other) : m_entries(other.m_entries), m_owners(1) {
+	for (std::size_t i = 0; i < SLOT_COUNT; ++i) {
+		m_slots[i] = other.m_slots[i];
+	}
+}
+
+std::uint32_t PropertyTable::index(SymbolId key) const noexcept {
+	if (key >= FIRST_SLOT && key - FIRST_SLOT < SLOT_COUNT) {
+		return m_slots[key - FIRST_SLOT];
+	}
+
+	for (std::size_t i = 0; i < m_entries.size(); ++i) {
+		if (m_entries[i].first == key) {
+			return static_cast<std::uint32_t>(i);
+		}
+	}
+	return NO_ENTRY;
+}
+
+const Expression * PropertyTable::find(SymbolId key) const noexcept {
+	std::uint32_t i = index(key);
+	return i == NO_ENTRY ? nullptr : &m_entries[i].second;
+}
+
+void PropertyTable::set(SymbolId key, Expression value) {
+	std::uint32_t i = index(key);
+	if (i != NO_ENTRY) {
+		m_entries[i].second = std::move(value);
+		return;
+	}
+
+	if (key >= FIRST_SLOT && key - FIRST_SLOT < SLOT_COUNT) {
+		m_slots[key - FIRST_SLOT] = static_cast<std::uint32_t>(m_entries.size());
+	}
+	m_entries.emplace_back(key, std::move(value));
+}
+
+std::size_t PropertyTable::size() const noexcept {
+	return m_entries.size();
+}
+
+bool PropertyTable::empty() const noexcept {
+	return m_entries.empty();
+}
+
+PropertyTable::const_iterator PropertyTable::begin() const noexcept {
+	return m_entries.begin();
+}
+
+PropertyTable::const_iterator PropertyTable::end() const noexcept {
+	return m_entries.end();
+}
+
+void PropertyTable::retain() const noexcept {
+	m_owners.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PropertyTable::release(const PropertyTable * table) noexcept {
+	// the last owner must see every change made through the others
+	if (table != nullptr && table->m_owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete table;
+	}
+}
+
+bool PropertyTable::shared() const noexcept {
+	return m_owners.load(std::memory_order_acquire) > 1;
+}
+
+const PropertyTable & PropertyTable::none() noexcept {
+	static const PropertyTable empty;
+	return empty;
+}
@@ -0,0 +1,85 @@
+/*! \file property_table.hpp
+Defines the table holding the properties of an expression.
+ */
+#ifndef PROPERTY_TABLE_HPP
+#define PROPERTY_TABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "expression.hpp"
+#include "symbol.hpp"
+
+/*! \class PropertyTable
+\brief The properties of an expression, keyed by interned symbol id.
+
+Only expressions that have properties own a table, which is reference
+counted so that copies of the expression can share it. The entries are
+kept in the order they were first set. The graphics property names, from
+SYM_OBJECT_NAME to SYM_TEXT_ROTATION, are found through a fixed slot
+array; any other key is found by scanning the entries, of which there are
+only ever a few.
+ */
+class PropertyTable {
+public:
+
+	/// a property name and its value
+	typedef std::pair<SymbolId, Expression> Entry;
+
+	typedef std::vector<Entry>::const_iterator const_iterator;
+
+	/// construct an empty table, with one owner
+	PropertyTable();
+
+	/// copy the entries of a table, the copy has one owner
+	PropertyTable(const PropertyTable & other);
+
+	PropertyTable & operator=(const PropertyTable &) = delete;
+
+	/// return the value of key, or nullptr if it is not set
+	const Expression * find(SymbolId key) const noexcept;
+
+	/// set key to value, replacing any earlier value
+	void set(SymbolId key, Expression value);
+
+	/// the number of properties set
+	std::size_t size() const noexcept;
+
+	/// whether no properties are set
+	bool empty() const noexcept;
+
+	const_iterator begin() const noexcept;
+	const_iterator end() const noexcept;
+
+	/// add an owner
+	void retain() const noexcept;
+
+	/// remove an owner, deleting the table when it was the last
+	static void release(const PropertyTable * table) noexcept;
+
+	/// whether more than one expression owns the table
+	bool shared() const noexcept;
+
+	/// an empty table, for expressions without one
+	static const PropertyTable & none() noexcept;
+
+private:
+
+	static const SymbolId FIRST_SLOT = SYM_OBJECT_NAME;
+	static const std::size_t SLOT_COUNT = SYM_TEXT_ROTATION - SYM_OBJECT_NAME + 1;
+	static const std::uint32_t NO_ENTRY = 0xffffffff;
+
+	// index of each graphics property in m_entries, NO_ENTRY if not set
+	std::uint32_t m_slots[SLOT_COUNT];
+
+	std::vector<Entry> m_entries;
+
+	mutable std::atomic<unsigned> m_owners;
+
+	// index of key in m_entries, NO_ENTRY if not set
+	std::uint32_t index(SymbolId key) const noexcept;
+};
+
+#endif
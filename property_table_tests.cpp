@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include "expression.hpp"
+#include "property_table.hpp"
+
+TEST_CASE( "Test property table lookups", "[property_table]" ) {
+
+  PropertyTable table;
+  REQUIRE(table.empty());
+  REQUIRE(table.find(SYM_OBJECT_NAME) == nullptr);
+  REQUIRE(table.find(intern("color")) == nullptr);
+
+  // graphics names and any other names are found alike
+  table.set(SYM_OBJECT_NAME, Expression(Atom("point", true)));
+  table.set(intern("color"), Expression(Atom("red", true)));
+  table.set(SYM_TEXT_ROTATION, Expression(1));
+  REQUIRE(table.size() == 3);
+  REQUIRE(*table.find(SYM_OBJECT_NAME) == Expression(Atom("point", true)));
+  REQUIRE(*table.find(intern("color")) == Expression(Atom("red", true)));
+  REQUIRE(*table.find(SYM_TEXT_ROTATION) == Expression(1));
+  REQUIRE(table.find(SYM_SIZE) == nullptr);
+  REQUIRE(table.find(SYM_POINT) == nullptr);
+
+  // setting again replaces the value in place
+  table.set(SYM_OBJECT_NAME, Expression(Atom("line", true)));
+  table.set(intern("color"), Expression(Atom("blue", true)));
+  REQUIRE(table.size() == 3);
+  REQUIRE(*table.find(SYM_OBJECT_NAME) == Expression(Atom("line", true)));
+  REQUIRE(*table.find(intern("color")) == Expression(Atom("blue", true)));
+
+  // entries are kept in the order they were first set
+  auto entry = table.begin();
+  REQUIRE(entry->first == SYM_OBJECT_NAME);
+  ++entry;
+  REQUIRE(symbol_name(entry->first) == "color");
+  ++entry;
+  REQUIRE(entry->first == SYM_TEXT_ROTATION);
+  REQUIRE(++entry == table.end());
+
+  // a copy finds the same values and has its own owner count
+  PropertyTable copy(table);
+  REQUIRE(!copy.shared());
+  copy.set(SYM_SIZE, Expression(2));
+  REQUIRE(*copy.find(SYM_TEXT_ROTATION) == Expression(1));
+  REQUIRE(*copy.find(SYM_SIZE) == Expression(2));
+  REQUIRE(table.find(SYM_SIZE) == nullptr);
+}
+
+TEST_CASE( "Test expressions without properties have no table", "[property_table]" ) {
+
+  Expression leaf(1);
+  REQUIRE(&leaf.properties() == &PropertyTable::none());
+  REQUIRE(!leaf.is_value(Expression(Atom("size"))));
+
+  Expression point{ Atom("list") };
+  point.add_pair(Expression(Atom("object-name")), Expression(Atom("point", true)));
+  REQUIRE(&point.properties() != &PropertyTable::none());
+  REQUIRE(point.properties().size() == 1);
+
+  // copies share the table until one of them sets a property
+  Expression copy(point);
+  REQUIRE(copy.properties().shared());
+  copy.add_pair(Expression(Atom("size")), Expression(3));
+  REQUIRE(!copy.properties().shared());
+  REQUIRE(!point.properties().shared());
+  REQUIRE(!point.is_value(Expression(Atom("size"))));
+  REQUIRE(copy.get_value(Expression(Atom("size"))) == Expression(3));
+  REQUIRE(copy.get_value(Expression(Atom("object-name"))) == Expression(Atom("point", true)));
+}
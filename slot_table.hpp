@@ -0,0 +1,181 @@
+/*! \file slot_table.hpp
+Defines the hash table the environment keeps its bindings in.
+ */
+#ifndef SLOT_TABLE_HPP
+#define SLOT_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "symbol.hpp"
+
+/*! \class SlotTable
+\brief An open-addressing hash table from interned symbols to values, in
+which each entry keeps its slot.
+
+The entries are kept in one array in the order they were added, and the
+index of an entry in it, its slot, does not change until the table is
+cleared. The hash buckets only hold slots, found by probing linearly from
+the bucket the symbol hashes to, so growing the table rehashes the
+buckets and leaves the entries alone.
+
+A caller that looks a symbol up over and over can keep the slot find
+returned and check it with holds before reading entry, a single indexed
+load. The check makes a stale slot, e.g. one taken from another table or
+before clear, harmless. Entries are never removed one at a time.
+ */
+template<typename T, typename Allocator = std::allocator<T> >
+class SlotTable {
+public:
+
+	/// a symbol and the value bound to it
+	typedef std::pair<SymbolId, T> Entry;
+
+	/// what find returns for a symbol not in the table
+	static const std::size_t NO_SLOT = std::size_t(-1);
+
+	typedef typename std::vector<Entry, typename std::allocator_traits<Allocator>::template rebind_alloc<Entry> >::const_iterator const_iterator;
+
+	/// the number of entries
+	std::size_t size() const noexcept { return m_entries.size(); }
+
+	/// whether the table has no entries
+	bool empty() const noexcept { return m_entries.empty(); }
+
+	/// the slot of sym, or NO_SLOT if it is not in the table
+	std::size_t find(SymbolId sym) const noexcept;
+
+	/// whether sym is in slot
+	bool holds(std::size_t slot, SymbolId sym) const noexcept {
+		return slot < m_entries.size() && m_entries[slot].first == sym;
+	}
+
+	/// the entry in slot, which must be less than size()
+	const Entry & entry(std::size_t slot) const noexcept { return m_entries[slot]; }
+	Entry & entry(std::size_t slot) noexcept { return m_entries[slot]; }
+
+	/// the value bound to sym, or nullptr
+	const T * get(SymbolId sym) const noexcept {
+		std::size_t slot = find(sym);
+		return (slot != NO_SLOT) ? &m_entries[slot].second : nullptr;
+	}
+
+	/*! Bind sym to value, in the slot it has or the next one
+	  \return the slot of sym
+	 */
+	std::size_t set(SymbolId sym, T value);
+
+	/// make room for count entries without growing
+	void reserve(std::size_t count);
+
+	/// remove every entry, slots handed out before are reused
+	void clear() noexcept;
+
+	/// the entries in slot order
+	const_iterator begin() const noexcept { return m_entries.begin(); }
+	const_iterator end() const noexcept { return m_entries.end(); }
+
+private:
+	std::vector<Entry, typename std::allocator_traits<Allocator>::template rebind_alloc<Entry> > m_entries;
+
+	// one more than the slot each bucket leads to, 0 for an empty bucket;
+	// a power of two in number, at least twice the number of entries
+	std::vector<std::uint32_t, typename std::allocator_traits<Allocator>::template rebind_alloc<std::uint32_t> > m_buckets;
+
+	// how far to shift a product to get a bucket index
+	unsigned m_shift = 32;
+
+	// the bucket sym hashes to; ids are dense, so they are scattered by
+	// Fibonacci hashing rather than used as they are
+	std::size_t bucket(SymbolId sym) const noexcept {
+		return static_cast<std::uint32_t>(sym * 2654435769u) >> m_shift;
+	}
+
+	// rebuild the buckets, count in number
+	void rehash(std::size_t count);
+};
+
+template<typename T, typename Allocator>
+const std::size_t SlotTable<T, Allocator>::NO_SLOT;
+
+template<typename T, typename Allocator>
+std::size_t SlotTable<T, Allocator>::find(SymbolId sym) const noexcept {
+	if (m_entries.empty()) {
+		return NO_SLOT;
+	}
+
+	std::size_t mask = m_buckets.size() - 1;
+	for (std::size_t b = bucket(sym);; b = (b + 1) & mask) {
+		std::uint32_t slot = m_buckets[b];
+		if (slot == 0) {
+			return NO_SLOT;
+		}
+		if (m_entries[slot - 1].first == sym) {
+			return slot - 1;
+		}
+	}
+}
+
+template<typename T, typename Allocator>
+std::size_t SlotTable<T, Allocator>::set(SymbolId sym, T value) {
+	std::size_t slot = find(sym);
+	if (slot != NO_SLOT) {
+		m_entries[slot].second = std::move(value);
+		return slot;
+	}
+
+	reserve(m_entries.size() + 1);
+	slot = m_entries.size();
+	m_entries.emplace_back(sym, std::move(value));
+
+	std::size_t mask = m_buckets.size() - 1;
+	std::size_t b = bucket(sym);
+	while (m_buckets[b] != 0) {
+		b = (b + 1) & mask;
+	}
+	m_buckets[b] = static_cast<std::uint32_t>(slot + 1);
+	return slot;
+}
+
+template<typename T, typename Allocator>
+void SlotTable<T, Allocator>::reserve(std::size_t count) {
+	if (2 * count <= m_buckets.size()) {
+		return;
+	}
+
+	std::size_t buckets = 16;
+	while (buckets < 2 * count) {
+		buckets *= 2;
+	}
+	m_entries.reserve(count);
+	rehash(buckets);
+}
+
+template<typename T, typename Allocator>
+void SlotTable<T, Allocator>::clear() noexcept {
+	m_entries.clear();
+	m_buckets.assign(m_buckets.size(), 0);
+}
+
+template<typename T, typename Allocator>
+void SlotTable<T, Allocator>::rehash(std::size_t count) {
+	m_buckets.assign(count, 0);
+	m_shift = 32;
+	for (std::size_t n = count; n > 1; n /= 2) {
+		--m_shift;
+	}
+
+	std::size_t mask = count - 1;
+	for (std::size_t slot = 0; slot < m_entries.size(); ++slot) {
+		std::size_t b = bucket(m_entries[slot].first);
+		while (m_buckets[b] != 0) {
+			b = (b + 1) & mask;
+		}
+		m_buckets[b] = static_cast<std::uint32_t>(slot + 1);
+	}
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include <string>
+#include <vector>
+
+#include "environment.hpp"
+#include "slot_table.hpp"
+
+TEST_CASE( "Test slots stay put as the table grows", "[slot_table]" ) {
+
+  SlotTable<int> table;
+  REQUIRE(table.empty());
+  REQUIRE(table.find(intern("a")) == SlotTable<int>::NO_SLOT);
+  REQUIRE(table.get(intern("a")) == nullptr);
+
+  // enough symbols to rehash the buckets several times
+  std::vector<std::size_t> slots;
+  for (int i = 0; i < 1000; ++i) {
+    slots.push_back(table.set(intern("slot" + std::to_string(i)), i));
+  }
+  REQUIRE(table.size() == 1000);
+
+  for (int i = 0; i < 1000; ++i) {
+    SymbolId sym = intern("slot" + std::to_string(i));
+    REQUIRE(table.find(sym) == slots[i]);
+    REQUIRE(table.holds(slots[i], sym));
+    REQUIRE(table.entry(slots[i]).second == i);
+    REQUIRE(*table.get(sym) == i);
+  }
+
+  // rebinding keeps the slot
+  REQUIRE(table.set(intern("slot7"), -7) == slots[7]);
+  REQUIRE(*table.get(intern("slot7")) == -7);
+  REQUIRE(table.size() == 1000);
+
+  // a slot holding another symbol, or past the end, is not taken for sym's
+  REQUIRE(!table.holds(slots[8], intern("slot7")));
+  REQUIRE(!table.holds(SlotTable<int>::NO_SLOT, intern("slot7")));
+
+  table.clear();
+  REQUIRE(table.empty());
+  REQUIRE(table.find(intern("slot7")) == SlotTable<int>::NO_SLOT);
+  REQUIRE(!table.holds(slots[7], intern("slot7")));
+  REQUIRE(table.set(intern("b"), 2) == 0);
+  REQUIRE(*table.get(intern("b")) == 2);
+}
+
+TEST_CASE( "Test looking symbols up with a slot hint", "[slot_table]" ) {
+
+  Environment env;
+  env.add_exp(Atom("a"), Expression(1));
+
+  Procedure proc = nullptr;
+  std::size_t slot = Environment::NO_SLOT;
+  REQUIRE(*env.find(intern("a"), proc, slot) == Expression(1));
+  REQUIRE(slot != Environment::NO_SLOT);
+
+  // the hint is followed, and still right after the binding changes
+  std::size_t hint = slot;
+  REQUIRE(*env.find(intern("a"), proc, slot) == Expression(1));
+  env.add_exp(Atom("a"), Expression(2));
+  REQUIRE(*env.find(intern("a"), proc, slot) == Expression(2));
+  REQUIRE(slot == hint);
+
+  // a hint for another symbol is checked rather than trusted
+  env.add_exp(Atom("b"), Expression(3));
+  REQUIRE(*env.find(intern("b"), proc, slot) == Expression(3));
+  REQUIRE(slot != hint);
+  REQUIRE(*env.find(intern("a"), proc, slot) == Expression(2));
+  REQUIRE(slot == hint);
+
+  // as is a hint from before a reset
+  env.reset();
+  REQUIRE(env.find(intern("a"), proc, slot) == nullptr);
+  REQUIRE(env.find(intern("+"), proc, slot) == nullptr);
+  REQUIRE(proc == env.get_proc(Atom("+")));
+
+  // a frame's own bindings come before the table the hint is for
+  env.add_exp(Atom("a"), Expression(4));
+  slot = Environment::NO_SLOT;
+  REQUIRE(*env.find(intern("a"), proc, slot) == Expression(4));
+  Environment frame(env, 1);
+  frame.bind(Atom("a"), Expression(5));
+  REQUIRE(*frame.find(intern("a"), proc, slot) == Expression(5));
+  REQUIRE(*env.find(intern("a"), proc, slot) == Expression(4));
+}
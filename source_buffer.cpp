@@ -0,0 +1,78 @@
+#include "source_buffer.hpp"
+
+// system includes
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#define SOURCE_BUFFER_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SourceBuffer::SourceBuffer() : m_data(nullptr), m_size(0), m_mapped(false) {}
+
+SourceBuffer::SourceBuffer(std::string text) : m_text(std::move(text)), m_mapped(false) {
+	m_data = m_text.data();
+	m_size = m_text.size();
+}
+
+SourceBuffer::~SourceBuffer() {
+#ifdef SOURCE_BUFFER_MMAP
+	if (m_mapped) {
+		munmap(const_cast<char *>(m_data), m_size);
+	}
+#endif
+}
+
+const char * SourceBuffer::data() const noexcept {
+	return m_data;
+}
+
+std::size_t SourceBuffer::size() const noexcept {
+	return m_size;
+}
+
+const char * SourceBuffer::end() const noexcept {
+	return m_data + m_size;
+}
+
+std::shared_ptr<const SourceBuffer> read_file(const std::string & filename) {
+
+#ifdef SOURCE_BUFFER_MMAP
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return nullptr;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+		void * addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED) {
+			close(fd);
+			std::shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+			buffer->m_data = static_cast<const char *>(addr);
+			buffer->m_size = info.st_size;
+			buffer->m_mapped = true;
+			return buffer;
+		}
+	}
+	close(fd);
+#endif
+
+	// empty, special or unmappable file: fall back to reading it
+	std::ifstream ifs(filename, std::ios::binary);
+	if (!ifs) {
+		return nullptr;
+	}
+	return read_stream(ifs);
+}
+
+std::shared_ptr<const SourceBuffer> read_stream(std::istream & stream) {
+	std::ostringstream oss;
+	oss << stream.rdbuf();
+	return std::make_shared<const SourceBuffer>(oss.str());
+}
@@ -0,0 +1,91 @@
+/*! \file source_buffer.hpp
+Defines the SourceBuffer type, a contiguous read-only view of program text.
+*/
+#ifndef SOURCE_BUFFER_HPP
+#define SOURCE_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+
+/*! \struct SourceLocation
+\brief A line and column in program text, both counted from 1.
+
+A line of 0 means the location is unknown.
+*/
+struct SourceLocation {
+	SourceLocation() : line(0), column(0) {}
+	SourceLocation(std::uint32_t l, std::uint32_t c) : line(l), column(c) {}
+
+	std::uint32_t line;
+	std::uint32_t column;
+};
+
+/*! \struct SourceSpan
+\brief The stretch of program text an expression was parsed from.
+*/
+struct SourceSpan {
+	SourceLocation begin; ///< first character
+	SourceLocation end; ///< last character
+};
+
+/*! \class SourceBuffer
+\brief A contiguous, immutable block of program text.
+
+The text is either owned as a std::string or, for files on POSIX systems,
+memory-mapped read-only. Tokens produced from a SourceBuffer refer to the
+text by pointer and length, so the buffer must outlive them; TokenSequence
+keeps a shared reference for exactly that reason.
+*/
+class SourceBuffer {
+public:
+
+	/// Construct a buffer owning the given text
+	explicit SourceBuffer(std::string text);
+
+	/// Unmap or release the text
+	~SourceBuffer();
+
+	SourceBuffer(const SourceBuffer &) = delete;
+	SourceBuffer & operator=(const SourceBuffer &) = delete;
+
+	/// pointer to the first character of the text
+	const char * data() const noexcept;
+
+	/// number of characters in the text
+	std::size_t size() const noexcept;
+
+	/// pointer one past the last character of the text
+	const char * end() const noexcept;
+
+private:
+	friend std::shared_ptr<const SourceBuffer> read_file(const std::string & filename);
+
+	// construct an empty buffer, filled in by read_file
+	SourceBuffer();
+
+	std::string m_text;
+	const char * m_data;
+	std::size_t m_size;
+	bool m_mapped;
+};
+
+/*! \fn std::shared_ptr<const SourceBuffer> read_file(const std::string & filename)
+\brief Map (or read) a whole file into a SourceBuffer
+
+\param filename the file to open
+\return the buffer, or nullptr if the file could not be opened
+*/
+std::shared_ptr<const SourceBuffer> read_file(const std::string & filename);
+
+/*! \fn std::shared_ptr<const SourceBuffer> read_stream(std::istream & stream)
+\brief Read a stream until end-of-file into a SourceBuffer
+
+\param stream the input character stream
+\return the buffer holding everything that was read
+*/
+std::shared_ptr<const SourceBuffer> read_stream(std::istream & stream);
+
+#endif
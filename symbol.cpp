@@ -0,0 +1,186 @@
+#include "symbol.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// names of the fixed ids, in SymbolId order
+static const char * const KNOWN_SYMBOL_NAMES[] = {
+	"",
+	"begin", "define", "apply", "map", "lambda", "set-property", "get-property", "continuous-plot",
+	"islist", "continuous_lambda",
+	"pi", "e", "I", "+", "-", "*", "/", "sqrt", "^", "ln", "sin", "cos", "tan",
+	"real", "imag", "mag", "arg", "conj",
+	"list", "first", "rest", "length", "append", "join", "range", "discrete-plot", "memoize", "memo-stats",
+	"object-name", "point", "line", "text", "size", "thickness", "position", "text-scale", "text-rotation",
+};
+
+static_assert(sizeof(KNOWN_SYMBOL_NAMES) / sizeof(KNOWN_SYMBOL_NAMES[0]) == KNOWN_SYMBOL_COUNT,
+	"every fixed symbol id needs a name");
+
+namespace {
+
+// FNV-1a, spread over the index of the symbol table
+std::size_t name_hash(const char * name, std::size_t size) noexcept {
+	std::uint32_t hash = 2166136261u;
+	for (std::size_t i = 0; i < size; ++i) {
+		hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619u;
+	}
+	return hash;
+}
+
+/* The names are stored in fixed-size chunks that never move once allocated,
+so symbol_name can read them without taking the lock: an id only reaches
+a reader after intern has stored its name.
+
+Ids are found by probing an index of ids by the hash of their names, which
+is read without the lock too, so interning a name seen before, e.g. while
+several threads tokenize a program, only reads shared memory. Adding a
+name takes the lock. When the index fills up a bigger one replaces it, and
+the old ones are kept, since a reader may still be probing them; they add
+up to less than the last.
+*/
+class SymbolTable {
+public:
+	static const std::size_t CHUNK_BITS = 12;
+	static const std::size_t CHUNK_SIZE = std::size_t(1) << CHUNK_BITS;
+	static const std::size_t MAX_CHUNKS = std::size_t(1) << 16;
+
+	SymbolTable() : m_count(0) {
+		for (auto & chunk : m_chunks) {
+			chunk.store(nullptr, std::memory_order_relaxed);
+		}
+		grow(256);
+		for (const char * name : KNOWN_SYMBOL_NAMES) {
+			add(name, name_hash(name, std::strlen(name)));
+		}
+	}
+
+	~SymbolTable() {
+		for (auto & chunk : m_chunks) {
+			delete[] chunk.load(std::memory_order_relaxed);
+		}
+	}
+
+	SymbolId intern(const char * name, std::size_t size) {
+		std::size_t hash = name_hash(name, size);
+		SymbolId id;
+		if (find(name, size, hash, id)) {
+			return id;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// another thread may have added it since
+		if (find(name, size, hash, id)) {
+			return id;
+		}
+		return add(std::string(name, size), hash);
+	}
+
+	const std::string & name(SymbolId id) const noexcept {
+		return m_chunks[id >> CHUNK_BITS].load(std::memory_order_acquire)[id & (CHUNK_SIZE - 1)];
+	}
+
+private:
+	// one more than the id in each bucket, 0 for an empty bucket; a power of
+	// two in number, at least twice the number of ids
+	struct Index {
+		std::size_t mask;
+		std::unique_ptr<std::atomic<std::uint32_t>[]> buckets;
+	};
+
+	// find the id of a name in the current index, without the lock
+	bool find(const char * name, std::size_t size, std::size_t hash, SymbolId & id) const noexcept {
+		const Index & index = *m_index.load(std::memory_order_acquire);
+		for (std::size_t b = hash & index.mask;; b = (b + 1) & index.mask) {
+			std::uint32_t bucket = index.buckets[b].load(std::memory_order_acquire);
+			if (bucket == 0) {
+				return false;
+			}
+			const std::string & known = this->name(static_cast<SymbolId>(bucket - 1));
+			if (known.size() == size && std::equal(name, name + size, known.begin())) {
+				id = static_cast<SymbolId>(bucket - 1);
+				return true;
+			}
+		}
+	}
+
+	// put id in index, with the lock held
+	static void insert(Index & index, std::size_t hash, SymbolId id) noexcept {
+		std::size_t b = hash & index.mask;
+		while (index.buckets[b].load(std::memory_order_relaxed) != 0) {
+			b = (b + 1) & index.mask;
+		}
+		index.buckets[b].store(id + 1, std::memory_order_release);
+	}
+
+	// replace the index with one of size buckets, with the lock held (or
+	// during construction)
+	void grow(std::size_t size) {
+		std::unique_ptr<Index> index(new Index{ size - 1, std::unique_ptr<std::atomic<std::uint32_t>[]>(new std::atomic<std::uint32_t>[size]) });
+		for (std::size_t b = 0; b < size; ++b) {
+			index->buckets[b].store(0, std::memory_order_relaxed);
+		}
+		for (std::size_t id = 0; id < m_count; ++id) {
+			const std::string & known = name(static_cast<SymbolId>(id));
+			insert(*index, name_hash(known.data(), known.size()), static_cast<SymbolId>(id));
+		}
+		m_index.store(index.get(), std::memory_order_release);
+		m_indexes.push_back(std::move(index));
+	}
+
+	// store a new name, with the lock held (or during construction)
+	SymbolId add(std::string name, std::size_t hash) {
+		if (m_count == CHUNK_SIZE * MAX_CHUNKS) {
+			throw std::length_error("too many distinct symbols");
+		}
+
+		std::string * chunk = m_chunks[m_count >> CHUNK_BITS].load(std::memory_order_relaxed);
+		if (chunk == nullptr) {
+			chunk = new std::string[CHUNK_SIZE];
+		}
+		chunk[m_count & (CHUNK_SIZE - 1)] = std::move(name);
+		m_chunks[m_count >> CHUNK_BITS].store(chunk, std::memory_order_release);
+
+		SymbolId id = static_cast<SymbolId>(m_count++);
+		Index & index = *m_index.load(std::memory_order_relaxed);
+		if (2 * m_count > index.mask + 1) {
+			grow(2 * (index.mask + 1));
+		}
+		else {
+			insert(index, hash, id);
+		}
+		return id;
+	}
+
+	std::mutex m_mutex;
+	std::atomic<std::string *> m_chunks[MAX_CHUNKS];
+	std::size_t m_count;
+
+	// the index readers probe, and every index made, the last being the current
+	std::atomic<Index *> m_index;
+	std::vector<std::unique_ptr<Index> > m_indexes;
+};
+
+SymbolTable & table() {
+	static SymbolTable symbols;
+	return symbols;
+}
+
+}
+
+SymbolId intern(const char * name, std::size_t size) {
+	return table().intern(name, size);
+}
+
+SymbolId intern(const std::string & name) {
+	return table().intern(name.data(), name.size());
+}
+
+const std::string & symbol_name(SymbolId id) noexcept {
+	return table().name(id);
+}
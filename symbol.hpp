@@ -0,0 +1,118 @@
+/*! \file symbol.hpp
+Defines symbol ids and the process-wide table interning symbol names.
+ */
+#ifndef SYMBOL_HPP
+#define SYMBOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*! \enum SymbolId
+\brief A small integer standing for a symbol name.
+
+Every distinct name is interned once per process and keeps its id for
+the life of the process, so two symbols are equal exactly when their ids
+are. The special forms, built-in names and graphics property names have
+the fixed ids listed here; any other name gets the next free id the first
+time it is interned.
+ */
+enum SymbolId : std::uint32_t {
+	SYM_EMPTY, ///< the empty name ""
+
+	// special forms
+	SYM_BEGIN,
+	SYM_DEFINE,
+	SYM_APPLY,
+	SYM_MAP,
+	SYM_LAMBDA,
+	SYM_SET_PROPERTY,
+	SYM_GET_PROPERTY,
+	SYM_CONTINUOUS_PLOT,
+
+	// heads the interpreter builds for itself
+	SYM_ISLIST,
+	SYM_CONTINUOUS_LAMBDA,
+
+	// built-in values and procedures
+	SYM_PI,
+	SYM_E,
+	SYM_I,
+	SYM_ADD,
+	SYM_SUB,
+	SYM_MUL,
+	SYM_DIV,
+	SYM_SQRT,
+	SYM_POW,
+	SYM_LN,
+	SYM_SIN,
+	SYM_COS,
+	SYM_TAN,
+	SYM_REAL,
+	SYM_IMAG,
+	SYM_MAG,
+	SYM_ARG,
+	SYM_CONJ,
+	SYM_LIST,
+	SYM_FIRST,
+	SYM_REST,
+	SYM_LENGTH,
+	SYM_APPEND,
+	SYM_JOIN,
+	SYM_RANGE,
+	SYM_DISCRETE_PLOT,
+	SYM_MEMOIZE,
+	SYM_MEMO_STATS,
+
+	// graphics property names and values
+	SYM_OBJECT_NAME,
+	SYM_POINT,
+	SYM_LINE,
+	SYM_TEXT,
+	SYM_SIZE,
+	SYM_THICKNESS,
+	SYM_POSITION,
+	SYM_TEXT_SCALE,
+	SYM_TEXT_ROTATION,
+
+	KNOWN_SYMBOL_COUNT ///< not a symbol, the number of fixed ids
+};
+
+/*! \struct SymbolHash
+\brief Hash function object for using SymbolId as an unordered container key.
+ */
+struct SymbolHash {
+	std::size_t operator()(SymbolId id) const noexcept {
+		return static_cast<std::size_t>(id);
+	}
+};
+
+/*! \fn intern
+\brief Find the id of a symbol name, adding the name if it is new
+
+\param name the first character of the name
+\param size the number of characters
+\return the id of the name
+
+Safe to call from any thread. Finding a name that is already interned
+takes no lock.
+ */
+SymbolId intern(const char * name, std::size_t size);
+
+/*! \fn intern
+\brief Find the id of a symbol name, adding the name if it is new
+
+\param name the name
+\return the id of the name
+ */
+SymbolId intern(const std::string & name);
+
+/*! \fn symbol_name
+\brief The name a symbol id stands for
+
+\param id an id returned by intern, or a fixed id
+\return the name, valid for the life of the process
+ */
+const std::string & symbol_name(SymbolId id) noexcept;
+
+#endif
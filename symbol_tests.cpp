@@ -0,0 +1,75 @@
+#include "catch.hpp"
+
+#include "symbol.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE( "Test symbol interning", "[symbol]" ) {
+
+  // fixed ids name what they say
+  REQUIRE(symbol_name(SYM_EMPTY) == "");
+  REQUIRE(symbol_name(SYM_BEGIN) == "begin");
+  REQUIRE(symbol_name(SYM_CONTINUOUS_PLOT) == "continuous-plot");
+  REQUIRE(symbol_name(SYM_DISCRETE_PLOT) == "discrete-plot");
+  REQUIRE(symbol_name(SYM_TEXT_ROTATION) == "text-rotation");
+  REQUIRE(intern("lambda") == SYM_LAMBDA);
+  REQUIRE(intern("+") == SYM_ADD);
+
+  // new names get new ids, the same name always the same id
+  SymbolId a = intern("a-fresh-symbol");
+  REQUIRE(a >= KNOWN_SYMBOL_COUNT);
+  REQUIRE(intern(std::string("a-fresh-symbol")) == a);
+  REQUIRE(intern("a-fresh-symbol-too") != a);
+  REQUIRE(symbol_name(a) == "a-fresh-symbol");
+
+  const char text[] = "prefix";
+  REQUIRE(intern(text, 3) == intern("pre"));
+}
+
+TEST_CASE( "Test symbol interning from several threads", "[symbol]" ) {
+
+  const int count = 5000;
+  std::vector<std::vector<SymbolId>> ids(4, std::vector<SymbolId>(count));
+
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < ids.size(); ++t) {
+    threads.emplace_back([&ids, t, count] {
+      for (int i = 0; i < count; ++i) {
+        ids[t][i] = intern("threaded" + std::to_string(i));
+      }
+    });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+
+  for (int i = 0; i < count; ++i) {
+    for (std::size_t t = 1; t < ids.size(); ++t) {
+      REQUIRE(ids[t][i] == ids[0][i]);
+    }
+    REQUIRE(symbol_name(ids[0][i]) == "threaded" + std::to_string(i));
+  }
+}
+
+TEST_CASE( "Test interning names interned before", "[symbol]" ) {
+
+  // enough names to replace the index several times
+  const int count = 10000;
+  std::vector<SymbolId> ids;
+  for (int i = 0; i < count; ++i) {
+    ids.push_back(intern("again" + std::to_string(i)));
+  }
+  for (int round = 0; round < 2; ++round) {
+    for (int i = count - 1; i >= 0; --i) {
+      REQUIRE(intern("again" + std::to_string(i)) == ids[i]);
+    }
+  }
+
+  // a name is not taken for its prefixes, nor the empty name
+  REQUIRE(intern("again1", 5) == intern("again"));
+  REQUIRE(intern("again1", 5) != ids[1]);
+  REQUIRE(intern("", 0) == SYM_EMPTY);
+  REQUIRE(intern("again1") == ids[1]);
+}
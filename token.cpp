@@ -2,6 +2,9 @@
 
 // system includes
 #include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 
 // define constants for special characters
@@ -10,11 +13,26 @@ const char CLOSECHAR = ')';
 const char COMMENTCHAR = ';';
 const char STRCHAR = '\"';
 
-Token::Token(TokenType t) : m_type(t) {}
+Token::Token(TokenType t) : m_text(nullptr), m_size(0), m_type(t) {}
 
-Token::Token(const std::string & sym) : m_type(SYM), value(sym) {}
+Token::Token(const std::string & sym) : m_owned(std::make_shared<const std::string>(sym)), m_type(SYM) {
+	m_text = m_owned->data();
+	m_size = m_owned->size();
+	classify();
+}
+
+Token::Token(const std::string & str, bool thing) : m_owned(std::make_shared<const std::string>(str)), m_type(STR), string(thing) {
+	m_text = m_owned->data();
+	m_size = m_owned->size();
+	classify();
+}
 
-Token::Token(const std::string & str, bool thing) : m_type(STR), value(str), string(thing) {};
+Token::Token(TokenType t, const SourceLocation & location) : m_text(nullptr), m_size(0), m_type(t), m_location(location) {}
+
+Token::Token(TokenType t, const char * text, std::size_t size, const SourceLocation & location)
+	: m_text(text), m_size(size), m_type(t), m_location(location) {
+	classify();
+}
 
 Token::TokenType Token::type() const {
 	return m_type;
@@ -27,47 +45,331 @@ std::string Token::asString() const {
 	case CLOSE:
 		return ")";
 	case SYM:
-		return value;
+		return std::string(m_text, m_size);
 	case STR:
 		return "\"";
 	}
 	return "";
 }
 
-// add token to sequence unless it is empty, clears token
-void store_ifnot_empty(std::string & token, TokenSequenceType & seq) {
-	if (!token.empty()) {
-		seq.emplace_back(token);
-		token.clear();
+const char * Token::text() const noexcept {
+	return m_text;
+}
+
+std::size_t Token::size() const noexcept {
+	return m_size;
+}
+
+Token::LiteralType Token::literal() const noexcept {
+	return m_literal;
+}
+
+double Token::number() const noexcept {
+	return m_number;
+}
+
+const SourceLocation & Token::location() const noexcept {
+	return m_location;
+}
+
+void Token::classify() noexcept {
+	if (m_size == 0) return;
+
+	const char * begin = m_text;
+	const char * end = m_text + m_size;
+
+	// leading white-space is skipped, as operator>> would; only the value
+	// of a quoted token can hold any
+	while (begin != end && isspace(static_cast<unsigned char>(*begin))) {
+		++begin;
+	}
+
+	const char * stop = parse_number(begin, end, m_number);
+	if (stop == end) {
+		m_literal = NUMBER;
+		return;
+	}
+
+	m_number = 0;
+	if (stop != nullptr || isdigit(static_cast<unsigned char>(m_text[0]))) {
+		// a number followed by junk, or a symbol starting with a digit
+		m_literal = INVALID;
+	}
+}
+
+// powers of ten that are exactly representable as a double
+static const double EXACT_POWERS_OF_TEN[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// significant digits that can decide how a decimal rounds to a double;
+// any further digits only matter as to whether they are all zero
+const int MAX_SIGNIFICANT_DIGITS = 770;
+
+const char * parse_number(const char * begin, const char * end, double & value) noexcept {
+
+	const char * p = begin;
+
+	bool negative = false;
+	if (p != end && (*p == '+' || *p == '-')) {
+		negative = (*p == '-');
+		++p;
+	}
+
+	// significant digits without leading zeros, worth 10^exponent in the
+	// last place; truncated records dropping a non-zero digit
+	char digits[MAX_SIGNIFICANT_DIGITS + 16];
+	int ndigits = 0;
+	int exponent = 0;
+	bool truncated = false;
+	bool seen_digit = false;
+	bool fraction = false;
+
+	for (; p != end; ++p) {
+		char c = *p;
+		if (c == '.' && !fraction) {
+			fraction = true;
+			continue;
+		}
+		if (!isdigit(static_cast<unsigned char>(c))) {
+			break;
+		}
+
+		seen_digit = true;
+		if (c == '0' && ndigits == 0) {
+			if (fraction) --exponent;
+		}
+		else if (ndigits < MAX_SIGNIFICANT_DIGITS) {
+			digits[ndigits++] = c;
+			if (fraction) --exponent;
+		}
+		else {
+			if (!fraction) ++exponent;
+			truncated = truncated || (c != '0');
+		}
+	}
+
+	if (!seen_digit) {
+		return nullptr;
+	}
+
+	if (p != end && (*p == 'e' || *p == 'E')) {
+		const char * e = p + 1;
+		bool negative_exponent = false;
+		if (e != end && (*e == '+' || *e == '-')) {
+			negative_exponent = (*e == '-');
+			++e;
+		}
+		// a dangling exponent marker makes the whole literal invalid
+		if (e == end || !isdigit(static_cast<unsigned char>(*e))) {
+			return nullptr;
+		}
+
+		int written = 0;
+		for (; e != end && isdigit(static_cast<unsigned char>(*e)); ++e) {
+			if (written < 100000) {
+				written = written * 10 + (*e - '0');
+			}
+		}
+		exponent += negative_exponent ? -written : written;
+		p = e;
+	}
+
+	if (ndigits == 0) {
+		value = negative ? -0.0 : 0.0;
+		return p;
+	}
+
+	if (!truncated) {
+		while (digits[ndigits - 1] == '0') {
+			--ndigits;
+			++exponent;
+		}
+
+		// fast path: both the digits and the power of ten are exact doubles,
+		// so a single IEEE operation rounds correctly
+		if (ndigits <= 19 && exponent >= -22 && exponent <= 22) {
+			std::uint64_t mantissa = 0;
+			for (int i = 0; i < ndigits; ++i) {
+				mantissa = mantissa * 10 + (digits[i] - '0');
+			}
+			if (mantissa <= (std::uint64_t(1) << 53)) {
+				double result = static_cast<double>(mantissa);
+				if (exponent < 0) {
+					result /= EXACT_POWERS_OF_TEN[-exponent];
+				}
+				else {
+					result *= EXACT_POWERS_OF_TEN[exponent];
+				}
+				value = negative ? -result : result;
+				return p;
+			}
+		}
+	}
+
+	// out of range either way, whatever the digits
+	if (ndigits + exponent > 310) {
+		return nullptr;
+	}
+	if (ndigits + exponent < -400) {
+		value = negative ? -0.0 : 0.0;
+		return p;
+	}
+
+	// slow path: hand strtod the digits as an integer with an exponent.
+	// There is no decimal point in the text, so the locale cannot matter.
+	if (truncated) {
+		digits[ndigits++] = '1';
+		--exponent;
+	}
+	digits[ndigits++] = 'e';
+	if (exponent < 0) {
+		digits[ndigits++] = '-';
+		exponent = -exponent;
+	}
+	char reversed[12];
+	int nexp = 0;
+	do {
+		reversed[nexp++] = '0' + exponent % 10;
+		exponent /= 10;
+	} while (exponent > 0);
+	while (nexp > 0) {
+		digits[ndigits++] = reversed[--nexp];
+	}
+	digits[ndigits] = '\0';
+
+	double result = std::strtod(digits, nullptr);
+	if (std::isinf(result)) {
+		return nullptr;
+	}
+
+	value = negative ? -result : result;
+	return p;
+}
+
+TokenSequence::TokenSequence() {}
+
+TokenSequence::TokenSequence(std::shared_ptr<const SourceBuffer> source) : m_source(std::move(source)) {}
+
+void TokenSequence::push_back(const Token & token) {
+	m_tokens.push_back(token);
+}
+
+void TokenSequence::reserve(std::size_t count) {
+	m_tokens.reserve(count);
+}
+
+std::size_t TokenSequence::size() const noexcept {
+	return m_tokens.size();
+}
+
+bool TokenSequence::empty() const noexcept {
+	return m_tokens.empty();
+}
+
+const Token & TokenSequence::operator[](std::size_t i) const {
+	return m_tokens[i];
+}
+
+const Token & TokenSequence::front() const {
+	return m_tokens.front();
+}
+
+const Token & TokenSequence::back() const {
+	return m_tokens.back();
+}
+
+TokenSequence::const_iterator TokenSequence::begin() const noexcept {
+	return m_tokens.begin();
+}
+
+TokenSequence::const_iterator TokenSequence::end() const noexcept {
+	return m_tokens.end();
+}
+
+const std::shared_ptr<const SourceBuffer> & TokenSequence::source() const noexcept {
+	return m_source;
+}
+
+// add the symbol slice [start, stop) found at location to sequence unless it is empty
+static void store_ifnot_empty(const char * start, const char * stop, const SourceLocation & location, TokenSequenceType & seq) {
+	if (start != stop) {
+		seq.emplace_back(Token::SYM, start, stop - start, location);
 	}
 }
 
+SourceLocation advance_location(SourceLocation location, const char * begin, const char * end) noexcept {
+	for (const char * c = begin; c != end; ++c) {
+		if (*c == '\n') {
+			++location.line;
+			location.column = 1;
+		}
+		else {
+			++location.column;
+		}
+	}
+	return location;
+}
+
 TokenSequenceType tokenize(std::istream & seq) {
-	TokenSequenceType tokens;
-	std::string token;
+	return tokenize(read_stream(seq));
+}
+
+TokenSequenceType tokenize(std::shared_ptr<const SourceBuffer> source) {
+	const char * begin = source->data();
+	const char * end = source->end();
+
+	return tokenize(std::move(source), begin, end, SourceLocation(1, 1));
+}
+
+TokenSequenceType tokenize(std::shared_ptr<const SourceBuffer> source, const char * begin, const char * end, SourceLocation start) {
+	TokenSequenceType tokens(std::move(source));
+
+	const char * c = begin;
+
+	// the location of c is (line, c - line_start + column_base)
+	std::uint32_t line = start.line;
+	const char * line_start = begin;
+	std::uint32_t column_base = start.column;
+
+	// start of the symbol currently being scanned, and its location
+	const char * token = c;
+	SourceLocation token_at = start;
 	int is_inside_quote = 0;
-	while (true) {
-		char c = seq.get();
-		if (seq.eof()) break;
-
-		if (c == COMMENTCHAR) {
-			// chomp until the end of the line
-			while ((!seq.eof()) && (c != '\n')) {
-				c = seq.get();
+
+	// rough guess at the token count, the sequence still grows if needed
+	tokens.reserve((end - begin) / 8 + 1);
+
+	while (c != end) {
+		SourceLocation here(line, static_cast<std::uint32_t>(c - line_start) + column_base);
+
+		if (*c == COMMENTCHAR) {
+			// a comment ends the current token, then chomp until the end of the line
+			store_ifnot_empty(token, c, token_at, tokens);
+			while (c != end && *c != '\n') {
+				++c;
+			}
+			if (c == end) {
+				token = c;
+				break;
 			}
-			if (seq.eof()) break;
+			token = c + 1;
 		}
-		else if (c == OPENCHAR) {
-			store_ifnot_empty(token, tokens);
-			tokens.push_back(Token::TokenType::OPEN);
+		else if (*c == OPENCHAR) {
+			store_ifnot_empty(token, c, token_at, tokens);
+			tokens.emplace_back(Token::OPEN, here);
+			token = c + 1;
 		}
-		else if (c == CLOSECHAR) {
-			store_ifnot_empty(token, tokens);
-			tokens.push_back(Token::TokenType::CLOSE);
+		else if (*c == CLOSECHAR) {
+			store_ifnot_empty(token, c, token_at, tokens);
+			tokens.emplace_back(Token::CLOSE, here);
+			token = c + 1;
 		}
-		else if (c == STRCHAR) {
-			store_ifnot_empty(token, tokens);
-			tokens.push_back(Token::TokenType::STR);
+		else if (*c == STRCHAR) {
+			store_ifnot_empty(token, c, token_at, tokens);
+			tokens.emplace_back(Token::STR, here);
+			token = c + 1;
 			if (is_inside_quote == 0) {
 				is_inside_quote = 1;
 			}
@@ -75,14 +377,22 @@ TokenSequenceType tokenize(std::istream & seq) {
 				is_inside_quote = 0;
 			}
 		}
-		else if (isspace(c) && is_inside_quote != 1) {
-			store_ifnot_empty(token, tokens);
+		else if (isspace(static_cast<unsigned char>(*c)) && is_inside_quote != 1) {
+			store_ifnot_empty(token, c, token_at, tokens);
+			token = c + 1;
 		}
-		else {
-			token.push_back(c);
+
+		if (*c == '\n') {
+			++line;
+			line_start = c + 1;
+			column_base = 1;
+		}
+		++c;
+		if (token == c) {
+			token_at = SourceLocation(line, static_cast<std::uint32_t>(c - line_start) + column_base);
 		}
 	}
-	store_ifnot_empty(token, tokens);
+	store_ifnot_empty(token, c, token_at, tokens);
 
 	return tokens;
 }
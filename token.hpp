@@ -5,14 +5,22 @@ Defines the Token and TokenSequence types, and associated functions.
 #define TOKEN_HPP
 
 #include <complex>
-#include <deque>
+#include <cstddef>
 #include <istream>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "source_buffer.hpp"
+
 /*! \class Token
 \brief Value class representing a token.
 
 A token is a composition of a tag type and an optional string value.
+
+Tokens produced by tokenize are slices: they point into the SourceBuffer
+held by their TokenSequence and own no memory of their own. Tokens built
+directly from a std::string keep a shared copy of the text instead.
 */
 class Token {
 public:
@@ -27,6 +35,15 @@ public:
 		STR, //< string tag, aka '\"'
 	};
 
+	/*! \enum LiteralType
+	\brief how the value of a SYM token reads, decided when it is created.
+	*/
+	enum LiteralType {
+		SYMBOL,  //< not a number, names a symbol
+		NUMBER,  //< a numeric literal, see number()
+		INVALID, //< neither, e.g. "1abc" or "1e400"
+	};
+
 	/// construct a token of type t (if string default to empty value)
 	Token(TokenType t);
 
@@ -36,22 +53,124 @@ public:
 	/// construct a token of type String with value
 	Token(const std::string & str, bool thing);
 
+	/// construct a token of type t found at location
+	Token(TokenType t, const SourceLocation & location);
+
+	/// construct a token of type t viewing size characters at text (not owned)
+	Token(TokenType t, const char * text, std::size_t size, const SourceLocation & location = SourceLocation());
+
 	/// return the type of the token
 	TokenType type() const;
 
 	/// return the token rendered as a string
 	std::string asString() const;
+
+	/// pointer to the characters of a SYM token's value
+	const char * text() const noexcept;
+
+	/// number of characters in a SYM token's value
+	std::size_t size() const noexcept;
+
+	/// how a SYM token's value reads as a literal
+	LiteralType literal() const noexcept;
+
+	/// the value of a NUMBER literal, 0 otherwise
+	double number() const noexcept;
+
+	/// where the token starts in the program text, line 0 if unknown
+	const SourceLocation & location() const noexcept;
+
 private:
+	const char * m_text;
+	std::shared_ptr<const std::string> m_owned;
+	std::size_t m_size;
+	double m_number = 0;
 	TokenType m_type;
-	std::string value;
+	LiteralType m_literal = SYMBOL;
 	bool string = false;
+	SourceLocation m_location;
+
+	// classify the value of a SYM token
+	void classify() noexcept;
+};
+
+/*! \class TokenSequence
+\brief A flat, contiguous sequence of tokens over one SourceBuffer.
+
+The sequence keeps its SourceBuffer alive so the token slices stay valid
+for as long as the sequence (or a copy of it) exists.
+*/
+class TokenSequence {
+public:
+	typedef std::vector<Token>::const_iterator const_iterator;
+
+	/// construct an empty sequence with no source
+	TokenSequence();
+
+	/// construct an empty sequence whose tokens will slice source
+	explicit TokenSequence(std::shared_ptr<const SourceBuffer> source);
+
+	/// append a token
+	void push_back(const Token & token);
+
+	/// construct a token in place at the end
+	template<typename... Args>
+	void emplace_back(Args &&... args) {
+		m_tokens.emplace_back(std::forward<Args>(args)...);
+	}
+
+	/// reserve room for count tokens
+	void reserve(std::size_t count);
+
+	/// number of tokens
+	std::size_t size() const noexcept;
+
+	/// true if there are no tokens
+	bool empty() const noexcept;
+
+	/// the token at index i
+	const Token & operator[](std::size_t i) const;
+
+	/// the first token
+	const Token & front() const;
+
+	/// the last token
+	const Token & back() const;
+
+	/// iterator to the first token
+	const_iterator begin() const noexcept;
+
+	/// iterator past the last token
+	const_iterator end() const noexcept;
+
+	/// the buffer the tokens slice, may be null
+	const std::shared_ptr<const SourceBuffer> & source() const noexcept;
+
+private:
+	std::shared_ptr<const SourceBuffer> m_source;
+	std::vector<Token> m_tokens;
 };
 
 /*! \typedef TokenSequenceType
-Define the token sequence using a std container. Any supporting
-sequential access should do.
+Define the token sequence as a flat contiguous array of token slices.
+*/
+typedef TokenSequence TokenSequenceType;
+
+/*! \fn const char * parse_number(const char * begin, const char * end, double & value)
+\brief Read a decimal floating point number from the front of some text
+
+\param begin the first character to read
+\param end one past the last character available
+\param value set to the number read
+\return one past the last character of the number, or nullptr if the text
+does not start with a valid, finite number
+
+Accepts an optional sign, digits with an optional '.', and an optional
+exponent, the same grammar operator>> reads for a double in the C locale.
+The result is correctly rounded, does not depend on the global locale and
+does not allocate.
 */
-typedef std::deque<Token> TokenSequenceType;
+const char * parse_number(const char * begin, const char * end, double & value) noexcept;
 
 /*! \fn TokenSequenceType tokenize(std::istream & seq)
 \brief Split a stream into a sequnce of tokens
@@ -63,7 +182,41 @@ Split a stream into a sequnce of tokens where a token is one of
 OPEN or CLOSE or any space-delimited string
 
 Ignores any whitespace and comments (from any ";" to end-of-line).
+
+The stream is read to the end into a single buffer first; see the
+SourceBuffer overload.
 */
 TokenSequenceType tokenize(std::istream & seq);
 
+/*! \fn TokenSequenceType tokenize(std::shared_ptr<const SourceBuffer> source)
+\brief Split a whole buffer into a sequence of tokens
+
+\param source the buffer holding the program text
+\return The sequence of tokens, each a slice of source
+
+Scans the buffer once, without copying any token text.
+*/
+TokenSequenceType tokenize(std::shared_ptr<const SourceBuffer> source);
+
+/*! \fn TokenSequenceType tokenize(std::shared_ptr<const SourceBuffer> source, const char * begin, const char * end, SourceLocation start)
+\brief Split part of a buffer into a sequence of tokens
+
+\param source the buffer holding the program text
+\param begin first character to tokenize, inside source
+\param end one past the last character to tokenize, inside source
+\param start the line and column of begin in the program
+\return The sequence of tokens, each a slice of source
+*/
+TokenSequenceType tokenize(std::shared_ptr<const SourceBuffer> source, const char * begin, const char * end, SourceLocation start);
+
+/*! \fn SourceLocation advance_location(SourceLocation location, const char * begin, const char * end)
+\brief Find where the text following some program text starts
+
+\param location the line and column of begin
+\param begin first character of the text
+\param end one past the last character of the text
+\return the line and column of end
+*/
+SourceLocation advance_location(SourceLocation location, const char * begin, const char * end) noexcept;
+
 #endif
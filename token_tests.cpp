@@ -2,6 +2,10 @@
 
 #include "token.hpp"
 
+#include <cstdlib>
+#include <string>
+#include <vector>
+
 TEST_CASE( "Test Token creation", "[token]" ) {
 
   Token tko(Token::OPEN);
@@ -30,46 +34,170 @@ TEST_CASE( "Test tokenize", "[token]" ) {
   std::istringstream iss(input);
 
   TokenSequenceType tokens = tokenize(iss);
+  std::size_t i = 0;
 
-  REQUIRE(tokens.front().type() == Token::OPEN);
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::OPEN);
+  ++i;
   
-  REQUIRE(tokens.front().type() == Token::SYM);
-  REQUIRE(tokens.front().asString() == "A");
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::SYM);
+  REQUIRE(tokens[i].asString() == "A");
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::SYM);
-  REQUIRE(tokens.front().asString() == "a");
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::SYM);
+  REQUIRE(tokens[i].asString() == "a");
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::SYM);
-  REQUIRE(tokens.front().asString() == "aa");
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::SYM);
+  REQUIRE(tokens[i].asString() == "aa");
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::CLOSE);
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::CLOSE);
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::SYM);
-  REQUIRE(tokens.front().asString() == "aal");
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::SYM);
+  REQUIRE(tokens[i].asString() == "aal");
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::OPEN);
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::OPEN);
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::SYM);
-  REQUIRE(tokens.front().asString() == "aalii");
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::SYM);
+  REQUIRE(tokens[i].asString() == "aalii");
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::CLOSE);
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::CLOSE);
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::CLOSE);
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::CLOSE);
+  ++i;
 
-  REQUIRE(tokens.front().type() == Token::SYM);
-  REQUIRE(tokens.front().asString() == "3");
-  tokens.pop_front();
+  REQUIRE(tokens[i].type() == Token::SYM);
+  REQUIRE(tokens[i].asString() == "3");
+  ++i;
 
-  REQUIRE(tokens.empty());
+  REQUIRE(i == tokens.size());
 }
 
+
+TEST_CASE( "Test tokenize slices a buffer", "[token]" ) {
+  std::shared_ptr<const SourceBuffer> source =
+    std::make_shared<const SourceBuffer>("(define x 12);note\n(\"a b\" y)");
+
+  TokenSequenceType tokens = tokenize(source);
+
+  REQUIRE(tokens.size() == 11);
+  REQUIRE(tokens.source() == source);
+
+  // symbol tokens point into the buffer rather than owning a copy
+  REQUIRE(tokens[1].type() == Token::SYM);
+  REQUIRE(tokens[1].text() == source->data() + 1);
+  REQUIRE(tokens[1].size() == 6);
+  REQUIRE(tokens[3].asString() == "12");
+
+  // a comment ends the token before it
+  REQUIRE(tokens[4].type() == Token::CLOSE);
+  REQUIRE(tokens[5].type() == Token::OPEN);
+
+  // white-space inside quotes is kept
+  REQUIRE(tokens[6].type() == Token::STR);
+  REQUIRE(tokens[7].asString() == "a b");
+  REQUIRE(tokens[8].type() == Token::STR);
+  REQUIRE(tokens[9].asString() == "y");
+  REQUIRE(tokens[10].type() == Token::CLOSE);
+
+  // including one that runs straight on from a symbol
+  std::shared_ptr<const SourceBuffer> symbols =
+    std::make_shared<const SourceBuffer>("abc;note\ndef");
+  TokenSequenceType split = tokenize(symbols);
+  REQUIRE(split.size() == 2);
+  REQUIRE(split[0].type() == Token::SYM);
+  REQUIRE(split[0].asString() == "abc");
+  REQUIRE(split[1].type() == Token::SYM);
+  REQUIRE(split[1].asString() == "def");
+}
+
+TEST_CASE( "Test tokens record their location", "[token]" ) {
+  std::shared_ptr<const SourceBuffer> source =
+    std::make_shared<const SourceBuffer>("(define x 12) ; note\n  (\"a b\"\n  y)");
+
+  TokenSequenceType tokens = tokenize(source);
+
+  REQUIRE(tokens.size() == 11);
+  REQUIRE(tokens[0].location().line == 1);
+  REQUIRE(tokens[0].location().column == 1);
+  REQUIRE(tokens[3].location().line == 1);
+  REQUIRE(tokens[3].location().column == 11);
+  REQUIRE(tokens[5].location().line == 2);
+  REQUIRE(tokens[5].location().column == 3);
+  REQUIRE(tokens[7].location().column == 5);
+  REQUIRE(tokens[9].location().line == 3);
+  REQUIRE(tokens[9].location().column == 3);
+  REQUIRE(tokens[10].location().column == 4);
+
+  // part of a buffer, starting mid-program
+  TokenSequenceType tail = tokenize(source, source->data() + 23, source->end(), SourceLocation(2, 3));
+  REQUIRE(tail[0].type() == Token::OPEN);
+  REQUIRE(tail[0].location().line == 2);
+  REQUIRE(tail[0].location().column == 3);
+  REQUIRE(tail[4].location().line == 3);
+
+  SourceLocation end = advance_location(SourceLocation(1, 1), source->data(), source->end());
+  REQUIRE(end.line == 3);
+  REQUIRE(end.column == 5);
+}
+
+TEST_CASE( "Test tokens classify numeric literals", "[token]" ) {
+
+  std::vector<std::string> numbers = {"1", "+1", "-1", ".5", "1.", "-.5e-3", "1e-5", "1E5",
+                                      "00012", "-0", "1e-400", "0.1e1"};
+  for (auto & n : numbers) {
+    INFO(n);
+    Token t(n);
+    REQUIRE(t.literal() == Token::NUMBER);
+    REQUIRE(t.number() == std::strtod(n.c_str(), nullptr));
+  }
+
+  std::vector<std::string> symbols = {"e5", "+", "-", "+.", "inf", "nan", "-1e", "-1e400", "+-1"};
+  for (auto & s : symbols) {
+    INFO(s);
+    REQUIRE(Token(s).literal() == Token::SYMBOL);
+  }
+
+  std::vector<std::string> invalid = {"1e", "1e+", "1e5.3", "1abc", "+1abc", ".5x", "0x10", "1e400", "1.2.3", "1.."};
+  for (auto & s : invalid) {
+    INFO(s);
+    REQUIRE(Token(s).literal() == Token::INVALID);
+  }
+}
+
+TEST_CASE( "Test parse_number rounds correctly", "[token]" ) {
+
+  std::vector<std::string> cases = {
+    "0.1", "0.3", "9007199254740993", "9007199254740992.5",
+    "2.2250738585072011e-308", "2.2250738585072014e-308", "4.9406564584124654e-324",
+    "1.7976931348623157e308", "123456789012345678901234567890", "1e23", "8.589973e9",
+    "0.000000000000000000000000000000000000000000001",
+    // halfway between two doubles, decided only by the final digit
+    "9007199254740993.0000000000000000000000000000000000000000000000000000000000000000000001"
+  };
+
+  // long literals force the digit-truncation path
+  cases.push_back("1." + std::string(900, '0') + "1");
+  cases.push_back("0." + std::string(800, '9'));
+  cases.push_back(std::string(300, '7'));
+
+  std::srand(3574);
+  for (int i = 0; i < 2000; ++i) {
+    std::string s = std::to_string(std::rand()) + "." + std::to_string(std::rand()) +
+      "e" + std::to_string(std::rand() % 600 - 300);
+    cases.push_back(s);
+  }
+
+  for (auto & c : cases) {
+    INFO(c);
+    double value = -1;
+    const char * end = c.data() + c.size();
+    REQUIRE(parse_number(c.data(), end, value) == end);
+    REQUIRE(value == std::strtod(c.c_str(), nullptr));
+  }
+}
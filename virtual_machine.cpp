@@ -0,0 +1,412 @@
+#include "virtual_machine.hpp"
+
+#include <cstdint>
+
+#include "memo_cache.hpp"
+#include "packed_list.hpp"
+#include "semantic_error.hpp"
+
+VirtualMachine::VirtualMachine(const VirtualMachine &) {}
+
+VirtualMachine & VirtualMachine::operator=(const VirtualMachine & other) {
+	if (this != &other) {
+		forget();
+	}
+	return *this;
+}
+
+Expression VirtualMachine::evaluate(const Expression & exp, Environment & env) {
+	Chunk chunk = compile(exp);
+	return run(chunk, env);
+}
+
+Expression VirtualMachine::run(const Chunk & chunk, Environment & env) {
+	// a previous run may have stopped at an error part way through
+	m_stack.clear();
+	m_bindings.clear();
+	m_frames.clear();
+	m_keys.clear();
+	if (m_bodies.size() > MAX_CACHED_BODIES) {
+		forget();
+	}
+
+	m_env = &env;
+	++m_version;
+	m_frames.push_back(Frame{ &chunk, 0, 0, 0, false, nullptr });
+	execute(0);
+
+	Expression result = std::move(m_stack.back());
+	m_stack.clear();
+	return result;
+}
+
+std::size_t VirtualMachine::cachedBodies() const noexcept {
+	return m_bodies.size();
+}
+
+void VirtualMachine::execute(std::size_t depth) {
+	// the running frame's code is read through locals, its pc is stored back
+	// before any instruction that may start or end a frame
+	const Chunk * chunk = m_frames.back().chunk;
+	std::size_t pc = m_frames.back().pc;
+	std::size_t locals = m_frames.back().bindings;
+
+	for (;;) {
+		const Instruction & in = chunk->code[pc++];
+
+		switch (in.op) {
+		case OP_CONST:
+			m_stack.push_back(chunk->constants[in.a]);
+			break;
+
+		case OP_LOCAL:
+			m_stack.push_back(m_bindings[locals + in.a].second);
+			break;
+
+		case OP_LOOKUP: {
+			const Expression * value = lookup(SymbolId(in.a));
+			if (value == nullptr) {
+				throw SemanticError("Error during evaluation: unknown symbol");
+			}
+			m_stack.push_back(*value);
+			break;
+		}
+
+		case OP_CALL: {
+			Procedure proc = nullptr;
+			const Expression * value = resolve(SymbolId(in.a), proc);
+			if (is_lambda(value)) {
+				m_frames.back().pc = pc;
+				if (enter(*value, in.b)) {
+					chunk = m_frames.back().chunk;
+					pc = 0;
+					locals = m_frames.back().bindings;
+				}
+			}
+			else {
+				Expression result = procedure(proc, in.b);
+				m_stack.push_back(std::move(result));
+			}
+			break;
+		}
+
+		case OP_PROC: {
+			Procedure proc = nullptr;
+			resolve(SymbolId(in.a), proc);
+			Expression result = procedure(proc, in.b);
+			m_stack.push_back(std::move(result));
+			break;
+		}
+
+		case OP_DEFINE:
+			define(SymbolId(in.a), m_stack.back());
+			break;
+
+		case OP_POP:
+			m_stack.pop_back();
+			break;
+
+		case OP_JUMP:
+			pc = in.a;
+			break;
+
+		case OP_IF_LAMBDA:
+			if (is_lambda(lookup(SymbolId(in.a)))) {
+				pc = in.b;
+			}
+			break;
+
+		case OP_CHECK_CALLABLE: {
+			Procedure proc = nullptr;
+			const Expression * value = resolve(SymbolId(in.a), proc);
+			if (!is_lambda(value) && proc == nullptr) {
+				throw SemanticError(chunk->messages[in.b]);
+			}
+			break;
+		}
+
+		case OP_APPLY:
+		case OP_MAP: {
+			m_frames.back().pc = pc;
+			Expression result = apply_map(chunk->constants[in.a].head(), in.op == OP_MAP);
+			m_stack.push_back(std::move(result));
+			break;
+		}
+
+		case OP_SET_PROPERTY: {
+			Expression target = std::move(m_stack.back());
+			m_stack.pop_back();
+			target.add_pair(chunk->constants[in.a], m_stack.back());
+			m_stack.pop_back();
+
+			// a target named like a bound symbol replaces its value
+			SymbolId name = target.head().asSymbolId();
+			if (lookup(name) != nullptr) {
+				define(name, target);
+			}
+			m_stack.push_back(std::move(target));
+			break;
+		}
+
+		case OP_GET_PROPERTY: {
+			const Expression & key = chunk->constants[in.a];
+			const Expression * bound = (in.b != NO_OPERAND) ? lookup(SymbolId(in.b)) : nullptr;
+			Expression result = (bound != nullptr) ? bound->get_value(key) : m_stack.back().get_value(key);
+			m_stack.back() = std::move(result);
+			break;
+		}
+
+		case OP_CONTINUOUS_PLOT: {
+			Expression result = continuous(in.b);
+			m_stack.push_back(std::move(result));
+			break;
+		}
+
+		case OP_FAIL:
+			throw SemanticError(chunk->messages[in.a]);
+
+		case OP_RETURN: {
+			const Frame & frame = m_frames.back();
+			Expression result = std::move(m_stack.back());
+			if (frame.memo != nullptr) {
+				frame.memo->insert(std::move(m_keys.back()), result);
+				m_keys.pop_back();
+			}
+			m_stack.resize(frame.base);
+			m_bindings.resize(frame.bindings);
+			m_frames.pop_back();
+			m_stack.push_back(std::move(result));
+			if (m_frames.size() == depth) {
+				return;
+			}
+			chunk = m_frames.back().chunk;
+			pc = m_frames.back().pc;
+			locals = m_frames.back().bindings;
+			break;
+		}
+		}
+	}
+}
+
+const Expression * VirtualMachine::resolve(SymbolId sym, Procedure & proc) const {
+	// the bindings of the running lambdas hide each other, newest first, and the environment
+	for (auto it = m_bindings.rbegin(); it != m_bindings.rend(); ++it) {
+		if (it->first == sym) {
+			return &it->second;
+		}
+	}
+
+	Global & global = m_globals[sym % m_globals.size()];
+	if (global.sym != sym || global.version != m_version) {
+		Procedure found = nullptr;
+		const Expression * value = m_env->find(sym, found);
+		global = Global{ sym, m_version, value, found };
+	}
+	proc = global.proc;
+	return global.value;
+}
+
+const Expression * VirtualMachine::lookup(SymbolId sym) const {
+	Procedure proc = nullptr;
+	return resolve(sym, proc);
+}
+
+void VirtualMachine::define(SymbolId sym, const Expression & value) {
+	const Frame & frame = m_frames.back();
+	if (!frame.lambda) {
+		m_env->add_exp(Atom(sym), value);
+		++m_version;
+		return;
+	}
+
+	// a lambda defines in its own copy of the environment, i.e. its own bindings
+	for (std::size_t i = m_bindings.size(); i-- > frame.bindings;) {
+		if (m_bindings[i].first == sym) {
+			m_bindings[i].second = value;
+			return;
+		}
+	}
+	m_bindings.emplace_back(sym, value);
+}
+
+void VirtualMachine::forget() {
+	m_bodies.clear();
+	m_recent.fill(std::make_pair(nullptr, nullptr));
+}
+
+const VirtualMachine::Body & VirtualMachine::body(const Expression & lambda) {
+	Expression::TailView tail = lambda.tailView();
+	if (tail.size() != 2) {
+		throw SemanticError("Error: incorrect number of arguments to lambda");
+	}
+
+	const Expression * key = &tail[0];
+	auto & recent = m_recent[(reinterpret_cast<std::uintptr_t>(key) / sizeof(Expression)) % m_recent.size()];
+	if (recent.first == key) {
+		return *recent.second;
+	}
+
+	auto found = m_bodies.find(key);
+	if (found == m_bodies.end()) {
+		std::unique_ptr<Body> compiled(new Body{ lambda, compile_lambda(lambda) });
+		found = m_bodies.emplace(key, std::move(compiled)).first;
+	}
+	recent = std::make_pair(key, found->second.get());
+	return *found->second;
+}
+
+bool VirtualMachine::enter(const Expression & lambda, std::size_t count) {
+	const Body & compiled = body(lambda);
+	const Chunk & called = compiled.chunk;
+	if (called.parameters.size() != count) {
+		throw SemanticError("Error: incorrect number of arguments to lambda");
+	}
+	std::size_t first = m_stack.size() - count;
+
+	// a memoized lambda may have the result already, then no frame is set up;
+	// the body holds the lambda, and so its cache, while it runs
+	MemoCache * memo = compiled.lambda.memo();
+	std::string key;
+	if (memo != nullptr && MemoCache::key(Expression::TailView(m_stack.data() + first, count), key)) {
+		Expression cached;
+		if (memo->find(key, cached)) {
+			m_stack.resize(first);
+			m_stack.push_back(std::move(cached));
+			return false;
+		}
+		m_keys.push_back(std::move(key));
+	}
+	else {
+		memo = nullptr;
+	}
+
+	// the arguments move from the stack into the parameter slots
+	std::size_t bindings = m_bindings.size();
+	for (std::size_t i = 0; i < count; ++i) {
+		if (called.parameters[i] == SYM_EMPTY) {
+			throw SemanticError("Attempt to add non-symbol to environment");
+		}
+		m_bindings.emplace_back(called.parameters[i], std::move(m_stack[first + i]));
+	}
+	m_stack.resize(first);
+
+	m_frames.push_back(Frame{ &called, 0, first, bindings, true, memo });
+	return true;
+}
+
+Expression VirtualMachine::call(const Expression & lambda, std::size_t count) {
+	// a cached result is on the stack already
+	if (enter(lambda, count)) {
+		execute(m_frames.size() - 1);
+	}
+	Expression result = std::move(m_stack.back());
+	m_stack.pop_back();
+	return result;
+}
+
+Expression VirtualMachine::procedure(Procedure proc, std::size_t count) {
+	if (proc == nullptr) {
+		throw SemanticError("Error during evaluation: symbol does not name a procedure");
+	}
+
+	m_args.clear();
+	std::size_t first = m_stack.size() - count;
+	for (std::size_t i = first; i < m_stack.size(); ++i) {
+		m_args.push_back(std::move(m_stack[i]));
+	}
+	m_stack.resize(first);
+
+	Expression result = proc(m_args);
+	m_args.clear();
+	return result;
+}
+
+Environment VirtualMachine::materialize() const {
+	Environment env(*m_env);
+	for (auto & binding : m_bindings) {
+		env.bind(Atom(binding.first), binding.second);
+	}
+	return env;
+}
+
+Expression VirtualMachine::apply_map(const Atom & op, bool map) {
+	Expression list = std::move(m_stack.back());
+	m_stack.pop_back();
+	if (!list.isList()) {
+		throw SemanticError(map ? "Error: second argument to map not a list." : "Error: second argument to apply not a list.");
+	}
+
+	// the tree walker evaluates each element again, which only numbers and
+	// strings survive unchanged; anything else is left to it
+	const PackedList * packed = list.packed();
+	Expression::TailView elements = packed ? Expression::TailView() : list.tailView();
+	std::size_t count = packed ? packed->size() : elements.size();
+	bool simple = count > 0 && !is_special_form(op.asSymbolId());
+	for (std::size_t i = 0; simple && i < elements.size(); ++i) {
+		simple = is_self_evaluating(elements[i]);
+	}
+	if (!simple) {
+		if (!m_frames.back().lambda) {
+			++m_version;
+			return apply_or_map(op, map, std::move(list).getTail(), *m_env);
+		}
+		Environment env = materialize();
+		return apply_or_map(op, map, std::move(list).getTail(), env);
+	}
+
+	auto argument = [&](std::size_t i) {
+		return packed ? packed->element(i) : Expression(elements[i].head());
+	};
+
+	Procedure proc = nullptr;
+	const Expression * value = resolve(op.asSymbolId(), proc);
+	if (!map) {
+		for (std::size_t i = 0; i < count; ++i) {
+			m_stack.push_back(argument(i));
+		}
+		if (is_lambda(value)) {
+			Expression lambda = *value;
+			return call(lambda, count);
+		}
+		return procedure(proc, count);
+	}
+
+	std::vector<Expression> results;
+	results.reserve(count);
+	if (is_lambda(value)) {
+		// the bindings move as calls start, so hold the lambda itself
+		Expression lambda = *value;
+		for (std::size_t i = 0; i < count; ++i) {
+			m_stack.push_back(argument(i));
+			results.push_back(call(lambda, 1));
+		}
+	}
+	else {
+		for (std::size_t i = 0; i < count; ++i) {
+			m_stack.push_back(argument(i));
+			results.push_back(procedure(proc, 1));
+		}
+	}
+	return make_list(std::move(results));
+}
+
+Expression VirtualMachine::continuous(std::size_t count) {
+	std::vector<Expression> results;
+	results.reserve(count);
+	std::size_t first = m_stack.size() - count;
+	for (std::size_t i = first; i < m_stack.size(); ++i) {
+		results.push_back(std::move(m_stack[i]));
+	}
+	m_stack.resize(first);
+
+	if (!m_frames.back().lambda) {
+		++m_version;
+		return continuous_plot(results, *m_env);
+	}
+
+	// the function is bound while it is sampled, and stays bound in the lambda
+	Environment env = materialize();
+	Expression result = continuous_plot(results, env);
+	define(SYM_CONTINUOUS_LAMBDA, env.get_exp(Atom(SYM_CONTINUOUS_LAMBDA)));
+	return result;
+}
@@ -0,0 +1,156 @@
+/*! \file virtual_machine.hpp
+Defines the virtual machine running compiled plotscript, see bytecode.hpp.
+ */
+#ifndef VIRTUAL_MACHINE_HPP
+#define VIRTUAL_MACHINE_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class VirtualMachine
+\brief Evaluates expressions by compiling them to bytecode and running it.
+
+The result, and any SemanticError, is the same as Expression::eval gives
+in the same environment. Lambda calls do not copy the environment: the
+arguments and definitions of every running lambda are kept on one stack of
+bindings, searched from the most recent, in front of the environment, which
+gives the dynamic scope of the tree walker. The compiled bodies of lambdas
+are cached by the lambda value's tail.
+
+The few cases the machine does not run itself, e.g. continuous-plot
+sampling its function, are handed to the tree walker in an environment
+holding the same bindings.
+ */
+class VirtualMachine {
+public:
+
+	/// the most compiled lambda bodies kept before the cache is emptied
+	static const std::size_t MAX_CACHED_BODIES = 4096;
+
+	/// Construct a machine with empty stacks and cache
+	VirtualMachine() = default;
+
+	/// Copy-construct a machine, starting with an empty cache
+	VirtualMachine(const VirtualMachine & other);
+
+	/// Assign a machine, emptying the cache
+	VirtualMachine & operator=(const VirtualMachine & other);
+
+	/*! Evaluate an expression
+	  \param exp the expression
+	  \param env the environment to evaluate it in, changed by its definitions
+	  \return the result of the evaluation
+	  \throws SemanticError when a semantic error is encountered
+	 */
+	Expression evaluate(const Expression & exp, Environment & env);
+
+	/*! Run a chunk compiled from an expression evaluated at the top level
+	  \param chunk the chunk, see compile
+	  \param env the environment to run it in, changed by its definitions
+	  \return the result of the evaluation
+	  \throws SemanticError when a semantic error is encountered
+	 */
+	Expression run(const Chunk & chunk, Environment & env);
+
+	/// the number of lambda bodies compiled and cached
+	std::size_t cachedBodies() const noexcept;
+
+private:
+
+	// a running chunk
+	struct Frame {
+		const Chunk * chunk;
+		std::size_t pc;
+		// the first value on the stack, and binding, of the frame
+		std::size_t base;
+		std::size_t bindings;
+		// whether the chunk is a lambda body rather than the top level
+		bool lambda;
+		// the cache of a memoized lambda, its key is on m_keys
+		MemoCache * memo;
+	};
+
+	// a compiled lambda body, holding the lambda so its tail stays put
+	struct Body {
+		Expression lambda;
+		Chunk chunk;
+	};
+
+	Environment * m_env = nullptr;
+	std::vector<Expression> m_stack;
+	std::vector<std::pair<SymbolId, Expression> > m_bindings;
+	std::vector<Frame> m_frames;
+
+	// the keys of running memoized lambda calls, innermost last
+	std::vector<std::string> m_keys;
+
+	// the arguments of a built-in procedure call, reused between calls
+	std::vector<Expression> m_args;
+
+	std::unordered_map<const Expression *, std::unique_ptr<Body> > m_bodies;
+
+	// the bodies called most recently, by a hash of their key, checked before m_bodies
+	std::array<std::pair<const Expression *, const Body *>, 64> m_recent{};
+
+	// empty the cache of bodies
+	void forget();
+
+	// a symbol looked up in the environment
+	struct Global {
+		SymbolId sym;
+		std::size_t version;
+		const Expression * value;
+		Procedure proc;
+	};
+
+	// symbols looked up in the environment, by symbol, valid while their version is m_version
+	mutable std::array<Global, 64> m_globals{};
+
+	// changed whenever the environment may have been
+	std::size_t m_version = 1;
+
+	// run until the frame count drops to depth
+	void execute(std::size_t depth);
+
+	// the value sym is bound to, or nullptr and the procedure it names in proc
+	const Expression * resolve(SymbolId sym, Procedure & proc) const;
+
+	// the value sym is bound to, or nullptr
+	const Expression * lookup(SymbolId sym) const;
+
+	// bind sym the way Environment::add_exp does in the running frame
+	void define(SymbolId sym, const Expression & value);
+
+	// the compiled body of a lambda value
+	const Body & body(const Expression & lambda);
+
+	// start a call of lambda on the top count values, false if instead its
+	// cached result replaced them
+	bool enter(const Expression & lambda, std::size_t count);
+
+	// call lambda on the top count values and return its result
+	Expression call(const Expression & lambda, std::size_t count);
+
+	// call proc, as resolved for the name of a call, on the top count values
+	Expression procedure(Procedure proc, std::size_t count);
+
+	// the running frame's environment, for the tree walker
+	Environment materialize() const;
+
+	// apply or map op over list, the top value
+	Expression apply_map(const Atom & op, bool map);
+
+	// plot the function in the top count values
+	Expression continuous(std::size_t count);
+};
+
+#endif